@@ -0,0 +1,190 @@
+// Microbenchmark of the buffer-based hex formatting against the ostringstream implementation it replaced.
+// The stream versions are kept here verbatim as the reference, and the outputs are checked for equality first.
+#include "dos/util.h"
+#include "dos/format.h"
+#include "dos/address.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <functional>
+
+using namespace std;
+
+namespace stream {
+
+string hexVal(const Byte val, bool prefix = true, bool pad = true) {
+    ostringstream str;
+    if (prefix) str << "0x";
+    if (pad) str << setw(2) << setfill('0');
+    str << hex << (int)val;
+    return str.str();
+}
+
+string hexVal(const SByte val, bool prefix = true, bool pad = true) {
+    ostringstream str;
+    if (prefix) str << "0x";
+    if (pad) str << setw(2) << setfill('0');
+    str << hex << (int)val;
+    return str.str();
+}
+
+string hexVal(const Word val, bool prefix = true, bool pad = true) {
+    ostringstream str;
+    if (prefix) str << "0x";
+    if (pad) str << setw(4) << setfill('0');
+    str << hex << val;
+    return str.str();
+}
+
+string hexVal(const SWord val, bool prefix = true, bool pad = true) {
+    ostringstream str;
+    if (prefix) str << "0x";
+    if (pad) str << setw(4) << setfill('0');
+    str << hex << val;
+    return str.str();
+}
+
+string hexVal(const DWord val, bool prefix = true, bool pad = true) {
+    ostringstream str;
+    if (prefix) str << "0x";
+    if (pad) str << setw(8) << setfill('0');
+    str << hex << val;
+    return str.str();
+}
+
+string hexVal(const Offset val, const bool hdr = true, const int pad = 0) {
+    ostringstream str;
+    if (hdr) str << "0x";
+    if (pad) str << setfill('0') << setw(pad);
+    str << hex << val;
+    return str.str();
+}
+
+string signedHexVal(const SByte val, bool plus = true) {
+    ostringstream str;
+    if (val >= 0) {
+        if (plus) str << "+";
+        str << "0x" << hex << setw(2) << setfill('0') << (int)(val);
+    }
+    else str << "-0x" << hex << setw(2) << setfill('0') << (int)(~val + 1);
+    return str.str();
+}
+
+string signedHexVal(const SWord val, bool plus = true) {
+    ostringstream str;
+    if (val >= 0) {
+        if (plus) str << "+";
+        str << "0x" << hex << setw(4) << setfill('0') << val;
+    }
+    else str << "-0x" << hex << setw(4) << setfill('0') << ~val + 1;
+    return str.str();
+}
+
+string addressString(const Address &a, const bool brief = false) {
+    ostringstream str;
+    if (a.isValid()) {
+        str << hex << setw(WORD_STRLEN) << setfill('0') << a.segment << ":" << setw(WORD_STRLEN) << setfill('0') << a.offset;
+        if (!brief) str << "/" << setw(OFFSET_STRLEN) << a.toLinear();
+    }
+    else str << "(invalid)";
+    return str.str();
+}
+
+} // namespace stream
+
+static int failures = 0;
+// keeps the benchmarked calls from being optimized away
+static volatile size_t benchSink;
+
+static void check(const string &expected, const string &actual, const string &what) {
+    if (expected == actual) return;
+    if (failures++ < 10) cout << "MISMATCH " << what << ": '" << expected << "' != '" << actual << "'" << endl;
+}
+
+static void verify() {
+    for (int v = 0; v <= 0xff; ++v) {
+        const Byte b = v;
+        const SByte sb = static_cast<SByte>(v);
+        for (int flags = 0; flags < 4; ++flags) {
+            const bool p = flags & 1, d = flags & 2;
+            check(stream::hexVal(b, p, d), hexVal(b, p, d), "Byte " + to_string(v));
+            check(stream::hexVal(sb, p, d), hexVal(sb, p, d), "SByte " + to_string(v));
+        }
+        check(stream::signedHexVal(sb), signedHexVal(sb), "signed SByte " + to_string(v));
+        check(stream::signedHexVal(sb, false), signedHexVal(sb, false), "signed SByte " + to_string(v));
+    }
+    for (int v = 0; v <= 0xffff; ++v) {
+        const Word w = v;
+        const SWord sw = static_cast<SWord>(v);
+        for (int flags = 0; flags < 4; ++flags) {
+            const bool p = flags & 1, d = flags & 2;
+            check(stream::hexVal(w, p, d), hexVal(w, p, d), "Word " + to_string(v));
+            check(stream::hexVal(sw, p, d), hexVal(sw, p, d), "SWord " + to_string(v));
+        }
+        check(stream::signedHexVal(sw), signedHexVal(sw), "signed SWord " + to_string(v));
+        const Address a(static_cast<Word>(v * 7), w);
+        check(stream::addressString(a), a.toString(), "Address " + to_string(v));
+        check(stream::addressString(a, true), a.toString(true), "Address " + to_string(v));
+    }
+    DWord v = 1;
+    for (int i = 0; i < 100; ++i, v = v * 3 + 1) {
+        check(stream::hexVal(v), hexVal(v), "DWord " + to_string(v));
+        check(stream::hexVal(v, false, false), hexVal(v, false, false), "DWord " + to_string(v));
+        const Offset o = v;
+        check(stream::hexVal(o, false, 6), hexVal(o, false, 6), "Offset " + to_string(v));
+        check(stream::hexVal(o), hexVal(o), "Offset " + to_string(v));
+    }
+    check(stream::addressString(Address()), Address().toString(), "invalid Address");
+}
+
+static void bench(const string &name, const function<size_t(int)> &streamFn, const function<size_t(int)> &fmtFn, const int count = 1000000) {
+    using clock = chrono::steady_clock;
+    size_t sink = 0;
+    auto start = clock::now();
+    for (int i = 0; i < count; ++i) sink += streamFn(i);
+    const double streamNs = chrono::duration<double, nano>(clock::now() - start).count() / count;
+    start = clock::now();
+    for (int i = 0; i < count; ++i) sink += fmtFn(i);
+    const double fmtNs = chrono::duration<double, nano>(clock::now() - start).count() / count;
+    cout << left << setw(22) << name << right << fixed << setprecision(1)
+         << setw(9) << streamNs << " ns/op (stream)"
+         << setw(9) << fmtNs << " ns/op (buffer)"
+         << setw(8) << streamNs / fmtNs << "x" << endl;
+    benchSink = sink;
+}
+
+int main() {
+    verify();
+    if (failures) {
+        cout << failures << " formatting mismatches against the stream implementation" << endl;
+        return 1;
+    }
+    cout << "Output identical to the stream implementation" << endl;
+
+    bench("hexVal(Byte)",
+        [](int i) { return stream::hexVal(static_cast<Byte>(i)).size(); },
+        [](int i) { return hexVal(static_cast<Byte>(i)).size(); });
+    bench("hexVal(Word)",
+        [](int i) { return stream::hexVal(static_cast<Word>(i)).size(); },
+        [](int i) { return hexVal(static_cast<Word>(i)).size(); });
+    bench("hexVal(DWord)",
+        [](int i) { return stream::hexVal(static_cast<DWord>(i)).size(); },
+        [](int i) { return hexVal(static_cast<DWord>(i)).size(); });
+    bench("hexVal(Offset, 6)",
+        [](int i) { return stream::hexVal(static_cast<Offset>(i), false, 6).size(); },
+        [](int i) { return hexVal(static_cast<Offset>(i), false, 6).size(); });
+    bench("signedHexVal(SWord)",
+        [](int i) { return stream::signedHexVal(static_cast<SWord>(i)).size(); },
+        [](int i) { return signedHexVal(static_cast<SWord>(i)).size(); });
+    bench("Address::toString",
+        [](int i) { return stream::addressString(Address(0x1000, static_cast<Word>(i))).size(); },
+        [](int i) { return Address(0x1000, static_cast<Word>(i)).toString().size(); });
+    char buf[ADDR_STRMAX];
+    bench("formatAddress(buf)",
+        [](int i) { return stream::addressString(Address(0x1000, static_cast<Word>(i))).size(); },
+        [&](int i) { return static_cast<size_t>(formatAddress(buf, Address(0x1000, static_cast<Word>(i))) - buf); });
+    return 0;
+}
@@ -0,0 +1,347 @@
+// Benchmark suite for tracking the performance of the decoder and the analysis across commits. The microbenchmarks
+// run over the reachable code of the executables given on the command line and over a generated corpus of valid
+// instructions, the end-to-end benchmarks run the routine search and the code comparison on the executables.
+// The parsing benchmark loads a generated executable with a large relocation table.
+// Every benchmark reports the time per operation, operations per second and the peak RSS of the process after it ran,
+// either as a table or as one JSON record per line.
+#include "dos/mz.h"
+#include "dos/executable.h"
+#include "dos/analysis.h"
+#include "dos/instruction.h"
+#include "dos/store.h"
+#include "dos/output.h"
+#include "dos/json.h"
+#include "dos/sink.h"
+#include "dos/error.h"
+#include "dos/util.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <regex>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+// keeps the benchmarked results from being optimized away
+static volatile size_t benchSink;
+
+void usage() {
+    output("usage: mzbench [options] [file.exe...]\n"
+           "Runs the decoder and analysis benchmarks over the executables and a generated corpus\n"
+           "Options:\n"
+           "--json:         print one JSON record per benchmark instead of a table\n"
+           "--iter count:   iterations of the microbenchmarks (100), the end-to-end benchmarks run a tenth of that\n"
+           "--filter regex: only run benchmarks with a matching name", LOG_OTHER, LOG_ERROR);
+    exit(1);
+}
+
+void fatal(const string &msg) {
+    output("ERROR: "s + msg, LOG_OTHER, LOG_ERROR);
+    exit(1);
+}
+
+// peak resident set size of the process in KB
+static Size peakRss() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// Code over which the microbenchmarks run, the locations of the instructions in it are known up front
+struct Corpus {
+    string name;
+    vector<Byte> data;
+    vector<Address> instrs;
+    // only for corpora loaded from an executable
+    unique_ptr<MzImage> mz;
+    RoutineMap map;
+
+    const Byte* pointer(const Address &a) const { return data.data() + (a.toLinear() - base()); }
+    Offset base() const { return mz ? SEG_TO_OFFSET(mz->loadSegment()) : 0; }
+};
+
+// the instructions in the reachable blocks of the routines found in the executable
+static void loadCorpus(Corpus &c, const string &path) {
+    const Word loadSeg = 0x1000;
+    c.name = path.substr(path.find_last_of('/') + 1);
+    c.mz.reset(new MzImage{path});
+    c.mz->load(loadSeg);
+    c.data.assign(c.mz->loadModuleData(), c.mz->loadModuleData() + c.mz->loadModuleSize());
+    for (const auto &p : c.mz->relocationPatches()) {
+        c.data[p.offset] = lowByte(p.value);
+        c.data[p.offset + 1] = hiByte(p.value);
+    }
+    Executable exe{*c.mz};
+    c.map = exe.findRoutines();
+    for (Size i = 0; i < c.map.size(); ++i) {
+        for (const Block &b : c.map.getRoutine(i).reachable) {
+            for (Address a = b.begin; a <= b.end; ) {
+                c.instrs.push_back(a);
+                a += Instruction{a, c.pointer(a)}.length;
+            }
+        }
+    }
+}
+
+// pseudo-random sequence of valid instructions, the same on every run
+static void generateCorpus(Corpus &c, const Size size) {
+    c.name = "generated";
+    DWord state = 0x2545f491;
+    auto random = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<Byte>(state);
+    };
+    Byte buf[INSTRUCTION_MAX];
+    while (c.data.size() < size) {
+        for (Byte &b : buf) b = random();
+        const Byte length = instructionLength(buf);
+        if (length == 0) continue;
+        if (!Instruction{Address{0}, buf}.isValid()) continue;
+        c.instrs.push_back(Address{static_cast<Offset>(c.data.size())});
+        c.data.insert(c.data.end(), buf, buf + length);
+    }
+}
+
+// Executable with a load module of the given size and relocations spread evenly over it, written to a temporary file.
+// Returns the path of the file.
+static string generateExe(const Size moduleSize, const Size relocCount) {
+    const Size headerSize = (MZ_HEADER_SIZE + relocCount * MZ_RELOC_SIZE + PARAGRAPH_SIZE - 1) / PARAGRAPH_SIZE * PARAGRAPH_SIZE;
+    const Size fileSize = headerSize + moduleSize;
+    vector<Word> header(MZ_HEADER_SIZE / sizeof(Word), 0);
+    header[0x00] = MZ_SIGNATURE;
+    header[0x01] = fileSize % PAGE_SIZE;
+    header[0x02] = static_cast<Word>((fileSize + PAGE_SIZE - 1) / PAGE_SIZE);
+    header[0x03] = static_cast<Word>(relocCount);
+    header[0x04] = static_cast<Word>(headerSize / PARAGRAPH_SIZE);
+    header[0x0c] = MZ_HEADER_SIZE;
+    vector<Byte> data(fileSize, 0x90);
+    memcpy(data.data(), header.data(), MZ_HEADER_SIZE);
+    const Size step = moduleSize / relocCount;
+    for (Size i = 0; i < relocCount; ++i) {
+        const Address addr{static_cast<Offset>(i * step)};
+        const Word entry[2] = { addr.offset, addr.segment };
+        memcpy(data.data() + MZ_HEADER_SIZE + i * MZ_RELOC_SIZE, entry, MZ_RELOC_SIZE);
+        const Word value = static_cast<Word>(i);
+        memcpy(data.data() + headerSize + i * step, &value, sizeof(Word));
+    }
+    char path[] = "/tmp/mzbenchXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) throw IoError("Unable to create temporary file for the generated executable");
+    close(fd);
+    writeBinaryFile(path, data.data(), data.size());
+    return path;
+}
+
+class Bench {
+    struct Result { string name, input, unit; Size ops; double ns; Size rss; };
+    int iterations_;
+    regex filter_;
+    vector<Result> results_;
+
+public:
+    Bench(const int iterations, const string &filter) : iterations_(iterations), filter_(filter) {}
+
+    // The function performs one iteration of the benchmark made up of the given number of operations,
+    // one warmup iteration is run before the measurement.
+    template<typename F> void run(const string &name, const string &input, const string &unit, const Size ops, const bool endToEnd, const F &fn) {
+        if (!regex_search(name, filter_) || ops == 0) return;
+        const int iterations = endToEnd ? max(1, iterations_ / 10) : iterations_;
+        size_t sink = fn();
+        const auto start = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) sink += fn();
+        const double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        benchSink = sink;
+        results_.push_back({name, input, unit, ops * iterations, ns, peakRss()});
+    }
+
+    void printTable() const {
+        cout << left << setw(14) << "benchmark" << setw(14) << "input" << right << setw(12) << "ops"
+             << setw(12) << "ns/op" << setw(14) << "ops/s" << setw(8) << "unit" << setw(12) << "peak KB" << endl;
+        for (const auto &r : results_) {
+            cout << left << setw(14) << r.name << setw(14) << r.input << right << setw(12) << r.ops << fixed
+                 << setprecision(1) << setw(12) << r.ns / r.ops << setprecision(0) << setw(14) << r.ops / r.ns * 1e9
+                 << setw(8) << r.unit << setw(12) << r.rss << endl;
+        }
+    }
+
+    void printJson() const {
+        StreamSink sink{cout};
+        JsonWriter json{sink};
+        for (const auto &r : results_) {
+            json.begin("bench").field("name", r.name).field("input", r.input).field("unit", r.unit).field("ops", r.ops)
+                .field("ns_per_op", r.ns / r.ops).field("ops_per_s", r.ops / r.ns * 1e9).field("peak_rss_kb", r.rss).end();
+        }
+        sink.flush();
+    }
+};
+
+static void codeBenchmarks(Bench &bench, const Corpus &c) {
+    const Size count = c.instrs.size();
+    bench.run("decode", c.name, "instr", count, false, [&]() {
+        size_t sink = 0;
+        for (const Address &a : c.instrs) {
+            const Instruction ins{a, c.pointer(a)};
+            sink += ins.length + ins.op1.type;
+        }
+        return sink;
+    });
+    bench.run("length", c.name, "instr", count, false, [&]() {
+        size_t sink = 0;
+        for (const Address &a : c.instrs) sink += instructionLength(c.pointer(a));
+        return sink;
+    });
+    // every instruction against its successor, a mix of matches and mismatches
+    vector<Instruction> decoded;
+    for (const Address &a : c.instrs) decoded.emplace_back(a, c.pointer(a));
+    bench.run("match", c.name, "instr", count - 1, false, [&]() {
+        size_t sink = 0;
+        for (Size i = 1; i < decoded.size(); ++i) sink += decoded[i - 1].match(decoded[i]);
+        return sink;
+    });
+    // hashing a routine-sized window of instructions, against formatting them for comparing the strings
+    bench.run("fingerprint", c.name, "instr", count, false, [&]() {
+        size_t sink = 0;
+        DWord hash = 0;
+        for (Size i = 0; i < decoded.size(); ++i) {
+            if (i % 16 == 0) { sink += hash; hash = 0; }
+            hash = fingerprintCombine(hash, decoded[i].fingerprint);
+        }
+        return sink + hash;
+    });
+    bench.run("format", c.name, "instr", count, false, [&]() {
+        size_t sink = 0;
+        string str;
+        for (const Instruction &ins : decoded) {
+            str.clear();
+            ins.format(str);
+            sink += str.size();
+        }
+        return sink;
+    });
+    InstructionStore store{c.base(), c.data.size()};
+    for (const Address &a : c.instrs) store.get(a, c.pointer(a));
+    bench.run("store", c.name, "instr", count, false, [&]() {
+        size_t sink = 0;
+        for (const Address &a : c.instrs) sink += store.get(a, c.pointer(a)).length;
+        return sink;
+    });
+    // linear sweep over the whole buffer, whether the bytes are code or not
+    vector<Byte> bitmap;
+    bench.run("sweep", c.name, "byte", c.data.size(), false, [&]() {
+        return instructionBoundaries(c.data.data(), c.data.size(), bitmap);
+    });
+}
+
+static void analysisBenchmarks(Bench &bench, const Corpus &c) {
+    const Size count = c.instrs.size();
+    bench.run("findroutines", c.name, "instr", count, true, [&]() {
+        Executable exe{*c.mz};
+        return exe.findRoutines().size();
+    });
+    bench.run("compare", c.name, "instr", count, true, [&]() {
+        Executable ref{*c.mz}, tgt{*c.mz};
+        AnalysisOptions opt;
+        return static_cast<size_t>(ref.compareCode(c.map, tgt, opt));
+    });
+}
+
+// search queue operations and routine map construction over a synthetic layout of adjacent routines
+static void queueBenchmarks(Bench &bench, const Size routines) {
+    const Word loadSeg = 0x1000;
+    const Size routineSize = 0x10;
+    const vector<Segment> segs = { Segment{"Code1", Segment::SEG_CODE, loadSeg} };
+    // returns the number of queue operations
+    auto fillQueue = [&](ScanQueue &sq) {
+        Size ops = 0;
+        // queue a call to every routine, then pop them in order and claim their bytes
+        for (Size i = 1; i < routines; ++i, ++ops) sq.saveCall(Address{loadSeg, static_cast<Word>(i * routineSize)}, RegisterState{}, true);
+        while (!sq.empty()) {
+            const Destination d = sq.nextPoint();
+            sq.setRoutineId(d.address.toLinear(), routineSize);
+            ops += 2;
+        }
+        return ops;
+    };
+    const Destination seed{Address{loadSeg, 0}, 1, true, RegisterState{}};
+    ScanQueue filled{seed};
+    const Size ops = fillQueue(filled);
+    bench.run("scanqueue", "synthetic", "op", ops, true, [&]() {
+        ScanQueue sq{seed};
+        fillQueue(sq);
+        return sq.routineCount();
+    });
+    bench.run("routinemap", "synthetic", "routine", routines, true, [&]() {
+        return RoutineMap{filled, segs, loadSeg, routines * routineSize}.size();
+    });
+}
+
+// header and relocation table parsing, the relocation factor is applied on load
+static void parseBenchmarks(Bench &bench, const Size relocs) {
+    const string path = generateExe(0x80000, relocs);
+    try {
+        bench.run("mzparse", "generated", "reloc", relocs, true, [&]() {
+            MzImage mz{path};
+            mz.load(0x1000);
+            return mz.relocationPatches().size();
+        });
+    }
+    catch (...) {
+        deleteFile(path);
+        throw;
+    }
+    deleteFile(path);
+}
+
+int main(int argc, char *argv[]) {
+    setOutputLevel(LOG_ERROR);
+    int iterations = 100;
+    bool json = false;
+    string filter;
+    vector<string> paths;
+    for (int aidx = 1; aidx < argc; ++aidx) {
+        string arg(argv[aidx]);
+        if (arg == "--json") json = true;
+        else if (arg == "--iter" && (aidx + 1 < argc)) {
+            // not a number or out of range
+            try { iterations = stoi(argv[++aidx]); }
+            catch (logic_error &e) { usage(); }
+        }
+        else if (arg == "--filter" && (aidx + 1 < argc)) filter = argv[++aidx];
+        else if (arg.compare(0, 2, "--") == 0) usage();
+        else paths.push_back(arg);
+    }
+    if (iterations < 1) usage();
+#ifndef __OPTIMIZE__
+    output("WARNING: mzbench was built without optimization, the timings do not represent optimized code", LOG_OTHER, LOG_ERROR);
+#endif
+    try {
+        Bench bench{iterations, filter};
+        vector<Corpus> corpora(paths.size() + 1);
+        for (Size i = 0; i < paths.size(); ++i) loadCorpus(corpora[i], paths[i]);
+        generateCorpus(corpora.back(), 0x10000);
+        for (const Corpus &c : corpora) codeBenchmarks(bench, c);
+        for (const Corpus &c : corpora) if (c.mz) analysisBenchmarks(bench, c);
+        queueBenchmarks(bench, 0x200);
+        parseBenchmarks(bench, 0x4000);
+        if (json) bench.printJson();
+        else bench.printTable();
+    }
+    catch (Error &e) {
+        fatal(e.why());
+    }
+    return 0;
+}
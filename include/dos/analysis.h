@@ -40,6 +40,7 @@ class ScanQueue {
     Destination curSearch;
     std::list<Destination> queue;
     std::vector<RoutineEntrypoint> entrypoints;
+    std::vector<Block> dataBlocks; // locations where the search ran into bytes that do not decode
 
 public:
     ScanQueue(const Destination &seed);
@@ -51,6 +52,9 @@ public:
     bool hasPoint(const Address &dest, const bool call) const;
     bool saveCall(const Address &dest, const RegisterState &regs, const bool near);
     bool saveJump(const Address &dest, const RegisterState &regs);
+    bool saveSeed(const Address &dest);
+    void saveData(const Block &b);
+    const std::vector<Block>& suspectData() const { return dataBlocks; }
     // discovered locations operations
     Size routineCount() const { return entrypoints.size(); }
     std::string statusString() const;
@@ -64,6 +68,11 @@ private:
     ScanQueue() {}
 };
 
+// Offsets of likely routine entrypoints in a code buffer, found by matching common compiler-generated prologues.
+// Meant for seeding the routine search in code which is not reachable through branches from the entrypoint.
+// From the 80186 on, enter with a nesting level of 0 counts as a prologue as well.
+std::vector<Offset> findPrologues(const Byte *data, const Size size, const CpuLevel cpu = CPU_8086);
+
 class OffsetMap {
     using MapSet = std::vector<SOffset>;
     Size maxData;
@@ -93,13 +102,30 @@ struct Branch {
     bool isCall, isUnconditional, isNear;
 };
 
+// Counters of how the compared instructions were matched. Byte-identical instruction pairs are matched without
+// looking at the decoded instructions, either by comparing the bytes of the pair or by lying inside a span of identical
+// bytes found by comparing the rest of a routine block at once.
+struct CompareStats {
+    Size instructions;  // compared instruction pairs
+    Size spanMatches;   // pairs inside an identical span, the target instruction was not decoded
+    Size rawMatches;    // pairs with identical bytes outside of a span
+    Size blocks;        // block-level compares
+    Size fullBlocks;    // blocks which were identical up to their end
+    Size spanBytes;     // bytes in the identical spans
+    CompareStats() : instructions(0), spanMatches(0), rawMatches(0), blocks(0), fullBlocks(0), spanBytes(0) {}
+    std::string toString() const;
+};
+
 // TODO: introduce true strict (now it's "not loose"), compare by opcode
+class JsonWriter;
 struct AnalysisOptions {
     bool strict, ignoreDiff, noCall, variant;
     Size refSkip, tgtSkip, ctxCount;
     Address stopAddr;
     std::string exclude;
-    AnalysisOptions() : strict(true), ignoreDiff(false), noCall(false), variant(false), refSkip(0), tgtSkip(0), ctxCount(10) {}
+    JsonWriter *records; // if set, the comparison writes a record for every compared location into it
+    CompareStats *stats; // if set, receives the counters of the comparison
+    AnalysisOptions() : strict(true), ignoreDiff(false), noCall(false), variant(false), refSkip(0), tgtSkip(0), ctxCount(10), records(nullptr), stats(nullptr) {}
 };
 
 // TODO: compare instructions, not string representations, allow wildcards in place of arguments, e.g. "mov ax, *"
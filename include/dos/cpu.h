@@ -26,9 +26,11 @@ private:
     Memory *mem_;
     InterruptInterface *int_;
     Registers regs_;
-    const Byte *memBase_, *code_;
+    const Byte *code_;
+    Size codeGeneration_; // flat generation of the memory code_ points into
     Byte opcode_, modrm_;
     Register segOverride_;
+    Word prefixLength_; // bytes of the segment override prefix preceding opcode_
     Byte byteOperand1_, byteOperand2_, byteResult_;
     Word wordOperand1_, wordOperand2_, wordResult_;
     Block codeExtents_;
@@ -50,15 +52,32 @@ private:
     // instruction pointer access and manipulation
     inline Byte ipByte(const Word offset = 0) const { return code_[regs_.get(REG_IP) + offset]; }
     inline Word ipWord(const Word offset = 0) const { return *WORD_PTR(code_, regs_.get(REG_IP) + offset); } // TODO: ouch
+    // operand bytes of the current instruction, the offset is relative to the opcode past any prefix
+    inline Byte opByte(const Word offset) const { return ipByte(prefixLength_ + offset); }
+    inline Word opWord(const Word offset) const { return ipWord(prefixLength_ + offset); }
     inline void ipJump(const Address &target) { setCodeSegment(target.segment); regs_.set(REG_IP, target.offset); }
     inline void ipAdvance(const SWord amount) { regs_.set(REG_IP, regs_.get(REG_IP) + amount); }
     inline void ipAdvance(const SByte amount) { regs_.set(REG_IP, regs_.get(REG_IP) + amount); }
 
-    inline Byte memByte(const Offset offset) const { return memBase_[offset]; }
-    inline Word memWord(const Offset offset) const { return *WORD_PTR(memBase_, offset); }
+    // linear addresses computed from segment:offset reach past 1 MiB, wrapped they are always in range,
+    // the data accesses are recorded in the access map of the memory if it has one
+    inline Byte memByte(const Offset offset) const { return mem_->readByte<TrackedAccess<InRangeAccess>>(Memory::wrap(offset)); }
+    inline Word memWord(const Offset offset) const { return mem_->readWord<TrackedAccess<InRangeAccess>>(Memory::wrap(offset)); }
+    inline void setMemByte(const Offset offset, const Byte value) { mem_->writeByte<TrackedAccess<InRangeAccess>>(Memory::wrap(offset), value); }
+    inline void setMemWord(const Offset offset, const Word value) { mem_->writeWord<TrackedAccess<InRangeAccess>>(Memory::wrap(offset), value); }
 
     // ModR/M byte and evaluation
     Offset modrmMemAddress() const;
+    // length of the opcode, ModR/M byte and displacement, an immediate operand follows after that
+    Word modrmLength() const;
+    // the E operand is a register or memory depending on the MOD bits, G is the register in the REG bits
+    Byte modrmEb() const;
+    Word modrmEv() const;
+    void setModrmEb(const Byte value);
+    void setModrmEv(const Word value);
+    Register modrmGb() const;
+    Register modrmGv() const;
+    Register modrmSw() const;
 
     std::string opcodeStr() const;
     void preProcessOpcode();
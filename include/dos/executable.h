@@ -9,6 +9,8 @@
 #include "dos/routine.h"
 #include "dos/mz.h"
 #include "dos/analysis.h"
+#include "dos/output.h"
+#include "dos/store.h"
 
 struct AnalysisOptions;
 
@@ -20,6 +22,9 @@ class Executable {
     Address ep, stack;
     Block codeExtents;
     std::vector<Segment> segments;
+    CpuLevel cpu;
+    // decoded instructions are cached across the analysis and comparison passes, which are const with respect to the code
+    mutable InstructionStore store;
 
     enum ComparisonResult { 
         CMP_MISMATCH,
@@ -40,9 +45,14 @@ public:
     Executable(const Word loadSegment, const std::vector<Byte> &data);
     const Address& entrypoint() const { return ep; }
     void setEntrypoint(const Address &addr);
+    // instruction set the code is decoded with, drops the instructions decoded so far
+    void setCpu(const CpuLevel level);
 
     bool contains(const Address &addr) const { return codeExtents.contains(addr); }
-    RoutineMap findRoutines();
+    Instruction instruction(const Address &addr) const { return store.get(addr, code.pointer(addr)); }
+    const InstructionStore& instructions() const { return store; }
+    // with prologues set, unreachable code starting with a common routine prologue is searched as well
+    RoutineMap findRoutines(const bool prologues = false);
     bool compareCode(const RoutineMap &map, const Executable &other, const AnalysisOptions &options);
 
 private:
@@ -51,18 +61,30 @@ private:
         const AnalysisOptions &options;
         Address refCsip, tgtCsip;
         OffsetMap offMap;
+        // offset mapping consulted by the last instructionsMatch(), REG_NONE if there was none
+        Register mapSeg;
+        SOffset mapRef, mapTgt;
+        // bytes from refCsip onwards known to be identical to the ones from tgtCsip onwards
+        Size identical;
+        CompareStats stats;
         Context(const Executable &target, const AnalysisOptions &opt, const Size maxData);
     };
     void init();
-    void searchMessage(const Address &addr, const std::string &msg) const;
+    template<typename... Args> void searchMessage(const Address &addr, const Args&... args) const {
+        logOutput<LOG_DEBUG>(LOG_ANALYSIS, addr, ": ", args...);
+    }
     Branch getBranch(const Instruction &i, const RegisterState &regs = {}) const;
     bool saveBranch(const Branch &branch, const RegisterState &regs, const Block &codeExtents, ScanQueue &sq) const;
     void applyMov(const Instruction &i, RegisterState &regs);
 
     ComparisonResult instructionsMatch(Context &ctx, const Instruction &ref, Instruction tgt);
+    Size identicalBytes(const Context &ctx, const Address &refEnd) const;
     void storeSegment(const Segment::Type type, const Word addr);
+    Address codeAddress(const Offset linear) const;
     void diffContext(const Context &ctx) const;
     void skipContext(const Context &ctx, Address refAddr, Address tgtAddr, Size refSkipped, Size tgtSkipped) const;
+    void compareRecord(const Context &ctx, const char *type, const char *result, const Instruction &ref, const Instruction &tgt, const Size tgtSize) const;
+    void routineRecord(const Context &ctx, const char *event, const Routine &routine, const Block &block) const;
 };
 
 #endif // EXECUTABLE_H
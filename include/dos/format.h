@@ -0,0 +1,47 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <string>
+#include <cstdint>
+
+#include "dos/types.h"
+#include "dos/address.h"
+
+// Allocation-free formatting of hex values and addresses into caller-supplied buffers. The functions write
+// the text without a terminating null character and return the position past the last character written,
+// the buffers need to have room for at least the corresponding *_STRMAX characters.
+static constexpr Size HEX_STRMAX = 24;   // any single value, including sign and prefix
+static constexpr Size ADDR_STRMAX = 16;  // ssss:oooo/llllll
+static constexpr Size BLOCK_STRMAX = 40; // ssss:oooo-ssss:oooo/llllll
+
+// zero-padded to at least width digits
+char* formatHexDigits(char *buf, uint64_t val, const int width);
+// same output as the corresponding hexVal() overloads
+char* formatHex(char *buf, const Byte  val, const bool prefix = true, const bool pad = true);
+char* formatHex(char *buf, const SByte val, const bool prefix = true, const bool pad = true);
+char* formatHex(char *buf, const Word  val, const bool prefix = true, const bool pad = true);
+char* formatHex(char *buf, const SWord val, const bool prefix = true, const bool pad = true);
+char* formatHex(char *buf, const DWord val, const bool prefix = true, const bool pad = true);
+char* formatHex(char *buf, const Offset val, const bool hdr = true, const int pad = 0);
+char* formatHex(char *buf, SOffset val, const bool hdr = true, const int pad = 0);
+char* formatSignedHex(char *buf, const SByte val, const bool plus = true);
+char* formatSignedHex(char *buf, const SWord val, const bool plus = true);
+// same output as Address::toString() and Block::toString()
+char* formatAddress(char *buf, const Address &addr, const bool brief = false);
+char* formatBlock(char *buf, const Block &block, const bool linear = false, const bool showSize = true);
+
+// append the formatted value to a string, which does not allocate as long as the string has enough capacity reserved
+template<typename T, typename... Args> void appendHex(std::string &str, const T val, const Args... args) {
+    char buf[HEX_STRMAX];
+    str.append(buf, formatHex(buf, val, args...));
+}
+template<typename T> void appendSignedHex(std::string &str, const T val, const bool plus = true) {
+    char buf[HEX_STRMAX];
+    str.append(buf, formatSignedHex(buf, val, plus));
+}
+inline void appendAddress(std::string &str, const Address &addr, const bool brief = false) {
+    char buf[ADDR_STRMAX];
+    str.append(buf, formatAddress(buf, addr, brief));
+}
+
+#endif // FORMAT_H
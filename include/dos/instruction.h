@@ -9,6 +9,7 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 // TODO: rep and repnz are not used as instructions, but prefixes, remove
 #define INSTRUCTION_CLASS \
@@ -95,13 +96,35 @@
     X(INS_MUL) \
     X(INS_IMUL) \
     X(INS_DIV) \
-    X(INS_IDIV)
-enum InstructionClass {
+    X(INS_IDIV) \
+    X(INS_PUSHA) \
+    X(INS_POPA) \
+    X(INS_BOUND) \
+    X(INS_INSB) \
+    X(INS_INSW) \
+    X(INS_OUTSB) \
+    X(INS_OUTSW) \
+    X(INS_ENTER) \
+    X(INS_LEAVE)
+enum InstructionClass : Byte {
 #define X(x) x,
 INSTRUCTION_CLASS
 #undef X
 };
 
+// instruction set to decode, the 80286 only adds protected mode instructions over the 80186, 
+// which are not decoded, so both levels share the same instructions in real mode
+#define CPU_LEVEL \
+    X(CPU_8086) \
+    X(CPU_80186) \
+    X(CPU_80286)
+enum CpuLevel : Byte {
+#define X(x) x,
+CPU_LEVEL
+#undef X
+};
+static constexpr Size CPU_LEVEL_COUNT = CPU_80286 + 1;
+
 #define INSTRUCTION_PREFIX \
     X(PRF_NONE) \
     X(PRF_SEG_ES) \
@@ -110,7 +133,7 @@ INSTRUCTION_CLASS
     X(PRF_SEG_DS) \
     X(PRF_CHAIN_REPNZ) \
     X(PRF_CHAIN_REPZ)
-enum InstructionPrefix {
+enum InstructionPrefix : Byte {
 #define X(x) x,
 INSTRUCTION_PREFIX
 #undef X
@@ -222,7 +245,7 @@ Register defaultMemSegment(const OperandType ot);
     X(OPRSZ_BYTE) \
     X(OPRSZ_WORD) \
     X(OPRSZ_DWORD)
-enum OperandSize {
+enum OperandSize : Byte {
 #define X(x) x,
 OPERAND_SIZE
 #undef X
@@ -255,6 +278,65 @@ INSTRUCTION_MATCH
 #undef X
 };
 
+// outcome of decoding, the decoder does not throw on bytes which are not a valid instruction
+#define INSTRUCTION_STATUS \
+    X(INS_STATUS_OK) \
+    X(INS_STATUS_INVALID) \
+    X(INS_STATUS_TRUNCATED)
+enum InstructionStatus : Byte {
+#define X(x) x,
+INSTRUCTION_STATUS
+#undef X
+};
+
+// Decoding properties of an opcode byte, merged from the per-property tables into one entry so that decoding 
+// an instruction needs a single lookup. The table is generated at compile time, with 8 entries per cache line.
+struct OpcodeDesc {
+    Byte iclass;           // InstructionClass, INS_ERR for group opcodes which take it from the modrm byte
+    Byte group;            // InstructionGroupIndex, IGRP_BAD for non-group opcodes
+    Byte op1, op2;         // OperandType of opcodes without a modrm byte
+    Byte modop1, modop2;   // ModrmOperand of opcodes with a modrm byte
+    Byte size1 : 4;        // OperandSize of the operands
+    Byte size2 : 4;
+    Byte modrm : 1;        // opcode is followed by a modrm byte
+    Byte isGroup : 1;      // instruction class is selected by the GRP field of the modrm byte
+    Byte segPrefix : 1;    // segment override prefix
+    Byte immSize : 3;      // bytes of immediate data, not including any modrm displacement and the implicit TEST immediate of group 3
+    Byte imm3 : 2;         // bytes of the immediate third operand of the 80186 three-operand imul, included in immSize
+};
+static_assert(sizeof(OpcodeDesc) == 8, "Unexpected opcode descriptor size");
+
+// Opcode descriptors for one CPU level, every level has its own table generated at compile time. The decoder
+// selects the table by the level once, so that looking up an opcode does not branch on the CPU type.
+struct OpcodeTable {
+    OpcodeDesc desc[0x100];
+    constexpr OpcodeTable(const CpuLevel cpu);
+};
+extern const OpcodeTable OPCODE_TABLE;
+const OpcodeTable& opcodeTable(const CpuLevel cpu);
+inline const OpcodeDesc& opcodeDesc(const Byte opcode) { return OPCODE_TABLE.desc[opcode]; }
+const char* cpu_level_name(const CpuLevel cpu);
+// accepts the level names as well as "8086", "186" and "286"
+CpuLevel cpuLevel(const std::string &name);
+
+// Length-only decoding for linear sweeps over code, never constructs an Instruction. The rules are the same as in
+// Instruction::load(), including the support for a single prefix byte, and sequences which it would reject
+// return a length of 0. At most INSTRUCTION_PEEK bytes are examined before the length is known.
+static constexpr Size INSTRUCTION_PEEK = 3; // prefix, opcode, modrm
+static constexpr Size INSTRUCTION_MAX = 7; // prefix, opcode, modrm, 16bit displacement and 16bit immediate
+Byte instructionLength(const Byte *data, const CpuLevel cpu = CPU_8086);
+// Sweep over a whole buffer, setting a bit for every offset at which an instruction begins (LSB first, 8 offsets per byte).
+// Bytes which do not decode as an instruction are skipped one at a time, returns the number of instructions found.
+Size instructionBoundaries(const Byte *data, const Size size, std::vector<Byte> &bitmap, const CpuLevel cpu = CPU_8086);
+inline bool isInstructionBoundary(const std::vector<Byte> &bitmap, const Offset off) { return bitmap[off >> 3] & (1 << (off & 7)); }
+
+struct InstructionRecord;
+
+// registers read and written by an instruction, including the flags and the registers of memory operand addresses
+struct RegisterEffect {
+    RegisterMask read, write;
+};
+
 class Instruction {
 public:
     Address addr;
@@ -262,6 +344,11 @@ public:
     Byte opcode;
     InstructionClass iclass;
     Byte length;
+    InstructionStatus status;
+    // Hash of the prefix, class and operand types of the instruction with immediate values and memory offsets masked, 
+    // set by the decoder. Operand types are normalized like in match(), so that instructions with different 
+    // fingerprints never match, which makes it usable for hash-based lookups and as a quick check before match().
+    DWord fingerprint;
     struct Operand {
         OperandType type;
         OperandSize size;
@@ -272,24 +359,32 @@ public:
         } immval; // optional immediate offset or literal value
 
         std::string toString() const;
+        void format(std::string &str) const;
         InstructionMatch match(const Operand &other) const;
         Register regId() const;
         Word wordValue() const;
     } op1, op2;
 
     Instruction();
-    Instruction(const Address &addr, const Byte *data);
+    // at least size bytes are readable at data, an instruction which does not fit into them is truncated
+    Instruction(const Address &addr, const Byte *data, const Size size = INSTRUCTION_MAX, const CpuLevel cpu = CPU_8086);
+    explicit Instruction(const InstructionRecord &rec);
+    InstructionRecord record() const;
     std::string toString(const bool extended = false) const;
+    // appends the same text as toString() to the string, without allocating if it has enough capacity
+    void format(std::string &str, const bool extended = false) const;
     InstructionMatch match(const Instruction &other) const;
-    void load(const Byte *data);
+    // same as the fingerprint, but also covering the immediate values and memory offsets
+    DWord valueFingerprint() const;
+    void load(const Byte *data, const Size size = INSTRUCTION_MAX, const CpuLevel cpu = CPU_8086);
     Word absoluteOffset() const;
     Address destinationAddress() const;
     SWord relativeOffset() const;
-    std::vector<Register> touchedRegs() const;
+    RegisterEffect registerEffect() const;
     SOffset memOffset() const;
     Register memSegmentId() const;
 
-    bool isValid() const { return iclass != INS_ERR; }
+    bool isValid() const { return status == INS_STATUS_OK; }
     bool isJump() const { return iclass == INS_JMP || iclass == INS_JMP_IF || iclass == INS_JMP_FAR; }
     bool isUnconditionalJump() const { return iclass == INS_JMP || iclass == INS_JMP_FAR; }
     bool isCall() const { return iclass == INS_CALL || iclass == INS_CALL_FAR; }
@@ -298,14 +393,41 @@ public:
     bool isNearJump() const { return iclass == INS_JMP || iclass == INS_JMP_IF || isLoop(); }
     bool isNearBranch() const { return isNearJump() || iclass == INS_CALL; }
     bool isReturn() const { return iclass == INS_RET || iclass == INS_RETF || iclass == INS_IRET; }
+    // the 80186 imul with an immediate third operand, which is kept in the unused value of the register operand
+    bool hasImmediate3() const { return iclass == INS_IMUL && op2.type != OPR_NONE; }
 
 private:
     OperandType getModrmOperand(const Byte modrm, const ModrmOperand op);
     Size loadImmediate(Operand &op, const Byte *data);
     const Operand* memOperand() const;
+    Word immediate3() const { return op1.immval.u16; }
+    uint64_t fingerprintKey() const;
+};
+
+// combines the fingerprints of an instruction sequence, e.g. for hashing whole routines or n-grams of instructions
+inline DWord fingerprintCombine(const DWord seed, const DWord fingerprint) { 
+    return seed ^ (fingerprint + 0x9e3779b9 + (seed << 6) + (seed >> 2)); 
+}
+
+// Packed form of a decoded instruction for keeping large numbers of them, like all the instructions of an executable.
+// The immediate values of both operands share a field, because only the far call/jump has a 32bit immediate, and
+// it has no second operand. Otherwise the low word holds the value of the first operand, the high word the second.
+struct InstructionRecord {
+    Address addr;
+    DWord imm;
+    Byte opcode;
+    Byte iclass;
+    Byte prefix : 3;
+    Byte length : 5;
+    Byte op1Type, op2Type;
+    Byte op1Size : 4;
+    Byte op2Size : 4;
+    Byte status;
 };
+static_assert(sizeof(InstructionRecord) <= 16, "Unexpected instruction record size");
 
 InstructionClass instr_class(const Byte opcode);
 const char* instr_class_name(const InstructionClass iclass);
+const char* instr_status_name(const InstructionStatus status);
 
 #endif // INSTRUCTION_H
\ No newline at end of file
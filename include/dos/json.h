@@ -0,0 +1,53 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+
+#include "dos/types.h"
+#include "dos/address.h"
+
+class OutputSink;
+
+// Writer of newline-delimited JSON records, one flat object per line. Fields are appended into a reused buffer which
+// is handed to the sink when the record is finished, so composing a record does not allocate once the buffer has grown.
+// The writer does not take ownership of the sink.
+class JsonWriter {
+private:
+    OutputSink &sink_;
+    std::string buf_;
+    Size count_;
+
+public:
+    explicit JsonWriter(OutputSink &sink) : sink_(sink), count_(0) {}
+    // start a new record with its "type" field
+    JsonWriter& begin(const char *type);
+    JsonWriter& field(const char *key, const char *val);
+    JsonWriter& field(const char *key, const std::string &val);
+    JsonWriter& field(const char *key, const bool val);
+    JsonWriter& field(const char *key, const int val) { return field(key, static_cast<SOffset>(val)); }
+    JsonWriter& field(const char *key, const Size val);
+    JsonWriter& field(const char *key, const SOffset val);
+    // fixed notation with 3 decimal places
+    JsonWriter& field(const char *key, const double val);
+    // segment:offset string, null if invalid
+    JsonWriter& field(const char *key, const Address &val);
+    // hex string of the bytes
+    JsonWriter& bytes(const char *key, const Byte *data, const Size size);
+    // string value produced by a callable appending to the buffer, it must not emit characters that need escaping
+    template<typename F> JsonWriter& raw(const char *key, const F &fn) {
+        key_(key);
+        buf_ += '"';
+        fn(buf_);
+        buf_ += '"';
+        return *this;
+    }
+    // finish the record and pass it to the sink
+    void end();
+    Size count() const { return count_; }
+
+private:
+    void key_(const char *key);
+    void string_(const char *str);
+};
+
+#endif // JSON_H
@@ -3,9 +3,45 @@
 
 #include <ostream>
 #include <array>
+#include <memory>
+#include <functional>
+#include <cstring>
+#include <vector>
 #include "dos/types.h"
 #include "dos/address.h"
 
+class MzImage;
+class OutputSink;
+class Memory;
+
+// Policies for the single byte and word accesses of Memory, deciding what happens on an access past its end.
+// Only the starting address is checked, the second byte of a word at the last address wraps around to the first one.
+// throws a MemoryError
+struct CheckedAccess {
+    static constexpr bool track = false;
+    static bool valid(const Memory &mem, const Offset addr, const bool write);
+};
+// calls the fault handler of the memory, then the read returns 0xff bytes and the write does nothing
+struct FaultAccess {
+    static constexpr bool track = false;
+    static bool valid(const Memory &mem, const Offset addr, const bool write);
+};
+// no check at all, only for addresses which are known to be in range, like the wrapped segmented addresses
+struct UncheckedAccess {
+    static constexpr bool track = false;
+    static constexpr bool valid(const Memory&, const Offset, const bool) { return true; }
+};
+// any of the above, with the access recorded in the access map of the memory if it has one
+template<typename Policy> struct TrackedAccess : public Policy {
+    static constexpr bool track = true;
+};
+// for addresses which are in range by construction, only verified in debug builds
+#ifdef NDEBUG
+using InRangeAccess = UncheckedAccess;
+#else
+using InRangeAccess = CheckedAccess;
+#endif
+
 // TODO: 
 // - implement MCBs
 
@@ -29,39 +65,191 @@
 0x100000 - 0x10FFEF: (64KiB - 16)
 --- extended memory available from protected mode only
 */
+
+enum AccessType : Byte {
+    ACCESS_READ,
+    ACCESS_WRITE,
+    ACCESS_EXEC,
+    ACCESS_TYPE_COUNT
+};
+
+// Record of which bytes of the memory were accessed in which way, a bitmap for every type of access, organized 
+// in 64 KiB segments of the linear memory. Only accesses through a TrackedAccess policy and executed instructions 
+// reported by the CPU are recorded.
+class AccessMap {
+public:
+    static constexpr Size SEGMENT_COUNT = MEM_TOTAL / SEGMENT_SIZE;
+    static constexpr Size SEGMENT_BITMAP_SIZE = SEGMENT_SIZE / 8;
+
+private:
+    std::vector<Byte> bits_[ACCESS_TYPE_COUNT];
+
+public:
+    AccessMap();
+    void mark(const Offset addr, const AccessType type) { bits_[type][addr >> 3] |= 1 << (addr & 7); }
+    void mark(const Offset addr, const Size size, const AccessType type);
+    bool test(const Offset addr, const AccessType type) const { return bits_[type][addr >> 3] & (1 << (addr & 7)); }
+    // bit n of the bitmap is set if linear address seg * 64 KiB + n was accessed
+    const Byte* segmentBitmap(const Size seg, const AccessType type) const { return bits_[type].data() + seg * SEGMENT_BITMAP_SIZE; }
+    // contiguous ranges of accessed bytes inside of the range, e.g. the executed code or the data touched by a routine
+    std::vector<Block> blocks(const AccessType type, const Block &range) const;
+    // bytes which were read or written, but not executed
+    std::vector<Block> dataBlocks(const Block &range) const;
+    void clear();
+};
+
+// The memory is kept in 4 KiB pages which are only allocated and filled with the initial pattern when first written,
+// reads from untouched pages return the pattern without allocating anything. The pages of one range of the memory, 
+// normally the loaded code, are kept in a single flat buffer, pointer() is only valid inside of that range.
+// Copies share their pages with the original, a shared page is only copied when one of them writes to it. The flat 
+// buffer is the exception, it is copied as a whole on the first write anywhere inside of it so that it stays 
+// contiguous. That replaces the buffer, so pointers into the memory are invalidated by writes, flatGeneration() 
+// changes whenever this happens.
+// Segmented addresses wrap around at 1 MiB like on the 8086 (with the A20 line disabled), and a word at offset 0xffff
+// continues at offset 0 of the same segment.
 class Memory {
+    friend struct CheckedAccess;
+    friend struct FaultAccess;
+
+public:
+    static constexpr Size MEM_PAGE_SIZE = 4_kB;
+    static constexpr Size MEM_PAGE_COUNT = MEM_TOTAL / MEM_PAGE_SIZE;
+    using FaultHandler = std::function<void(const Offset addr, const bool write)>;
+
 private:
     static constexpr Offset INIT_BREAK = 0x500; // beginning of free conventional memory block
     static constexpr Offset MEM_END = 0xa0000; // end of usable memory, start of UMA
 
 private:
-    std::array<Byte, MEM_TOTAL> data_;
+    using Buffer = std::shared_ptr<Byte>;
+    Buffer flat_;
+    Offset flatBegin_;
+    Size flatSize_;
+    Size flatGeneration_; // unique to the flat buffer, copies sharing it have the same value
+    std::array<Buffer, MEM_PAGE_COUNT> pages_; // pages outside of the flat range
+    std::array<Byte*, MEM_PAGE_COUNT> map_; // data of every page, either in the flat buffer or in pages_, null if untouched
     Offset break_;
+    FaultHandler fault_;
+    std::shared_ptr<AccessMap> access_; // shared between copies
 
 public:
     Memory();
     Memory(const Word segment, const Byte *data, const Size size);
+    // the load module of an image loaded with MzImage::load(), at its load segment
+    explicit Memory(const MzImage &mz);
+    // a copy of the memory which only pays for the pages written to afterwards, and the flat range as a whole
+    Memory fork() const { return *this; }
+    // the same for keeping the state to go back to with restore()
+    Memory snapshot() const { return *this; }
+    void restore(const Memory &snapshot) { *this = snapshot; }
     Size size() const { return MEM_TOTAL; }
     Size availableBlock() const { return BYTES_TO_PARA(MEM_END - break_); }
     Size availableBytes() const { return availableBlock() * PARAGRAPH_SIZE; }
     Offset freeStart() const { return break_; }
     Offset freeEnd() const { return MEM_END; }
+    // number of pages which are backed by allocated memory, and how many of them are not shared with other copies
+    Size pageCount() const;
+    Size privatePageCount() const;
 
     void allocBlock(const Size para);
     void freeBlock(const Size para);
-    Byte readByte(const Offset addr) const;
-    Word readWord(const Offset addr) const;
-    Byte readByte(const Address addr) const { return readByte(addr.toLinear()); }
-    Word readWord(const Address addr) const { return readWord(addr.toLinear()); }
-    void writeByte(const Offset addr, const Byte value);
-    void writeWord(const Offset addr, const Word value);
+    void setFaultHandler(const FaultHandler &handler) { fault_ = handler; }
+    // start recording the accesses through TrackedAccess policies
+    void enableAccessMap();
+    AccessMap* accessMap() const { return access_.get(); }
+    static Offset wrap(const Offset addr) { return addr & (MEM_TOTAL - 1); }
+
+    template<typename Policy = CheckedAccess> Byte readByte(const Offset addr) const {
+        if (!Policy::valid(*this, addr, false)) return 0xff;
+        if (Policy::track) track(addr, ACCESS_READ);
+        return pageData(addr)[pageOffset(addr)];
+    }
+    template<typename Policy = CheckedAccess> Word readWord(const Offset addr) const {
+        if (!Policy::valid(*this, addr, false)) return 0xffff;
+        if (Policy::track) track(addr, wrap(addr + 1), ACCESS_READ);
+        return readWordAt(addr, wrap(addr + 1));
+    }
+    template<typename Policy = CheckedAccess> void writeByte(const Offset addr, const Byte value) {
+        if (!Policy::valid(*this, addr, true)) return;
+        if (Policy::track) track(addr, ACCESS_WRITE);
+        page(addr)[pageOffset(addr)] = value;
+    }
+    template<typename Policy = CheckedAccess> void writeWord(const Offset addr, const Word value) {
+        if (!Policy::valid(*this, addr, true)) return;
+        if (Policy::track) track(addr, wrap(addr + 1), ACCESS_WRITE);
+        writeWordAt(addr, wrap(addr + 1), value);
+    }
+    // the linear address of a segmented address is always in range after the wraparound
+    template<typename Policy = CheckedAccess> Byte readByte(const Address &addr) const { 
+        return readByte<Policy>(wrap(addr.toLinear())); 
+    }
+    template<typename Policy = CheckedAccess> Word readWord(const Address &addr) const { 
+        const Offset lo = wrap(addr.toLinear());
+        if (!Policy::valid(*this, lo, false)) return 0xffff;
+        if (Policy::track) track(lo, nextByte(addr), ACCESS_READ);
+        return readWordAt(lo, nextByte(addr));
+    }
+    template<typename Policy = CheckedAccess> void writeByte(const Address &addr, const Byte value) { 
+        writeByte<Policy>(wrap(addr.toLinear()), value); 
+    }
+    template<typename Policy = CheckedAccess> void writeWord(const Address &addr, const Word value) { 
+        const Offset lo = wrap(addr.toLinear());
+        if (!Policy::valid(*this, lo, true)) return;
+        if (Policy::track) track(lo, nextByte(addr), ACCESS_WRITE);
+        writeWordAt(lo, nextByte(addr), value);
+    }
+    void readBuf(const Offset addr, Byte *data, const Size size) const;
     void writeBuf(const Offset addr, const Byte *data, const Size size);
-    const Byte* pointer(const Offset addr) const { return data_.cbegin() + addr; }
-    const Byte* pointer(const Address &addr) const { return data_.cbegin() + addr.toLinear(); }
-    const Byte* base() const { return pointer(0); }
+    // load module of the image with its relocations applied
+    void writeImage(const Offset addr, const MzImage &mz);
+    // extends the flat range to cover the area, after which pointer() can be used inside of it
+    void mapFlat(const Offset addr, const Size size);
+    Block flatRange() const { return flatSize_ ? Block{flatBegin_, flatBegin_ + flatSize_ - 1} : Block{}; }
+    // pointers obtained from pointer() or base() are only valid for as long as this stays the same
+    Size flatGeneration() const { return flatGeneration_; }
+    const Byte* pointer(const Offset addr) const { 
+        if (addr - flatBegin_ >= flatSize_) pointerError(addr);
+        return flat_.get() + (addr - flatBegin_); 
+    }
+    const Byte* pointer(const Address &addr) const { return pointer(addr.toLinear()); }
+    // start of the flat range
+    const Byte* base() const { return flat_.get(); }
+
+    // contiguous ranges inside of the range where the contents differ from the other memory, a buffer placed at the
+    // address or the contents of a file placed at the address
+    std::vector<Block> diff(const Memory &other, const Block &range) const;
+    std::vector<Block> diff(const Offset addr, const Byte *data, const Size size) const;
+    std::vector<Block> diffFile(const Offset addr, const std::string &path) const;
 
     std::string info() const;
     void dump(const Block &range, const std::string &path) const;
+    // hexdump of the 16-byte lines covering the sorted ranges, e.g. the result of diff(), streamed into the sink line by line
+    void hexDump(OutputSink &sink, const std::vector<Block> &ranges) const;
+
+private:
+    static Size pageNumber(const Offset addr) { return addr / MEM_PAGE_SIZE; }
+    static Offset pageOffset(const Offset addr) { return addr % MEM_PAGE_SIZE; }
+    static const Byte* patternPage();
+    static Offset nextByte(const Address &addr) { return wrap(SEG_TO_OFFSET(addr.segment) + static_cast<Word>(addr.offset + 1)); }
+    const Byte* pageData(const Offset addr) const {
+        const Byte *p = map_[pageNumber(addr)];
+        return p ? p : patternPage();
+    }
+    Word readWordAt(const Offset lo, const Offset hi) const {
+        Word ret;
+        if (hi == lo + 1 && pageOffset(lo) != MEM_PAGE_SIZE - 1) memcpy(&ret, pageData(lo) + pageOffset(lo), sizeof(ret));
+        else ret = pageData(lo)[pageOffset(lo)] | pageData(hi)[pageOffset(hi)] << 8;
+        return ret;
+    }
+    void writeWordAt(const Offset lo, const Offset hi, const Word value);
+    void track(const Offset addr, const AccessType type) const { if (access_) access_->mark(addr, type); }
+    void track(const Offset lo, const Offset hi, const AccessType type) const { 
+        if (access_) { access_->mark(lo, type); access_->mark(hi, type); }
+    }
+    static Buffer allocBuffer(const Size size);
+    Byte* page(const Offset addr);
+    void unshareFlat();
+    [[noreturn]] void pointerError(const Offset addr) const;
 };
 
 #endif // MEMORY_H
\ No newline at end of file
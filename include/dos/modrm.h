@@ -94,10 +94,10 @@ MODRM_OPERAND
 };
 
 // extract mod/reg/mem field from a ModR/M byte value
-inline Byte modrm_mod(const Byte modrm) { return modrm & MODRM_MOD_MASK; }
-inline Byte modrm_reg(const Byte modrm) { return modrm & MODRM_REG_MASK; }
-inline Byte modrm_grp(const Byte modrm) { return modrm & MODRM_GRP_MASK; }
-inline Byte modrm_mem(const Byte modrm) { return modrm & MODRM_MEM_MASK; }
+constexpr Byte modrm_mod(const Byte modrm) { return modrm & MODRM_MOD_MASK; }
+constexpr Byte modrm_reg(const Byte modrm) { return modrm & MODRM_REG_MASK; }
+constexpr Byte modrm_grp(const Byte modrm) { return modrm & MODRM_GRP_MASK; }
+constexpr Byte modrm_mem(const Byte modrm) { return modrm & MODRM_MEM_MASK; }
 ModrmOperand modrm_op1(const Byte opcode);
 ModrmOperand modrm_op2(const Byte opcode);
 
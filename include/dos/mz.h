@@ -7,6 +7,7 @@
 #include <ostream>
 #include "dos/types.h"
 #include "dos/address.h"
+#include "dos/search.h"
 
 static constexpr Size MAX_COMFILE_SIZE = 0xff00;
 static constexpr Size MZ_HEADER_SIZE = 14 * sizeof(Word);
@@ -14,6 +15,13 @@ static constexpr Size MZ_RELOC_SIZE = 2 * sizeof(Word);
 static constexpr Word MZ_SIGNATURE = 0x5A4D;
 
 class MzImage {
+public:
+    // relocated value of a word in the load module
+    struct RelocationPatch {
+        Offset offset;
+        Word value;
+    };
+
 private:
 
 #pragma pack(push, 1)
@@ -47,6 +55,11 @@ private:
     Size filesize_, loadModuleSize_;
     std::vector<Byte> loadModuleData_, ovlinfo_;
     std::vector<Relocation> relocs_;
+    std::vector<RelocationPatch> patches_; // sorted by offset
+    // the file is parsed from a read-only mapping, which also backs the load module unless it is given directly in loadModuleData_
+    const Byte *data_;
+    void *mapping_;
+    Size mappingSize_;
     Offset loadModuleOffset_;
     Address entrypoint_;
     Word loadSegment_;
@@ -56,20 +69,36 @@ public:
     // useful for testing
     MzImage(const std::vector<Byte> &code); 
     MzImage(const MzImage &other) = delete;
+    ~MzImage();
     const std::string& path() const { return path_; }
     std::string dump() const;
     Size headerLength() const { return header_.header_paragraphs * PARAGRAPH_SIZE; }
     Size loadModuleSize() const { return loadModuleSize_; }
     Offset loadModuleOffset() const { return loadModuleOffset_; }
-    const Byte* loadModuleData() const { return loadModuleData_.data(); }
+    // the load module as stored in the file, without the relocations applied
+    const Byte* loadModuleData() const { return data_; }
+    // the relocations to apply on top of the load module data, valid after load()
+    const std::vector<RelocationPatch>& relocationPatches() const { return patches_; }
+    // byte of the load module with the relocations applied
+    Byte loadModuleByte(const Offset off) const;
     Word loadSegment() const { return loadSegment_; }
     Size minAlloc() const { return header_.min_extra_paragraphs * PARAGRAPH_SIZE; }
     Size maxAlloc() const { return header_.max_extra_paragraphs * PARAGRAPH_SIZE; }
     // TODO: should be relocated (i.e. apply loadSegment_)? 
     Address entrypoint() const { return Address(header_.cs, header_.ip); }
     Address stackPointer() const { return Address(header_.ss, header_.sp); }
+    // places in the relocated load module matching the patterns of bytes and -1 wildcards, see PatternSearch
     Address find(const std::vector<SWord> &pattern) const;
+    std::vector<Address> findAll(const std::vector<SWord> &pattern) const;
+    // all the patterns searched in one pass
+    std::vector<PatternSearch::Match> findAll(const std::vector<std::vector<SWord>> &patterns) const;
+    // computes the relocations for the segment the load module is loaded at
     void load(const Word loadSegment);
+
+private:
+    void map();
+    void unmap();
+    void parse();
 };
 
 #endif // MZ_H
\ No newline at end of file
@@ -117,22 +117,22 @@ enum Opcode : Byte {
     OP_POP_SI     = 0x5e,
     OP_POP_DI     = 0x5f,
 
-    // 0x60
-    // 0x61
-    // 0x62
-    // 0x63
+    OP_PUSHA      = 0x60, // 80186+
+    OP_POPA       = 0x61, // 80186+
+    OP_BOUND_Gv_M = 0x62, // 80186+
+    // 0x63, arpl, protected mode only
     // 0x64
     // 0x65
     // 0x66
     // 0x67
-    // 0x68
-    // 0x69
-    // 0x6a
-    // 0x6b
-    // 0x6c
-    // 0x6d
-    // 0x6e
-    // 0x6f
+    OP_PUSH_Iv    = 0x68, // 80186+
+    OP_IMUL_Gv_Ev_Iv = 0x69, // 80186+
+    OP_PUSH_Ib    = 0x6a, // 80186+
+    OP_IMUL_Gv_Ev_Ib = 0x6b, // 80186+
+    OP_INSB       = 0x6c, // 80186+
+    OP_INSW       = 0x6d, // 80186+
+    OP_OUTSB      = 0x6e, // 80186+
+    OP_OUTSW      = 0x6f, // 80186+
     
     OP_JO_Jb      = 0x70,
     OP_JNO_Jb     = 0x71,
@@ -219,16 +219,16 @@ enum Opcode : Byte {
     OP_MOV_SI_Iv  = 0xbe,
     OP_MOV_DI_Iv  = 0xbf,
 
-    // 0xc0
-    // 0xc1
+    OP_GRP2_Eb_Ib = 0xc0, // 80186+
+    OP_GRP2_Ev_Ib = 0xc1, // 80186+
     OP_RET_Iw     = 0xc2,
     OP_RET        = 0xc3,
     OP_LES_Gv_Mp  = 0xc4,
     OP_LDS_Gv_Mp  = 0xc5,
     OP_MOV_Eb_Ib  = 0xc6,
     OP_MOV_Ev_Iv  = 0xc7,
-    // 0xc8
-    // 0xc9
+    OP_ENTER_Iw_Ib = 0xc8, // 80186+
+    OP_LEAVE      = 0xc9, // 80186+
     OP_RETF_Iw    = 0xca,
     OP_RETF       = 0xcb,
     OP_INT_3      = 0xcc,
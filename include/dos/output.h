@@ -2,6 +2,10 @@
 #define OUTPUT_H
 
 #include <string>
+#include <type_traits>
+#include <utility>
+
+#include "dos/util.h"
 
 enum LogModule {
     LOG_SYSTEM,
@@ -32,26 +36,84 @@ enum Color {
 };
 
 void output(const std::string &msg, const LogModule mod, const LogPriority pri = LOG_INFO, const bool suppressNewline = false);
+bool outputEnabled(const LogModule mod, const LogPriority pri);
+// wait until all messages output so far have been written
+void outputFlush();
+// takes ownership of the sink, nullptr reverts to the default asynchronous stdout sink
+class OutputSink;
+void setOutputSink(OutputSink *sink);
 void setOutputLevel(const LogPriority minPriority);
 void setModuleVisibility(const LogModule mod, const bool visible);
 std::string output_color(const Color c);
 
+// lowest priority compiled into the binaries, messages below it are eliminated along with the formatting of their arguments
+#ifndef LOG_COMPILE_MIN
+#ifdef NDEBUG
+#define LOG_COMPILE_MIN LOG_VERBOSE
+#else
+#define LOG_COMPILE_MIN LOG_DEBUG
+#endif
+#endif
+
+// Deferred formatting of log message arguments: the pieces of a message are passed as separate arguments 
+// and only get converted to text after the priority check passed. Anything with a format(std::string&) method
+// appends itself to the message, otherwise a toString() method is used. Callables are either invoked for their 
+// string result, or with the message string to append to, which is useful for expensive formatting.
+template<typename T> struct HexArg { const T val; };
+// hexVal() of the value, rendered only if the message is output
+template<typename T> HexArg<T> hexArg(const T val) { return { val }; }
+
+inline void logAppend(std::string &str, const std::string &arg) { str += arg; }
+inline void logAppend(std::string &str, const char *arg) { str += arg; }
+inline void logAppend(std::string &str, const char arg) { str += arg; }
+template<typename T> void logAppend(std::string &str, const HexArg<T> &arg) { str += hexVal(arg.val); }
+template<typename T> typename std::enable_if<std::is_arithmetic<T>::value>::type logAppend(std::string &str, const T arg) { str += std::to_string(arg); }
+template<typename T, typename = void> struct HasFormat : std::false_type {};
+template<typename T> struct HasFormat<T, decltype(std::declval<const T&>().format(std::declval<std::string&>()), void())> : std::true_type {};
+template<typename T> auto logAppend(std::string &str, const T &arg) -> decltype(arg.format(str), void()) { arg.format(str); }
+template<typename T> auto logAppend(std::string &str, const T &arg) -> typename std::enable_if<!HasFormat<T>::value, decltype(arg.toString(), void())>::type { str += arg.toString(); }
+template<typename T> auto logAppend(std::string &str, const T &arg) -> decltype(str += arg(), void()) { str += arg(); }
+template<typename T> auto logAppend(std::string &str, const T &arg) -> decltype(arg(str), void()) { arg(str); }
+
+template<typename... Args> void logAppendAll(std::string &str, const Args&... args) {
+    using expand = int[];
+    (void)expand{ 0, (logAppend(str, args), 0)... };
+}
+
+template<typename... Args> std::string logString(const Args&... args) {
+    std::string str;
+    logAppendAll(str, args...);
+    return str;
+}
+
+// per-thread message buffer reused by logOutput(), so that composing a message does not allocate once it has grown;
+// formatting the arguments must not produce log output itself
+std::string& logBuffer();
+
+template<LogPriority pri, typename... Args> inline void logOutput(const LogModule mod, const Args&... args) {
+    if (pri < LOG_COMPILE_MIN || !outputEnabled(mod, pri)) return;
+    std::string &str = logBuffer();
+    str.clear();
+    logAppendAll(str, args...);
+    output(str, mod, pri);
+}
+
 // create output functions for a system module
 #define OUTPUT_CONF(module) \
-static void debug(const std::string &msg) {\
-    output(msg, module, LOG_DEBUG);\
+template<typename... Args> static void debug(const Args&... args) {\
+    logOutput<LOG_DEBUG>(module, args...);\
 }\
-static void verbose(const std::string &msg) {\
-    output(msg, module, LOG_VERBOSE);\
+template<typename... Args> static void verbose(const Args&... args) {\
+    logOutput<LOG_VERBOSE>(module, args...);\
 }\
-static void info(const std::string &msg) {\
-    output(msg, module, LOG_INFO);\
+template<typename... Args> static void info(const Args&... args) {\
+    logOutput<LOG_INFO>(module, args...);\
 }\
-static void error(const std::string &msg) {\
-    output("ERROR: "s + msg, module, LOG_ERROR);\
+template<typename... Args> static void error(const Args&... args) {\
+    logOutput<LOG_ERROR>(module, "ERROR: ", args...);\
 }\
-static void warn(const std::string &msg) {\
-    output("WARNING: "s + msg, module, LOG_WARN);\
+template<typename... Args> static void warn(const Args&... args) {\
+    logOutput<LOG_WARN>(module, "WARNING: ", args...);\
 }
 
 #endif // OUTPUT_H
@@ -14,6 +14,10 @@ enum Register {
     REG_IP, REG_FLAGS,
 };
 
+// set of registers with one bit per register, REG_NONE is the empty set
+using RegisterMask = DWord;
+inline constexpr RegisterMask regMask(const Register r) { return r == REG_NONE ? 0 : 1u << r; }
+
 inline bool regIsByte(const Register reg) { return reg >= REG_AL && reg <= REG_DH; }
 inline bool regIsWord(const Register reg) { return reg >= REG_AX; }
 inline bool regIsGeneral(const Register reg) { return reg >= REG_AX && reg <= REG_DX; }
@@ -79,6 +83,7 @@ public:
     Word getValue(const Register r) const;
     void setValue(const Register r, const Word value);
     void setUnknown(const Register r);
+    void setUnknown(const RegisterMask mask);
     std::string regString(const Register r) const;
     std::string toString() const;
 
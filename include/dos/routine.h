@@ -48,6 +48,7 @@ class RoutineMap {
     Size codeSize;
     std::vector<Routine> routines;
     std::vector<Block> unclaimed;
+    std::vector<Block> dataBlocks; // suspected data, not claimed by any routine
     std::vector<Segment> segments;
     // TODO: turn these into a context struct, pass around instead of members
     RoutineId curId, prevId, curBlockId, prevBlockId;
@@ -67,6 +68,7 @@ public:
     void save(const std::string &path, const Word reloc, const bool overwrite = false) const;
     std::string dump() const;
     const auto& getSegments() const { return segments; }
+    const auto& getDataBlocks() const { return dataBlocks; }
     Size segmentCount(const Segment::Type type) const;
     Segment findSegment(const Word addr) const;
     Segment findSegment(const std::string &name) const;
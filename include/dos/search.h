@@ -0,0 +1,59 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "dos/types.h"
+
+// Search for byte patterns in a buffer, where the pattern values are bytes or -1 for a wildcard matching any byte,
+// as produced by hexaToNumeric(). A single pattern is searched with Boyer-Moore-Horspool, or by scanning for one of its
+// bytes with memchr() when the wildcards leave Horspool no room to skip. Multiple patterns are searched in one pass with
+// an Aho-Corasick automaton over the longest run of fixed bytes of every pattern, the hits of which are verified
+// against the complete pattern.
+class PatternSearch {
+public:
+    struct Match {
+        Offset offset;
+        Size pattern; // index of the pattern
+        bool operator==(const Match &other) const { return offset == other.offset && pattern == other.pattern; }
+    };
+
+private:
+    using Pattern = std::vector<SWord>;
+    // run of fixed bytes in a pattern
+    struct Key {
+        Size begin, size;
+    };
+    // state of the Aho-Corasick automaton, with the transitions for all bytes filled in
+    struct State {
+        std::array<uint32_t, 256> next;
+        std::vector<Size> output; // patterns with their key ending in this state
+    };
+
+    std::vector<Pattern> patterns_;
+    std::vector<Key> keys_;
+    // single pattern
+    std::array<Size, 256> shift_;
+    bool horspool_;
+    // multiple patterns
+    std::vector<State> states_;
+    std::vector<Size> wildcards_; // patterns with no fixed bytes
+
+public:
+    explicit PatternSearch(const Pattern &pattern);
+    explicit PatternSearch(const std::vector<Pattern> &patterns);
+    Size patternCount() const { return patterns_.size(); }
+    // all places where the patterns match, ordered by offset and the pattern index
+    std::vector<Match> findAll(const Byte *data, const Size size) const;
+
+private:
+    bool matches(const Pattern &pattern, const Byte *data) const;
+    void findSingle(const Byte *data, const Size size, std::vector<Match> &hits) const;
+    void findMultiple(const Byte *data, const Size size, std::vector<Match> &hits) const;
+    void buildShifts();
+    void buildAutomaton();
+};
+
+#endif // SEARCH_H
@@ -0,0 +1,69 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <cstdio>
+
+#include "dos/types.h"
+
+// destination of the messages passed through output()
+class OutputSink {
+public:
+    virtual ~OutputSink() {}
+    virtual void write(const std::string &msg, const bool newline) = 0;
+    // block until everything written so far has reached its destination
+    virtual void flush() = 0;
+};
+
+// synchronous sink into a stream, does not flush on every line
+class StreamSink : public OutputSink {
+private:
+    std::ostream &stream_;
+
+public:
+    explicit StreamSink(std::ostream &stream) : stream_(stream) {}
+    void write(const std::string &msg, const bool newline) override;
+    void flush() override;
+};
+
+// Messages are copied into a lock-free single producer/single consumer ring buffer and drained by a background
+// writer thread, which hands whatever accumulated in the ring to the file in one batch. A full ring stalls the producer
+// until the writer catches up. Destroying the sink flushes all pending output.
+class AsyncSink : public OutputSink {
+private:
+    std::FILE *file_;
+    bool ownFile_;
+    std::vector<char> ring_;
+    const Size mask_;
+    // monotonically increasing positions, the producer advances the tail and the writer advances the head
+    std::atomic<Size> head_, tail_;
+    std::atomic<bool> idle_, stop_;
+    Size flushed_;
+    std::mutex mutex_;
+    std::condition_variable wake_, drained_;
+    std::thread writer_;
+
+public:
+    static constexpr Size DEFAULT_CAPACITY = 1 << 20;
+    // capacity gets rounded up to a power of two
+    explicit AsyncSink(std::FILE *file, const Size capacity = DEFAULT_CAPACITY);
+    explicit AsyncSink(const std::string &path, const Size capacity = DEFAULT_CAPACITY);
+    ~AsyncSink();
+    void write(const std::string &msg, const bool newline) override;
+    void flush() override;
+    Size capacity() const { return ring_.size(); }
+
+private:
+    void start();
+    void put(const char *data, Size size);
+    void wakeWriter();
+    void run();
+};
+
+#endif // SINK_H
@@ -0,0 +1,39 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <vector>
+#include <cstdint>
+#include <string>
+
+#include "dos/types.h"
+#include "dos/address.h"
+#include "dos/instruction.h"
+
+// Lazily populated store of the decoded instructions of a code area, every offset is decoded at most once and
+// subsequent lookups are served from the store. The instructions are kept as packed 16-byte records, a per-byte
+// index maps linear offsets in the area to their records.
+// The store does not keep a reference to the code, the caller passes the bytes at the looked up address.
+// The instructions are decoded for the CPU level given on construction.
+class InstructionStore {
+private:
+    Offset base_;
+    CpuLevel cpu_;
+    std::vector<uint32_t> index_; // record number + 1 for every byte of the area, 0 if not decoded yet
+    std::vector<InstructionRecord> records_;
+    Size hits_, misses_;
+
+public:
+    InstructionStore() : base_(0), cpu_(CPU_8086), hits_(0), misses_(0) {}
+    InstructionStore(const Offset base, const Size size, const CpuLevel cpu = CPU_8086) : base_(base), cpu_(cpu), index_(size, 0), hits_(0), misses_(0) {}
+    // the instruction at the address, data points to its bytes
+    Instruction get(const Address &addr, const Byte *data);
+    bool contains(const Offset off) const { return off >= base_ && off - base_ < index_.size(); }
+    // number of distinct instructions decoded so far
+    Size size() const { return records_.size(); }
+    Size hits() const { return hits_; }
+    Size misses() const { return misses_; }
+    void resetStats() { hits_ = misses_ = 0; }
+    std::string statusString() const;
+};
+
+#endif // STORE_H
@@ -0,0 +1,108 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+#include "dos/types.h"
+#include "dos/address.h"
+
+// Binary trace of analysis events, an alternative to wading through --debug output. Events are appended as fixed-size
+// records into a memory-mapped file, and can be filtered and printed offline with the mztrace tool.
+#define TRACE_EVENT \
+    X(TRC_NONE) \
+    X(TRC_SEARCH) \
+    X(TRC_CALL) \
+    X(TRC_JUMP) \
+    X(TRC_CLAIM) \
+    X(TRC_CODEMAP) \
+    X(TRC_DATAMAP) \
+    X(TRC_STACKMAP) \
+    X(TRC_MISMATCH) \
+    X(TRC_SEED) \
+    X(TRC_DATA)
+enum TraceEvent : Byte {
+#define X(x) x,
+TRACE_EVENT
+#undef X
+TRC_COUNT
+};
+
+// meaning of the fields depends on the event:
+// TRC_SEARCH:   search point taken from a scan queue, addr = location, value = remaining queue size, flags = 1 for call
+// TRC_CALL:     call destination queued as a new routine, addr = destination, value = previous owner routine
+// TRC_JUMP:     jump destination queued, addr = destination
+// TRC_CLAIM:    bytes marked as belonging to a routine, addr = start, value = byte count
+// TRC_CODEMAP:  code address mapping, addr = reference address, aux = target address
+// TRC_DATAMAP:  data offset mapping, aux = reference offset, value = target offset
+// TRC_STACKMAP: stack offset mapping, aux = reference offset, value = target offset
+// TRC_MISMATCH: instruction mismatch, addr = reference address, aux = target address, flags = skip type
+// TRC_SEED:     unreachable routine prologue queued as a new routine, addr = location
+// TRC_DATA:     bytes which do not decode reached by the search, addr = start, value = byte count
+// for the mapping events, flags = 1 indicates a conflict with an existing mapping instead of a registration
+struct TraceRecord {
+    Byte event;
+    Byte flags;
+    Word routine;
+    DWord addr; // segment:offset
+    DWord aux;
+    DWord value;
+
+    Address address() const { return Address(addr >> 16, addr & 0xffff); }
+    Address auxAddress() const { return Address(aux >> 16, aux & 0xffff); }
+    std::string toString() const;
+};
+static_assert(sizeof(TraceRecord) == 16, "Unexpected trace record size");
+
+inline DWord traceAddr(const Address &a) { return static_cast<DWord>(a.segment) << 16 | a.offset; }
+const char* traceEventName(const TraceEvent ev);
+TraceEvent traceEventFromName(const std::string &name);
+
+class TraceWriter {
+    int fd_;
+    TraceRecord *records_;
+    Size count_, capacity_;
+
+public:
+    explicit TraceWriter(const std::string &path);
+    ~TraceWriter();
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    void append(const TraceRecord &rec) {
+        if (count_ == capacity_) grow();
+        records_[count_++] = rec;
+    }
+    Size count() const { return count_; }
+
+private:
+    void map(const Size capacity);
+    void unmap();
+    void grow();
+};
+
+class TraceReader {
+    int fd_;
+    Size mapSize_;
+    const Byte *data_;
+    const TraceRecord *records_;
+    Size count_;
+
+public:
+    explicit TraceReader(const std::string &path);
+    ~TraceReader();
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+    Size size() const { return count_; }
+    const TraceRecord* begin() const { return records_; }
+    const TraceRecord* end() const { return records_ + count_; }
+};
+
+// global trace destination, no events are recorded unless a trace file was opened
+extern TraceWriter *traceOut;
+void traceOpen(const std::string &path);
+void traceClose();
+
+inline void trace(const TraceEvent ev, const Address &addr, const int routine = 0, const DWord aux = 0, const DWord value = 0, const Byte flags = 0) {
+    if (traceOut) traceOut->append({ ev, flags, static_cast<Word>(routine), traceAddr(addr), aux, value });
+}
+
+#endif // TRACE_H
@@ -5,6 +5,7 @@
 #include "dos/address.h"
 #include "dos/error.h"
 #include "dos/util.h"
+#include "dos/format.h"
 
 using namespace std;
 
@@ -51,13 +52,8 @@ Address Address::operator+(const DWord arg) const {
 }
 
 std::string Address::toString(const bool brief) const {
-    ostringstream str;
-    if (isValid()) {
-        str << std::hex << std::setw(WORD_STRLEN) << std::setfill('0') << segment << ":" << std::setw(WORD_STRLEN) << std::setfill('0') << offset;
-        if (!brief) str << "/" << setw(OFFSET_STRLEN) << toLinear();
-    }
-    else str << "(invalid)";
-    return str.str();
+    char buf[ADDR_STRMAX];
+    return string(buf, formatAddress(buf, *this, brief));
 }
 
 // move bulk of the offset to the segment part, limit offset to the modulus of a paragraph
@@ -120,12 +116,8 @@ Block::Block(const std::string &from, const std::string &to) {
 }
 
 std::string Block::toString(const bool linear, const bool showSize) const {
-    if (!isValid()) return "[invalid]";
-    ostringstream str;
-    if (!linear) str << begin.toString(true) << "-" << end.toString(true);
-    else str << hexVal(begin.toLinear(), false, OFFSET_STRLEN) << "-" << hexVal(end.toLinear(), false, OFFSET_STRLEN);
-    if (showSize) str << "/" << hex << setw(OFFSET_STRLEN) << setfill('0') << size();
-    return str.str();
+    char buf[BLOCK_STRMAX];
+    return string(buf, formatBlock(buf, *this, linear, showSize));
 }
 
 // check if blocks overlap each other (by at least one byte)
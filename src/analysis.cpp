@@ -3,6 +3,7 @@
 #include "dos/output.h"
 #include "dos/util.h"
 #include "dos/error.h"
+#include "dos/trace.h"
 
 #include <iostream>
 #include <istream>
@@ -46,12 +47,14 @@ void ScanQueue::setRoutineId(Offset off, const Size length, RoutineId id) {
     if (id == NULL_ROUTINE) id = curSearch.routineId;
     assert(off < visited.size());
     fill(visited.begin() + off, visited.begin() + off + length, id);
+    trace(TRC_CLAIM, Address{off}, id, 0, length);
 }
 
 Destination ScanQueue::nextPoint() {
     if (!empty()) {
         curSearch = queue.front();
         queue.pop_front();
+        trace(TRC_SEARCH, curSearch.address, curSearch.routineId, 0, size(), curSearch.isCall);
     }
     return curSearch;
 }
@@ -90,16 +93,17 @@ vector<Routine> ScanQueue::getRoutines() const {
 bool ScanQueue::saveCall(const Address &dest, const RegisterState &regs, const bool near) {
     const RoutineId destId = getRoutineId(dest.toLinear());
     if (isEntrypoint(dest)) 
-        debug("Address "s + dest.toString() + " already registered as entrypoint for routine " + to_string(destId));
+        debug("Address ", dest, " already registered as entrypoint for routine ", destId);
     else if (hasPoint(dest, true)) 
-        debug("Search queue already contains call to address "s + dest.toString());
+        debug("Search queue already contains call to address ", dest);
     else { // not a known entrypoint and not yet in queue
         Size newRoutineId = routineCount() + 1;
         if (destId == NULL_ROUTINE)
-            debug("call destination not belonging to any routine, claiming as entrypoint for new routine " + to_string(newRoutineId));
+            debug("call destination not belonging to any routine, claiming as entrypoint for new routine ", newRoutineId);
         else 
-            debug("call destination belonging to routine " + to_string(destId) + ", reclaiming as entrypoint for new routine " + to_string(newRoutineId));
+            debug("call destination belonging to routine ", destId, ", reclaiming as entrypoint for new routine ", newRoutineId);
         queue.emplace_back(Destination(dest, newRoutineId, true, regs));
+        trace(TRC_CALL, dest, newRoutineId, 0, destId);
         entrypoints.emplace_back(RoutineEntrypoint(dest, newRoutineId, near));
         return true;
     }
@@ -110,17 +114,68 @@ bool ScanQueue::saveCall(const Address &dest, const RegisterState &regs, const b
 bool ScanQueue::saveJump(const Address &dest, const RegisterState &regs) {
     const RoutineId destId = getRoutineId(dest.toLinear());
     if (destId != NULL_ROUTINE) 
-        debug("Jump destination already visited from routine "s + to_string(destId));
+        debug("Jump destination already visited from routine ", destId);
     else if (hasPoint(dest, false))
-        debug("Queue already contains jump to address "s + dest.toString());
+        debug("Queue already contains jump to address ", dest);
     else { // not claimed by any routine and not yet in queue
-        debug("Jump destination not yet visited, scheduled visit from routine " + to_string(curSearch.routineId) + ", queue size = " + to_string(size()));
+        debug("Jump destination not yet visited, scheduled visit from routine ", curSearch.routineId, ", queue size = ", size());
         queue.emplace_front(Destination(dest, curSearch.routineId, false, regs));
+        trace(TRC_JUMP, dest, curSearch.routineId);
         return true;
     }
     return false;
 }
 
+// routine entrypoint candidate from outside of the reachable code, only queued once the search runs out of other locations
+bool ScanQueue::saveSeed(const Address &dest) {
+    const RoutineId destId = getRoutineId(dest.toLinear());
+    if (destId != NULL_ROUTINE || isEntrypoint(dest) || hasPoint(dest, true)) return false;
+    const Size newRoutineId = routineCount() + 1;
+    debug("unclaimed routine prologue at ", dest, ", seeding search for new routine ", newRoutineId);
+    queue.emplace_back(Destination(dest, newRoutineId, true, {}));
+    trace(TRC_SEED, dest, newRoutineId);
+    // the kind of return the routine ends with is not known, assume near like most of them
+    entrypoints.emplace_back(RoutineEntrypoint(dest, newRoutineId, true));
+    return true;
+}
+
+// bytes which do not decode as an instruction, most likely the search followed a branch into data
+void ScanQueue::saveData(const Block &b) {
+    debug("suspected data at ", b);
+    trace(TRC_DATA, b.begin, curSearch.routineId, 0, b.size());
+    dataBlocks.push_back(b);
+}
+
+vector<Offset> findPrologues(const Byte *data, const Size size, const CpuLevel cpu) {
+    // push bp followed by the two encodings of mov bp, sp
+    static const Byte PUSH_BP = 0x55;
+    static const Byte MOV_BP_SP[][2] = { { 0x8b, 0xec }, { 0x89, 0xe5 } };
+    vector<Offset> ret;
+    if (size < 3) return ret;
+    const Byte *p = data, *const end = data + size - 2;
+    // memchr goes through the bytes at vector width, so most of the buffer is skipped quickly
+    while ((p = static_cast<const Byte*>(memchr(p, PUSH_BP, end - p))) != nullptr) {
+        for (const auto &mov : MOV_BP_SP) {
+            if (p[1] == mov[0] && p[2] == mov[1]) {
+                ret.push_back(p - data);
+                break;
+            }
+        }
+        if (++p >= end) break;
+    }
+    if (cpu < CPU_80186 || size < 4) return ret;
+    // the 80186 enter with a nesting level of 0 does the same in one instruction
+    const size_t pushCount = ret.size();
+    p = data;
+    const Byte *const enterEnd = data + size - 3;
+    while ((p = static_cast<const Byte*>(memchr(p, OP_ENTER_Iw_Ib, enterEnd - p))) != nullptr) {
+        if (p[3] == 0) ret.push_back(p - data);
+        if (++p >= enterEnd) break;
+    }
+    inplace_merge(ret.begin(), ret.begin() + pushCount, ret.end());
+    return ret;
+}
+
 // This is very slow!
 void ScanQueue::dumpVisited(const string &path, const Offset start, Size size) const {
     // dump map to file for debugging
@@ -132,7 +187,7 @@ void ScanQueue::dumpVisited(const string &path, const Offset start, Size size) c
     info("Dumping visited map of size "s + hexVal(size) + " starting at " + hexVal(start) + " to " + path);
     for (Offset mapOffset = start; mapOffset < start + size; ++mapOffset) {
         const auto id = getRoutineId(mapOffset);
-        //debug(hexVal(mapOffset) + ": " + to_string(m));
+        //debug(hexArg(mapOffset), ": ", m);
         const Offset printOffset = mapOffset - start;
         if (printOffset % 16 == 0) {
             if (printOffset != 0) mapFile << endl;
@@ -150,14 +205,16 @@ bool OffsetMap::codeMatch(const Address from, const Address to) {
     if (codeMap.count(from) > 0) {
         auto &found = codeMap[from];
         if (found == to) {
-            debug("Existing code address mapping " + from.toString() + " -> " + to.toString() + " matches");
+            debug("Existing code address mapping ", from, " -> ", to, " matches");
             return true;
         }
-        debug("Existing code address mapping " + from.toString() + " -> " + found.toString() + " conflicts with " + to.toString());
+        debug("Existing code address mapping ", from, " -> ", found, " conflicts with ", to);
+        trace(TRC_CODEMAP, from, 0, traceAddr(to), 0, 1);
         return false;
     }
     // otherwise save new mapping
-    debug("Registering new code address mapping: " + from.toString() + " -> " + to.toString());
+    debug("Registering new code address mapping: ", from, " -> ", to);
+    trace(TRC_CODEMAP, from, 0, traceAddr(to));
     codeMap[from] = to;
     return true;    
 }
@@ -166,18 +223,20 @@ bool OffsetMap::dataMatch(const SOffset from, const SOffset to) {
     auto &mappings = dataMap[from];
     // matching mapping already exists in map
     if (std::find(begin(mappings), end(mappings), to) != mappings.end()) {
-        debug("Existing data offset mapping " + hexVal(from) + " -> " + dataStr(mappings) + " matches");
+        debug("Existing data offset mapping ", hexArg(from), " -> ", [&]{ return dataStr(mappings); }, " matches");
         return true;
     }
     // mapping does not exist, but still room left, so save it and carry on
     else if (mappings.size() < maxData) {
-        debug("Registering new data offset mapping: " + hexVal(from) + " -> " + hexVal(to));
+        debug("Registering new data offset mapping: ", hexArg(from), " -> ", hexArg(to));
+        trace(TRC_DATAMAP, {}, 0, from, to);
         mappings.push_back(to);
         return true;
     }
     // no matching mapping and limit already reached
     else {
-        debug("Existing data offset mapping " + hexVal(from) + " -> " + dataStr(mappings) + " conflicts with " + hexVal(to));
+        debug("Existing data offset mapping ", hexArg(from), " -> ", [&]{ return dataStr(mappings); }, " conflicts with ", hexArg(to));
+        trace(TRC_DATAMAP, {}, 0, from, to, 1);
         return false;
     }
 }
@@ -186,13 +245,15 @@ bool OffsetMap::stackMatch(const SOffset from, const SOffset to) {
     // mapping already exists
     if (stackMap.count(from) > 0) {
         if (stackMap[from] == to) {
-            debug("Existing stack offset mapping " + hexVal(from) + " -> " + hexVal(to) + " matches");
+            debug("Existing stack offset mapping ", hexArg(from), " -> ", hexArg(to), " matches");
             return true;
         }
+        trace(TRC_STACKMAP, {}, 0, from, to, 1);
         return false;
     }
     // otherwise save new mapping
-    debug("Registering new stack offset mapping: " + hexVal(from) + " -> " + hexVal(to));
+    debug("Registering new stack offset mapping: ", hexArg(from), " -> ", hexArg(to));
+    trace(TRC_STACKMAP, {}, 0, from, to);
     stackMap[from] = to;
     return true;
 }
@@ -207,6 +268,17 @@ std::string OffsetMap::dataStr(const MapSet &ms) const {
     return str.str();
 }
 
+string CompareStats::toString() const {
+    auto percent = [&](const Size count) { return instructions ? " (" + to_string(count * 100 / instructions) + "%)" : ""s; };
+    const Size decoded = instructions - spanMatches - rawMatches;
+    return "Compared "s + to_string(instructions) + " instructions: " 
+        + to_string(spanMatches) + " in identical spans" + percent(spanMatches) + ", "
+        + to_string(rawMatches) + " on identical bytes" + percent(rawMatches) + ", "
+        + to_string(decoded) + " decoded" + percent(decoded) + "\n"
+        + "Block compares: " + to_string(blocks) + ", identical up to the end: " + to_string(fullBlocks) 
+        + ", identical bytes: " + to_string(spanBytes);
+}
+
 VariantMap::VariantMap() {
 }
 
@@ -236,10 +308,10 @@ VariantMap::MatchDepth VariantMap::checkMatch(const VariantMap::Variant &left, c
 }
 
 void VariantMap::dump() const {
-    debug("variant map, max depth = " + to_string(maxDepth()));
+    debug("variant map, max depth = ", maxDepth());
     int bucketno = 0;
     for (const auto &bucket : buckets_) {
-        debug("bucket " + to_string(bucketno) + ": ");
+        debug("bucket ", bucketno, ": ");
         int variantno = 0;
         for (const auto &variant : bucket) {
             ostringstream varstr;
@@ -259,25 +331,25 @@ void VariantMap::dump() const {
 
 // search a specific bucket for a match against a variant search, return the number of instructions that a matching variant was found having, or zero if none was found
 int VariantMap::find(const Variant &search, int bucketno) const {
-    debug("looking for search item of size " + to_string(search.size()) + " in bucket " + to_string(bucketno));
+    debug("looking for search item of size ", search.size(), " in bucket ", bucketno);
     const auto &bucket = buckets_[bucketno];
     for (const auto &variant : bucket) {
-        debug("matching against variant of size " + to_string(variant.size()));
+        debug("matching against variant of size ", variant.size());
         if (search.size() < variant.size()) {
-            debug("search item too small (" + to_string(search.size()) + ") to check against variant (" + to_string(variant.size()) + ")");
+            debug("search item too small (", search.size(), ") to check against variant (", variant.size(), ")");
             continue;
         }
         size_t searchIdx = 0;
         bool match = true;
         for (const auto &instrStr : variant) {
             if (search[searchIdx++] != instrStr) { 
-                debug("failed comparison on index " + to_string(searchIdx-1) + ": '" + search[searchIdx-1] + "' != '" + instrStr + "'");
+                debug("failed comparison on index ", searchIdx-1, ": '", search[searchIdx-1], "' != '", instrStr, "'");
                 match = false; 
                 break; 
             } 
         }
         if (match) {
-            debug("matched with size " + to_string(variant.size()));
+            debug("matched with size ", variant.size());
             return variant.size();
         }
     }
@@ -27,14 +27,13 @@ static void cpuMessage(const string &msg, const LogPriority pri = LOG_INFO) {
 
 Cpu_8086::Cpu_8086(Memory *memory, InterruptInterface *inthandler) : 
     mem_(memory), int_(inthandler), 
-    memBase_(nullptr), code_(nullptr),
+    code_(nullptr), codeGeneration_(0),
     opcode_(OP_NOP), modrm_(0),
-    segOverride_(REG_NONE),
+    segOverride_(REG_NONE), prefixLength_(0),
     byteOperand1_(0), byteOperand2_(0), byteResult_(0),
     wordOperand1_(0), wordOperand2_(0), wordResult_(0),
     done_(false), step_(false)
 {
-    memBase_ = mem_->base();
     regs_.reset();
 }
 
@@ -57,8 +56,10 @@ Register Cpu_8086::defaultSeg(const Register reg) const {
 void Cpu_8086::setCodeSegment(const Word seg) {
     const Offset codeLinearAddr = SEG_TO_OFFSET(seg);
     regs_.set(REG_CS, seg);
-    // update pointer to current code segment data
-    code_ = memBase_ + codeLinearAddr;
+    // update pointer to current code segment data, which needs to be contiguous
+    mem_->mapFlat(codeLinearAddr, SEGMENT_SIZE);
+    code_ = mem_->pointer(codeLinearAddr);
+    codeGeneration_ = mem_->flatGeneration();
 }
 
 // calculate memory address to be used for the MEM operand of a ModR/M instruction, 
@@ -71,8 +72,8 @@ Offset Cpu_8086::modrmMemAddress() const {
     switch (modrm_mod(modrm_)) {
     // assuming cs:ip points at the opcode, so the displacement will be 2 bytes past that,
     // after the opcode and the modrm byte
-    case MODRM_MOD_DISP8:  displacement = BYTE_SIGNED(ipByte(2)); break; 
-    case MODRM_MOD_DISP16: displacement = WORD_SIGNED(ipWord(2)); break;
+    case MODRM_MOD_DISP8:  displacement = BYTE_SIGNED(opByte(2)); break; 
+    case MODRM_MOD_DISP16: displacement = WORD_SIGNED(opWord(2)); break;
     }
     // calculate offset of the word or byte from the register values and optionally the displacement
     switch (modrm_mod(modrm_)) {
@@ -85,7 +86,7 @@ Offset Cpu_8086::modrmMemAddress() const {
         case MODRM_MEM_BP_DI: baseReg = REG_BP;   offset = regs_.get(REG_BP) + regs_.get(REG_DI); break;
         case MODRM_MEM_SI:    baseReg = REG_SI;   offset = regs_.get(REG_SI); break;
         case MODRM_MEM_DI:    baseReg = REG_DI;   offset = regs_.get(REG_DI); break;
-        case MODRM_MEM_ADDR:  baseReg = REG_NONE; offset = ipWord(2); break; // address is the word past the opcode and modrm byte
+        case MODRM_MEM_ADDR:  baseReg = REG_NONE; offset = opWord(2); break; // address is the word past the opcode and modrm byte
         case MODRM_MEM_BX:    baseReg = REG_BX;   offset = regs_.get(REG_BX); break;
         }
         break;
@@ -114,30 +115,69 @@ Offset Cpu_8086::modrmMemAddress() const {
     return segOffset + offset;
 }
 
+Word Cpu_8086::modrmLength() const {
+    switch (modrm_mod(modrm_)) {
+    case MODRM_MOD_NODISP: return modrm_mem(modrm_) == MODRM_MEM_ADDR ? 4 : 2;
+    case MODRM_MOD_DISP8:  return 3;
+    case MODRM_MOD_DISP16: return 4;
+    default:               return 2;
+    }
+}
+
+// the register operand ordering of the REG and MEM bits
+static const Register MODRM_REGS_BYTE[8] = { REG_AL, REG_CL, REG_DL, REG_BL, REG_AH, REG_CH, REG_DH, REG_BH };
+static const Register MODRM_REGS_WORD[8] = { REG_AX, REG_CX, REG_DX, REG_BX, REG_SP, REG_BP, REG_SI, REG_DI };
+static const Register MODRM_REGS_SEG[4] = { REG_ES, REG_CS, REG_SS, REG_DS };
+
+Byte Cpu_8086::modrmEb() const {
+    if (modrm_mod(modrm_) == MODRM_MOD_REG) return static_cast<Byte>(regs_.get(MODRM_REGS_BYTE[modrm_mem(modrm_)]));
+    return memByte(modrmMemAddress());
+}
+
+Word Cpu_8086::modrmEv() const {
+    if (modrm_mod(modrm_) == MODRM_MOD_REG) return regs_.get(MODRM_REGS_WORD[modrm_mem(modrm_)]);
+    return memWord(modrmMemAddress());
+}
+
+void Cpu_8086::setModrmEb(const Byte value) {
+    if (modrm_mod(modrm_) == MODRM_MOD_REG) regs_.set(MODRM_REGS_BYTE[modrm_mem(modrm_)], value);
+    else setMemByte(modrmMemAddress(), value);
+}
+
+void Cpu_8086::setModrmEv(const Word value) {
+    if (modrm_mod(modrm_) == MODRM_MOD_REG) regs_.set(MODRM_REGS_WORD[modrm_mem(modrm_)], value);
+    else setMemWord(modrmMemAddress(), value);
+}
+
+Register Cpu_8086::modrmGb() const { return MODRM_REGS_BYTE[modrm_reg(modrm_) >> MODRM_REG_SHIFT]; }
+Register Cpu_8086::modrmGv() const { return MODRM_REGS_WORD[modrm_reg(modrm_) >> MODRM_REG_SHIFT]; }
+Register Cpu_8086::modrmSw() const { return MODRM_REGS_SEG[(modrm_reg(modrm_) >> MODRM_REG_SHIFT) & 0b11]; }
+
 // TODO: merge this with getInstruction in the future?
 void Cpu_8086::preProcessOpcode() {
     static const Register PREFIX_REGS[4] = { REG_ES, REG_CS, REG_SS, REG_DS };
-    Word ipOffset = 0;
     // clear segment override in case it was active
     segOverride_ = REG_NONE;
+    prefixLength_ = 0;
     modrm_ = 0;
     // in case the current opcode is actually a segment override prefix, set a flag and fetch the actual opcode from the next byte
-    if (opcodeIsSegmentPrefix(opcode_)) {
+    const OpcodeDesc *desc = &opcodeDesc(opcode_);
+    if (desc->segPrefix) {
         const size_t index = (opcode_ - OP_PREFIX_ES) / 8; // first prefix opcodes is for ES and subsequent ones are multiples of 8
         segOverride_ = PREFIX_REGS[index]; 
         opcode_ = ipByte(1);
-        ipOffset++;
-        // fall through, need to process updated opcode
-        // TODO: ip remains at override prefix, modrm read etc will be off?
+        desc = &opcodeDesc(opcode_);
+        // ip remains at the prefix until the instruction is done, the operands are fetched past it with opByte()/opWord()
+        prefixLength_ = 1;
     }
     // read modrm byte if opcode contains it
-    if (opcodeIsModrm(opcode_)) {
-        modrm_ = ipByte(1 + ipOffset);
+    if (desc->modrm) {
+        modrm_ = opByte(1);
     }
 }
 
 size_t Cpu_8086::instructionLength() const {
-    return 0; // TODO: fix
+    return ::instructionLength(code_ + regs_.get(REG_IP));
 }
 
 void Cpu_8086::init(const Address &codeAddr, const Address &stackAddr, const Size codeSize) {
@@ -180,11 +220,18 @@ string Cpu_8086::opcodeStr() const {
 void Cpu_8086::pipeline() {
     done_ = false;
     while (!done_) {
+        // the buffer holding the code was replaced, e.g. copied on the first write after a fork or snapshot, or restored
+        if (mem_->flatGeneration() != codeGeneration_) setCodeSegment(regs_.get(REG_CS));
         opcode_ = ipByte();
+        // taken before executing the instruction, a jump moves ip away from it
+        const Word length = static_cast<Word>(instructionLength());
+        // record the bytes of the instruction as code for separating it from the data
+        if (AccessMap *access = mem_->accessMap()) 
+            access->mark(SEG_TO_OFFSET(regs_.get(REG_CS)) + regs_.get(REG_IP), length, ACCESS_EXEC);
         preProcessOpcode();
         // evaluate instruction, apply side efects
         dispatch();
-        ipAdvance(WORD_SIGNED(instructionLength()));
+        ipAdvance(WORD_SIGNED(length));
         if (step_) break;
     }
 }
@@ -208,6 +255,7 @@ void Cpu_8086::dispatch() {
     case INS_INC: instr_inc(); break;
     case INS_DEC: instr_dec(); break;
     case INS_JMP: instr_jmp(); break; // all unconditional jumps:
+    case INS_JMP_IF: instr_jmp(); break;
     case INS_TEST: instr_test(); break;
     case INS_XCHG: instr_xchg(); break;
     case INS_MOV: instr_mov(); break;
@@ -436,7 +484,29 @@ void Cpu_8086::updateFlags() {
     }
 }
 
+// operands in memory go through the tracked accessors, so they show up as data in the access map
 void Cpu_8086::instr_mov() {
+    // the direct offset of the accumulator forms is relative to the data segment
+    const Offset dataOffset = SEG_TO_OFFSET(regs_.get(defaultSeg(REG_NONE)));
+    switch (opcode_) {
+    case OP_MOV_Eb_Gb: setModrmEb(static_cast<Byte>(regs_.get(modrmGb()))); break;
+    case OP_MOV_Ev_Gv: setModrmEv(regs_.get(modrmGv())); break;
+    case OP_MOV_Gb_Eb: regs_.set(modrmGb(), modrmEb()); break;
+    case OP_MOV_Gv_Ev: regs_.set(modrmGv(), modrmEv()); break;
+    case OP_MOV_Ew_Sw: setModrmEv(regs_.get(modrmSw())); break;
+    case OP_MOV_Sw_Ew: regs_.set(modrmSw(), modrmEv()); break;
+    case OP_MOV_AL_Ob: regs_.set(REG_AL, memByte(dataOffset + opWord(1))); break;
+    case OP_MOV_AX_Ov: regs_.set(REG_AX, memWord(dataOffset + opWord(1))); break;
+    case OP_MOV_Ob_AL: setMemByte(dataOffset + opWord(1), static_cast<Byte>(regs_.get(REG_AL))); break;
+    case OP_MOV_Ov_AX: setMemWord(dataOffset + opWord(1), regs_.get(REG_AX)); break;
+    case OP_MOV_Eb_Ib: setModrmEb(opByte(modrmLength())); break;
+    case OP_MOV_Ev_Iv: setModrmEv(opWord(modrmLength())); break;
+    default:
+        // register encoded in the low bits of the opcode
+        if (opcode_ >= OP_MOV_AL_Ib && opcode_ <= OP_MOV_BH_Ib) regs_.set(MODRM_REGS_BYTE[opcode_ - OP_MOV_AL_Ib], opByte(1));
+        else if (opcode_ >= OP_MOV_AX_Iv && opcode_ <= OP_MOV_DI_Iv) regs_.set(MODRM_REGS_WORD[opcode_ - OP_MOV_AX_Iv], opWord(1));
+        else throw CpuError("Unexpected opcode for MOV: " + hexVal(opcode_));
+    }
 }
 
 void Cpu_8086::instr_int() {
@@ -446,7 +516,7 @@ void Cpu_8086::instr_int() {
         int_->interrupt(3, regs_);
         break;
     case OP_INT_Ib:
-        num = ipByte(1);
+        num = opByte(1);
         int_->interrupt(num, regs_);
         break;
     case OP_INTO:
@@ -553,7 +623,7 @@ void Cpu_8086::instr_call() {
 }
 
 void Cpu_8086::instr_jmp() {
-    byteOperand1_ = BYTE_SIGNED(ipByte(1));
+    byteOperand1_ = BYTE_SIGNED(opByte(1));
     bool jump = false;
     switch (opcode_) {
     case OP_JO_Jb : jump = regs_.getFlag(FLAG_OVER); break;
@@ -57,8 +57,7 @@ LoadModule Dos::loadExe(MzImage &mz) {
     memory_->writeBuf(pspAddr.toLinear(), pspData, PSP_SIZE);
     // read load module data from exe file into memory
     mz.load(loadAddr.segment);
-    const Byte *exeData = mz.loadModuleData();
-    memory_->writeBuf(loadAddr.toLinear(), exeData, mz.loadModuleSize());
+    memory_->writeImage(loadAddr.toLinear(), mz);
     // calculate relocated addresses for code and stack
     LoadModule ret;
     const Address
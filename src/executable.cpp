@@ -3,12 +3,18 @@
 #include <algorithm>
 #include <regex>
 #include <set>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
 
 #include "dos/executable.h"
 #include "dos/analysis.h"
 #include "dos/output.h"
 #include "dos/util.h"
 #include "dos/error.h"
+#include "dos/trace.h"
+#include "dos/format.h"
+#include "dos/json.h"
 
 using namespace std;
 
@@ -38,15 +44,19 @@ static const map<string, vector<vector<string>>> INSTR_VARIANT = {
 
 // TODO: include information of existing address mapping contributing to a match/mismatch in the output
 // TODO: make jump instructions compare the match with the relative offset value
-static string compareStatus(const Instruction &i1, const Instruction &i2, const bool align, InstructionMatch match = INS_MATCH_ERROR) {
+// appends the side-by-side comparison of two instructions to the string
+static void compareStatus(string &status, const Instruction &i1, const Instruction &i2, const bool align, InstructionMatch match = INS_MATCH_ERROR) {
     static const int ALIGN = 50;
-    string status;
+    const Size start = status.length();
     if (i1.isValid()) {
-        status = i1.addr.toString() + ": " + i1.toString(align);
+        appendAddress(status, i1.addr);
+        status += ": ";
+        i1.format(status, align);
     }
-    if (!i2.isValid()) return status;
+    if (!i2.isValid()) return;
 
-    if (align && status.length() < ALIGN) status.append(ALIGN - status.length(), ' ');
+    const Size len = status.length() - start;
+    if (align && len < ALIGN) status.append(ALIGN - len, ' ');
     if (i1.isValid()) {
         if (match == INS_MATCH_ERROR) match = i1.match(i2);
         switch (match) {
@@ -58,15 +68,22 @@ static string compareStatus(const Instruction &i1, const Instruction &i2, const
         }
     }
     else status.append(4, ' ');
-    status += i2.addr.toString() + ": " + i2.toString(align);
-    return status;
+    appendAddress(status, i2.addr);
+    status += ": ";
+    i2.format(status, align);
+}
+
+// deferred compareStatus() for log output, only formatted into the message buffer if the message is shown
+static auto statusArg(const Instruction &i1, const Instruction &i2, const bool align, InstructionMatch match = INS_MATCH_ERROR) {
+    return [&i1, &i2, align, match](string &str) { compareStatus(str, i1, i2, align, match); };
 }
 
 Executable::Executable(const MzImage &mz) : 
-    code(mz.loadSegment(), mz.loadModuleData(), mz.loadModuleSize()),
+    code(mz),
     loadSegment(mz.loadSegment()),
     codeSize(mz.loadModuleSize()),
-    stack(mz.stackPointer())
+    stack(mz.stackPointer()),
+    cpu(CPU_8086)
 {
     // relocate entrypoint
     setEntrypoint(mz.entrypoint());
@@ -77,7 +94,8 @@ Executable::Executable(const Word loadSegment, const std::vector<Byte> &data) :
     code(loadSegment, data.data(), data.size()),
     loadSegment(loadSegment),
     codeSize(data.size()),
-    stack{}
+    stack{},
+    cpu(CPU_8086)
 {
     setEntrypoint({0, 0});
     init();
@@ -86,8 +104,9 @@ Executable::Executable(const Word loadSegment, const std::vector<Byte> &data) :
 // common initialization after construction
 void Executable::init() {
     codeExtents = Block{{loadSegment, Word(0)}, Address(SEG_TO_OFFSET(loadSegment) + codeSize - 1)};
+    store = InstructionStore{SEG_TO_OFFSET(loadSegment), codeSize, cpu};
     stack.relocate(loadSegment);
-    debug("Loaded executable data into memory, code at "s + codeExtents.toString() + ", relocated entrypoint " + entrypoint().toString() + ", stack " + stack.toString());    
+    debug("Loaded executable data into memory, code at ", codeExtents, ", relocated entrypoint ", entrypoint().toString(), ", stack ", stack);    
 }
 
 void Executable::setEntrypoint(const Address &addr) {
@@ -95,13 +114,15 @@ void Executable::setEntrypoint(const Address &addr) {
     ep.relocate(loadSegment);
 }
 
-Executable::Context::Context(const Executable &target, const AnalysisOptions &opt, const Size maxData) 
-        : target(target), options(opt), offMap(maxData)
-{
+void Executable::setCpu(const CpuLevel level) {
+    cpu = level;
+    store = InstructionStore{SEG_TO_OFFSET(loadSegment), codeSize, cpu};
+    debug("Decoding instructions for ", cpu_level_name(cpu));
 }
 
-void Executable::searchMessage(const Address &addr, const string &msg) const {
-    output(addr.toString() + ": " + msg, LOG_ANALYSIS, LOG_DEBUG);
+Executable::Context::Context(const Executable &target, const AnalysisOptions &opt, const Size maxData) 
+        : target(target), options(opt), offMap(maxData), mapSeg(REG_NONE), mapRef(0), mapTgt(0), identical(0)
+{
 }
 
 // TODO: this should be in the CPU class, RegisterState as injectable drop-in replacement for regular Registers for CPU
@@ -115,7 +136,7 @@ Branch Executable::getBranch(const Instruction &i, const RegisterState &regs) co
     // conditional jump
     case INS_JMP_IF:
         branch.destination = i.destinationAddress();
-        searchMessage(addr, "encountered conditional near jump to "s + branch.destination.toString());
+        searchMessage(addr, "encountered conditional near jump to ", branch.destination);
         break;
     // unconditional jumps
     case INS_JMP:
@@ -124,11 +145,11 @@ Branch Executable::getBranch(const Instruction &i, const RegisterState &regs) co
         case OP_JMP_Jv: 
             branch.destination = i.destinationAddress();
             branch.isUnconditional = true;
-            searchMessage(addr, "encountered unconditional near jump to "s + branch.destination.toString());
+            searchMessage(addr, "encountered unconditional near jump to ", branch.destination);
             break;
         case OP_GRP5_Ev:
             branch.isUnconditional = true;
-            searchMessage(addr, "unknown near jump target: "s + i.toString());
+            searchMessage(addr, "unknown near jump target: ", i);
             debug(regs.toString());
             break; 
         default: 
@@ -140,10 +161,10 @@ Branch Executable::getBranch(const Instruction &i, const RegisterState &regs) co
             branch.destination = Address{i.op1.immval.u32}; 
             branch.isUnconditional = true;
             branch.isNear = false;
-            searchMessage(addr, "encountered unconditional far jump to "s + branch.destination.toString());
+            searchMessage(addr, "encountered unconditional far jump to ", branch.destination);
         }
         else {
-            searchMessage(addr, "unknown far jump target: "s + i.toString());
+            searchMessage(addr, "unknown far jump target: ", i);
             debug(regs.toString());
         }
         break;
@@ -152,32 +173,32 @@ Branch Executable::getBranch(const Instruction &i, const RegisterState &regs) co
     case INS_LOOPNZ:
     case INS_LOOPZ:
         branch.destination = i.destinationAddress();
-        searchMessage(addr, "encountered loop to "s + branch.destination.toString());
+        searchMessage(addr, "encountered loop to ", branch.destination);
         break;
     // calls
     case INS_CALL:
         if (i.op1.type == OPR_IMM16) {
             branch.destination = i.destinationAddress();
             branch.isCall = true;
-            searchMessage(addr, "encountered near call to "s + branch.destination.toString());
+            searchMessage(addr, "encountered near call to ", branch.destination);
         }
         else if (operandIsReg(i.op1.type) && regs.isKnown(i.op1.regId())) {
             branch.destination = {i.addr.segment, regs.getValue(i.op1.regId())};
             branch.isCall = true;
-            searchMessage(addr, "encountered near call through register to "s + branch.destination.toString());
+            searchMessage(addr, "encountered near call through register to ", branch.destination);
         }
         else if (operandIsMemImmediate(i.op1.type) && regs.isKnown(REG_DS)) {
             // need to read call destination offset from memory
             Address memAddr{regs.getValue(REG_DS), i.op1.immval.u16};
             if (codeExtents.contains(memAddr)) {
-                branch.destination = Address{i.addr.segment, code.readWord(memAddr)};
+                branch.destination = Address{i.addr.segment, code.readWord<InRangeAccess>(memAddr)};
                 branch.isCall = true;
-                searchMessage(addr, "encountered near call through mem pointer to "s + branch.destination.toString());
+                searchMessage(addr, "encountered near call through mem pointer to ", branch.destination);
             }
-            else debug("mem pointer of call destination outside code extents: " + memAddr.toString());
+            else debug("mem pointer of call destination outside code extents: ", memAddr);
         }
         else {
-            searchMessage(addr, "unknown near call target: "s + i.toString());
+            searchMessage(addr, "unknown near call target: ", i);
             debug(regs.toString());
         } 
         break;
@@ -186,10 +207,10 @@ Branch Executable::getBranch(const Instruction &i, const RegisterState &regs) co
             branch.destination = Address(DWORD_SEGMENT(i.op1.immval.u32), DWORD_OFFSET(i.op1.immval.u32));
             branch.isCall = true;
             branch.isNear = false;
-            searchMessage(addr, "encountered far call to "s + branch.destination.toString());
+            searchMessage(addr, "encountered far call to ", branch.destination);
         }
         else {
-            searchMessage(addr, "unknown far call target: "s + i.toString());
+            searchMessage(addr, "unknown far call target: ", i);
             debug(regs.toString());
         }
         break;
@@ -233,30 +254,53 @@ void Executable::applyMov(const Instruction &i, RegisterState &regs) {
         if (codeExtents.contains(srcAddr)) {
             switch(i.op2.size) {
             case OPRSZ_BYTE:
-                searchMessage(i.addr, "source address for byte: " + srcAddr.toString());
-                regs.setValue(dest, code.readByte(srcAddr)); 
+                searchMessage(i.addr, "source address for byte: ", srcAddr);
+                regs.setValue(dest, code.readByte<InRangeAccess>(srcAddr)); 
                 set = true;
                 break;
             case OPRSZ_WORD:
-                searchMessage(i.addr, "source address for word: " + srcAddr.toString());
-                regs.setValue(dest, code.readWord(srcAddr));
+                searchMessage(i.addr, "source address for word: ", srcAddr);
+                regs.setValue(dest, code.readWord<InRangeAccess>(srcAddr));
                 set = true;
                 break;
             }
         }
-        else searchMessage(i.addr, "mov source address outside code extents: "s + srcAddr.toString());
+        else searchMessage(i.addr, "mov source address outside code extents: ", srcAddr);
     }
     if (set) {
-        searchMessage(i.addr, "executed move to register: "s + i.toString());
+        searchMessage(i.addr, "executed move to register: ", i);
         if (i.op1.type == OPR_REG_DS) storeSegment(Segment::SEG_DATA, regs.getValue(REG_DS));
         else if (i.op1.type == OPR_REG_SS) storeSegment(Segment::SEG_STACK, regs.getValue(REG_SS));
     }
 }
 
+// An instruction fits into a 64bit word, so its bytes are compared in one go. Only the bytes of the instruction are 
+// copied into the zeroed words, which does not depend on byte order and does not read past the instruction.
+static bool instructionBytesEqual(const Byte *ref, const Byte *tgt, const Size length) {
+    static_assert(INSTRUCTION_MAX <= sizeof(uint64_t), "Instruction does not fit into a word");
+    assert(length <= INSTRUCTION_MAX);
+    uint64_t refWord = 0, tgtWord = 0;
+    memcpy(&refWord, ref, length);
+    memcpy(&tgtWord, tgt, length);
+    return refWord == tgtWord;
+}
+
 Executable::ComparisonResult Executable::instructionsMatch(Context &ctx, const Instruction &ref, Instruction tgt) {
+    ctx.mapSeg = REG_NONE;
+    ctx.stats.instructions++;
     if (ctx.options.ignoreDiff) return CMP_MATCH;
+    // byte-identical instructions decode the same, so they always match and there are no offsets to map
+    if (ctx.identical >= ref.length) {
+        ctx.stats.spanMatches++;
+        return CMP_MATCH;
+    }
+    if (ref.length == tgt.length && instructionBytesEqual(code.pointer(ref.addr), ctx.target.code.pointer(tgt.addr), ref.length)) {
+        ctx.stats.rawMatches++;
+        return CMP_MATCH;
+    }
 
-    auto insResult = ref.match(tgt);
+    // differing fingerprints rule out a match without looking at the operands
+    auto insResult = ref.fingerprint == tgt.fingerprint ? ref.match(tgt) : INS_MATCH_MISMATCH;
     if (insResult == INS_MATCH_FULL) return CMP_MATCH;
 
     bool match = false;
@@ -268,6 +312,9 @@ Executable::ComparisonResult Executable::instructionsMatch(Context &ctx, const I
                 tgtObranch = getBranch(tgt);
             if (refBranch.destination.isValid() && tgtObranch.destination.isValid()) {
                 match = ctx.offMap.codeMatch(refBranch.destination, tgtObranch.destination);
+                ctx.mapSeg = REG_CS;
+                ctx.mapRef = refBranch.destination.toLinear();
+                ctx.mapTgt = tgtObranch.destination.toLinear();
                 if (!match) debug("Instruction mismatch on branch destination");
                 // near jumps are usually used within a routine to handle looping and conditions,
                 // so a different value (relative jump amount) might mean a wrong flow
@@ -277,7 +324,7 @@ Executable::ComparisonResult Executable::instructionsMatch(Context &ctx, const I
             // special case of jmp vs jmp short - allow only if variants enabled
             if (match && ref.opcode != tgt.opcode && (ref.isUnconditionalJump() || tgt.isUnconditionalJump())) {
                 if (ctx.options.variant) {
-                    verbose(output_color(OUT_YELLOW) + compareStatus(ref, tgt, true, INS_MATCH_DIFF) + output_color(OUT_DEFAULT));
+                    verbose(output_color(OUT_YELLOW), statusArg(ref, tgt, true, INS_MATCH_DIFF), output_color(OUT_DEFAULT));
                     ctx.tgtCsip += tgt.length;
                     return CMP_VARIANT;
                 }
@@ -302,6 +349,9 @@ Executable::ComparisonResult Executable::instructionsMatch(Context &ctx, const I
                 // otherwise, apply mapping
                 SOffset refOfs = ref.memOffset(), tgtOfs = tgt.memOffset();
                 Register segReg = ref.memSegmentId();
+                ctx.mapSeg = segReg;
+                ctx.mapRef = refOfs;
+                ctx.mapTgt = tgtOfs;
                 switch (segReg) {
                 case REG_CS:
                     match = ctx.offMap.codeMatch(refOfs, tgtOfs);
@@ -336,10 +386,10 @@ Executable::ComparisonResult Executable::instructionsMatch(Context &ctx, const I
     else if (ctx.options.variant && INSTR_VARIANT.count(ref.toString())) {
         // get vector of allowed variants (themselves vectors of strings)
         const auto &variants = INSTR_VARIANT.at(ref.toString());
-        debug("Found "s + to_string(variants.size()) + " variants for instruction '" + ref.toString() + "'");
+        debug("Found ", variants.size(), " variants for instruction '", ref, "'");
         // compose string for showing the variant comparison instructions
-        string statusStr = compareStatus(ref, tgt, true, INS_MATCH_DIFF);
-        string variantStr;
+        string statusStr, variantStr, tgtStr;
+        compareStatus(statusStr, ref, tgt, true, INS_MATCH_DIFF);
         // iterate over the possible variants of this reference instruction
         for (auto &v : variants) {
             variantStr.clear();
@@ -349,19 +399,22 @@ Executable::ComparisonResult Executable::instructionsMatch(Context &ctx, const I
             int idx = 0;
             // iterate over instructions inside this variant
             for (auto &istr: v) {
-                debug(tmpCsip.toString() + ": " + tgt.toString() + " == " + istr + " ? (" + to_string(idx+1) + "/" + to_string(v.size()) + ")");
+                debug(tmpCsip, ": ", tgt, " == ", istr, " ? (", idx+1, "/", v.size(), ")");
                 // stringwise compare the next instruction in the variant to the current instruction
-                if (tgt.toString() != istr) { match = false; break; }
+                tgtStr.clear();
+                tgt.format(tgtStr);
+                if (tgtStr != istr) { match = false; break; }
                 // if this is not the last instruction in the variant, read the next instruction from the target binary
                 tmpCsip += tgt.length;
                 if (++idx < v.size()) {
-                    tgt = Instruction{tmpCsip, ctx.target.code.pointer(tmpCsip)};
-                    variantStr += "\n" + compareStatus(Instruction(), tgt, true);
+                    tgt = ctx.target.instruction(tmpCsip);
+                    variantStr += '\n';
+                    compareStatus(variantStr, Instruction(), tgt, true);
                 }
             }
             if (match) {
-                debug("Got variant match, advancing target binary to " + tmpCsip.toString());
-                verbose(output_color(OUT_YELLOW) + statusStr + variantStr + output_color(OUT_DEFAULT));
+                debug("Got variant match, advancing target binary to ", tmpCsip);
+                verbose(output_color(OUT_YELLOW), statusStr, variantStr, output_color(OUT_DEFAULT));
                 // in the case of a match, need to update the actual instruction pointer in the target binary to account for the instructions we skipped
                 ctx.tgtCsip = tmpCsip;
                 return CMP_VARIANT;
@@ -372,6 +425,22 @@ Executable::ComparisonResult Executable::instructionsMatch(Context &ctx, const I
     return CMP_MISMATCH;
 }
 
+// Length of the run of identical bytes at the current locations in the reference and the target, 
+// up to the end of a block in the reference. Compares a word at a time until the first difference.
+Size Executable::identicalBytes(const Context &ctx, const Address &refEnd) const {
+    if (refEnd < ctx.refCsip || !ctx.target.contains(ctx.tgtCsip)) return 0;
+    const Size size = std::min(refEnd.toLinear() - ctx.refCsip.toLinear(), ctx.target.codeExtents.end.toLinear() - ctx.tgtCsip.toLinear()) + 1;
+    const Byte *ref = code.pointer(ctx.refCsip), *tgt = ctx.target.code.pointer(ctx.tgtCsip);
+    Size pos = 0;
+    for (uint64_t refWord, tgtWord; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t)) {
+        memcpy(&refWord, ref + pos, sizeof(refWord));
+        memcpy(&tgtWord, tgt + pos, sizeof(tgtWord));
+        if (refWord != tgtWord) break;
+    }
+    while (pos < size && ref[pos] == tgt[pos]) pos++;
+    return pos;
+}
+
 void Executable::storeSegment(const Segment::Type type, const Word addr) {
     // ignore segments which are already known
     auto found = std::find_if(segments.begin(), segments.end(), [=](const Segment &s){
@@ -406,24 +475,42 @@ void Executable::storeSegment(const Segment::Type type, const Word addr) {
     }
     segName += to_string(idx);
     Segment seg{segName, type, addr};
-    debug("Found new segment: " + seg.toString());
+    debug("Found new segment: ", seg);
     segments.push_back(seg);
 }
 
+// a linear address in the load module relative to the closest code segment below it, if there is one within range
+Address Executable::codeAddress(const Offset linear) const {
+    const Segment *closest = nullptr;
+    for (const Segment &s : segments) {
+        const Offset segStart = SEG_TO_OFFSET(s.address);
+        if (s.type != Segment::SEG_CODE || segStart > linear || linear - segStart > 0xffff) continue;
+        if (!closest || s.address > closest->address) closest = &s;
+    }
+    if (!closest) return Address{linear};
+    return Address{closest->address, static_cast<Word>(linear - SEG_TO_OFFSET(closest->address))};
+}
+
 void Executable::diffContext(const Context &ctx) const {
     const int CONTEXT_COUNT = ctx.options.ctxCount;
     Address a1 = ctx.refCsip; 
     Address a2 = ctx.tgtCsip;
     const Memory &code2 = ctx.target.code;
     const Block &ext2 = ctx.target.codeExtents;
-    verbose("--- Context information for up to " + to_string(CONTEXT_COUNT) + " additional instructions after mismatch location:");
+    verbose("--- Context information for up to ", CONTEXT_COUNT, " additional instructions after mismatch location:");
     Instruction i1, i2;
     for (int i = 0; i <= CONTEXT_COUNT; ++i) {
         // make sure we are within code extents in both executables
         if (!codeExtents.contains(a1) || !ext2.contains(a2)) break;
-        i1 = Instruction{a1, code.pointer(a1)},
-        i2 = Instruction{a2, code2.pointer(a2)};
-        if (i != 0) verbose(compareStatus(i1, i2, true));
+        // the mismatched instructions were already shown, only need to get past them, an undecodable byte at least
+        if (i == 0) {
+            a1 += max<Byte>(1, instructionLength(code.pointer(a1), cpu));
+            a2 += max<Byte>(1, instructionLength(code2.pointer(a2), ctx.target.cpu));
+            continue;
+        }
+        i1 = instruction(a1),
+        i2 = ctx.target.instruction(a2);
+        verbose(statusArg(i1, i2, true));
         a1 += i1.length;
         a2 += i2.length;
     }
@@ -435,17 +522,41 @@ void Executable::skipContext(const Context &ctx, Address refAddr, Address tgtAdd
     while (refSkipped > 0 || tgtSkipped > 0) {
         Instruction refInstr, tgtInstr;
         if (refSkipped > 0) {
-            refInstr = {refAddr, code.pointer(refAddr)};
+            refInstr = instruction(refAddr);
             refSkipped--;
             refAddr += refInstr.length;
         }
         if (tgtSkipped > 0) {
-            tgtInstr = {tgtAddr, ctx.target.code.pointer(tgtAddr)};
+            tgtInstr = ctx.target.instruction(tgtAddr);
             tgtSkipped--;
             tgtAddr += tgtInstr.length;
         }
-        verbose(output_color(OUT_YELLOW) + compareStatus(refInstr, tgtInstr, true, INS_MATCH_DIFF) + " [skip]" + output_color(OUT_DEFAULT));
+        verbose(output_color(OUT_YELLOW), statusArg(refInstr, tgtInstr, true, INS_MATCH_DIFF), " [skip]", output_color(OUT_DEFAULT));
+    }
+}
+
+static const char* CMP_NAME[] = { "mismatch", "match", "diffval", "difftgt", "variant" };
+
+// machine-readable counterpart of the comparison status line, tgtSize can span several target instructions in case of a variant
+void Executable::compareRecord(const Context &ctx, const char *type, const char *result, const Instruction &ref, const Instruction &tgt, const Size tgtSize) const {
+    JsonWriter &rec = *ctx.options.records;
+    rec.begin(type).field("ref", ref.addr).field("tgt", tgt.addr)
+        .bytes("refbytes", code.pointer(ref.addr), ref.length)
+        .bytes("tgtbytes", ctx.target.code.pointer(tgt.addr), tgtSize)
+        .raw("refinstr", [&](string &s){ ref.format(s); })
+        .raw("tgtinstr", [&](string &s){ tgt.format(s); })
+        .field("result", result);
+    if (ctx.mapSeg != REG_NONE) {
+        rec.field("mapseg", regName(ctx.mapSeg)).field("mapref", ctx.mapRef).field("maptgt", ctx.mapTgt);
     }
+    rec.end();
+}
+
+void Executable::routineRecord(const Context &ctx, const char *event, const Routine &routine, const Block &block) const {
+    JsonWriter &rec = *ctx.options.records;
+    rec.begin("routine").field("event", event).field("name", routine.name).field("ref", ctx.refCsip).field("tgt", ctx.tgtCsip);
+    if (block.isValid()) rec.field("blockbegin", block.begin).field("blockend", block.end);
+    rec.end();
 }
 
 // TODO: this should be a member of SearchQueue
@@ -462,7 +573,7 @@ bool Executable::saveBranch(const Branch &branch, const RegisterState &regs, con
         return ret;
     }
     else {
-        searchMessage(branch.source, "branch destination outside code boundaries: "s + branch.destination.toString());
+        searchMessage(branch.source, "branch destination outside code boundaries: ", branch.destination);
     }
     return false; 
 }
@@ -471,20 +582,33 @@ bool Executable::saveBranch(const Branch &branch, const RegisterState &regs, con
 // TODO: identify routines through signatures generated from OMF libraries
 // TODO: trace usage of bp register (sub/add) to determine stack frame size of routines
 // TODO: store references to potential jump tables (e.g. jmp cs:[bx+0xc08]), if unclaimed after initial search, try treating entries as pointers and run second search before coalescing blocks?
-RoutineMap Executable::findRoutines() {
+RoutineMap Executable::findRoutines(const bool prologues) {
     RegisterState initRegs{entrypoint(), stack};
     storeSegment(Segment::SEG_STACK, stack.segment);
-    debug("initial register values:\n"s + initRegs.toString());
+    debug("initial register values:\n", initRegs);
     // queue for BFS search
     ScanQueue searchQ{Destination(entrypoint(), 1, true, initRegs)};
     info("Analyzing code within extents: "s + codeExtents);
+    // candidate routines which are not reachable through branches, only tried after the search runs out of locations
+    vector<Offset> seeds;
+    if (prologues) {
+        seeds = findPrologues(code.pointer(codeExtents.begin), codeSize, cpu);
+        debug("Found ", seeds.size(), " routine prologues in load module");
+    }
+    auto nextSeed = seeds.cbegin();
+    auto seed = [&]{
+        while (nextSeed != seeds.cend()) {
+            if (searchQ.saveSeed(codeAddress(codeExtents.begin.toLinear() + *nextSeed++))) return true;
+        }
+        return false;
+    };
 
     // iterate over entries in the search queue
-    while (!searchQ.empty()) {
+    while (!searchQ.empty() || seed()) {
         // get a location from the queue and jump to it
         const Destination search = searchQ.nextPoint();
         Address csip = search.address;
-        searchMessage(csip, "--- starting search at new location for routine " + to_string(search.routineId) + ", call: "s + to_string(search.isCall) + ", queue = " + to_string(searchQ.size()));
+        searchMessage(csip, "--- starting search at new location for routine ", search.routineId, ", call: ", search.isCall, ", queue = ", searchQ.size());
         RegisterState regs = search.regs;
         regs.setValue(REG_CS, csip.segment);
         storeSegment(Segment::SEG_CODE, csip.segment);
@@ -497,17 +621,24 @@ RoutineMap Executable::findRoutines() {
             if (rid != NULL_ROUTINE) {
                 // make sure we do not steamroll over previously explored instructions from a wild jump (a call has precedence)
                 if (!search.isCall) {
-                    searchMessage(csip, "location already claimed by routine "s + to_string(rid) + " and search point did not originate from a call, halting scan");
+                    searchMessage(csip, "location already claimed by routine ", rid, " and search point did not originate from a call, halting scan");
                     break;
                 }
             }
             const auto isEntry = searchQ.isEntrypoint(csip);
             // similarly, protect yet univisited locations which are however recognized as routine entrypoints, unless visiting from a matching routine id
             if (isEntry != NULL_ROUTINE && isEntry != search.routineId) {
-                searchMessage(csip, "location marked as entrypoint for routine "s + to_string(isEntry) + " while scanning from " + to_string(search.routineId) + ", halting scan");
+                searchMessage(csip, "location marked as entrypoint for routine ", isEntry, " while scanning from ", search.routineId, ", halting scan");
+                break;
+            }
+            const Instruction i = instruction(csip);
+            // stop at bytes which do not decode, without claiming them for the routine
+            if (!i.isValid()) {
+                const Size size = i.status == INS_STATUS_TRUNCATED ? codeExtents.end.toLinear() - csip.toLinear() + 1 : i.length;
+                searchMessage(csip, "instruction does not decode (", instr_status_name(i.status), "), suspected data, halting scan");
+                searchQ.saveData(Block{csip, Address{csip.segment, static_cast<Word>(csip.offset + size - 1)}});
                 break;
             }
-            Instruction i(csip, code.pointer(csip));
             regs.setValue(REG_IP, csip.offset);
             // mark memory map items corresponding to the current instruction as belonging to the current routine
             searchQ.setRoutineId(csip.toLinear(), i.length);
@@ -531,17 +662,16 @@ RoutineMap Executable::findRoutines() {
                 applyMov(i, regs);
             }
             else {
-                for (Register r : i.touchedRegs()) {
-                    regs.setUnknown(r);
-                }
+                regs.setUnknown(i.registerEffect().write);
             }
             // advance to next instruction
             csip += i.length;
         } // next instructions
     } // next address from search queue
     info("Done analyzing code");
+    debug("Instruction store: ", store.statusString());
     // XXX: debug, remove
-    searchQ.dumpVisited("routines.visited", SEG_TO_OFFSET(loadSegment), codeSize);
+    if (outputEnabled(LOG_ANALYSIS, LOG_VERBOSE)) searchQ.dumpVisited("routines.visited", SEG_TO_OFFSET(loadSegment), codeSize);
 
     // iterate over discovered memory map and create routine map
     auto ret = RoutineMap{searchQ, segments, loadSegment, codeSize};
@@ -550,8 +680,8 @@ RoutineMap Executable::findRoutines() {
 
 // TODO: move this out of Executable, will help with unifying how both executables are referenced inside
 bool Executable::compareCode(const RoutineMap &routineMap, const Executable &target, const AnalysisOptions &options) {
-    verbose("Comparing code between reference (entrypoint "s + entrypoint().toString() + ") and target (entrypoint " + target.entrypoint().toString() + ") executables");
-    debug("Routine map of reference binary has " + to_string(routineMap.size()) + " entries");
+    verbose("Comparing code between reference (entrypoint ", entrypoint().toString(), ") and target (entrypoint ", target.entrypoint().toString(), ") executables");
+    debug("Routine map of reference binary has ", routineMap.size(), " entries");
     Context ctx{target, options, routineMap.segmentCount(Segment::SEG_DATA)};
     // map of equivalent addresses in the compared binaries, seed with the two entrypoints
     ctx.offMap.setCode(entrypoint(), target.entrypoint());
@@ -563,18 +693,25 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
     std::regex excludeRe{options.exclude};
     Size comparedSize = 0;
     set<string> routineNames;
+    // close the record stream with the outcome of the comparison
+    auto result = [&](const bool match) {
+        debug("Instruction store of reference: ", store.statusString(), ", target: ", target.store.statusString());
+        if (options.stats) *options.stats = ctx.stats;
+        if (options.records) options.records->begin("result").field("match", match).field("compared", comparedSize).field("routines", routineNames.size()).end();
+        return match;
+    };
     while (!compareQ.empty()) {
         // get next location for linear scan and comparison of instructions from the front of the queue,
         // to visit functions in the same order in which they were first encountered
         const Destination compare = compareQ.nextPoint();
-        debug("Now at reference location "s + compare.address.toString() + ", queue size = " + to_string(compareQ.size()));
+        debug("Now at reference location ", compare.address, ", queue size = ", compareQ.size());
         // when entering a routine, forget all the current stack offset mappings
         if (compare.isCall) {
             ctx.offMap.resetStack();
         }
         ctx.refCsip = compare.address;
         if (options.stopAddr.isValid() && ctx.refCsip >= options.stopAddr) {
-            verbose("Reached stop address: " + ctx.refCsip.toString());
+            verbose("Reached stop address: ", ctx.refCsip);
             goto success;
         }        
         if (compareQ.getRoutineId(ctx.refCsip.toLinear()) != NULL_ROUTINE) {
@@ -585,7 +722,7 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
         ctx.tgtCsip = ctx.offMap.getCode(ctx.refCsip);
         if (!ctx.tgtCsip.isValid()) {
             error("Could not find equivalent address for "s + ctx.refCsip.toString() + " in address map for target executable");
-            return false;
+            return result(false);
         }
         Routine routine{"unknown", {}};
         Size routineCount = 0;
@@ -595,19 +732,30 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
             // make sure we are inside a reachable block of a know routine from reference binary
             if (!routine.isValid()) {
                 error("Could not find address "s + ctx.refCsip.toString() + " in routine map");
-                return false;
+                return result(false);
             }
             routineNames.insert(routine.name);
             compareBlock = routine.blockContaining(compare.address);
             if (!options.exclude.empty() && std::regex_match(routine.name, excludeRe)) {
-                verbose("--- Skipping excluded routine " + routine.toString(false) + " @"s + ctx.refCsip.toString() + ", block " + compareBlock.toString(true) +  ", target @" + ctx.tgtCsip.toString());
+                verbose("--- Skipping excluded routine ", routine.toString(false), " @", ctx.refCsip, ", block ", compareBlock.toString(true), ", target @", ctx.tgtCsip);
+                if (options.records) routineRecord(ctx, "exclude", routine, compareBlock);
                 continue;
             }
-            verbose("--- Now @"s + ctx.refCsip.toString() + ", routine " + routine.toString(false) + ", block " + compareBlock.toString(true) +  ", target @" + ctx.tgtCsip.toString());
+            verbose("--- Now @", ctx.refCsip, ", routine ", routine.toString(false), ", block ", compareBlock.toString(true), ", target @", ctx.tgtCsip);
         }
         // TODO: consider dropping this "feature"
         else { // comparing without a map
-            verbose("--- Comparing reference @ "s + ctx.refCsip.toString() + " to target @" + ctx.tgtCsip.toString());
+            verbose("--- Comparing reference @ ", ctx.refCsip, " to target @", ctx.tgtCsip);
+        }
+        if (options.records) routineRecord(ctx, "enter", routine, compareBlock);
+        // find how much of the block is identical in the target with a single compare, the instructions in that span
+        // match without decoding the target instruction or comparing the decoded pair
+        ctx.identical = 0;
+        if (compareBlock.isValid()) {
+            ctx.identical = identicalBytes(ctx, compareBlock.end);
+            ctx.stats.blocks++;
+            ctx.stats.spanBytes += ctx.identical;
+            if (ctx.identical == compareBlock.end.toLinear() - ctx.refCsip.toLinear() + 1) ctx.stats.fullBlocks++;
         }
         Size refSkipCount = 0, tgtSkipCount = 0;
         Address refSkipOrigin, tgtSkipOrigin;
@@ -616,18 +764,21 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
         while (true) {
             // if we ran outside of the code extents, consider the comparison successful
             if (!contains(ctx.refCsip) || !target.contains(ctx.tgtCsip)) {
-                debug("Advanced past code extents: csip = "s + ctx.refCsip.toString() + " / " + ctx.tgtCsip.toString() + " vs extents " + codeExtents.toString() 
-                    + " / " + target.codeExtents.toString());
+                debug("Advanced past code extents: csip = ", ctx.refCsip, " / ", ctx.tgtCsip, " vs extents ", codeExtents, " / ", target.codeExtents);
                 // make sure we are not skipping instructions
                 // TODO: make this non-fatal, just make the skip fail
-                if (refSkipCount || tgtSkipCount) return false;
+                if (refSkipCount || tgtSkipCount) return result(false);
                 else break;
             }
 
-            // decode instructions
-            Instruction 
-                refInstr{ctx.refCsip, code.pointer(ctx.refCsip)}, 
-                tgtInstr{ctx.tgtCsip, target.code.pointer(ctx.tgtCsip)};
+            // decode instructions, inside an identical span the target instruction only differs in its address
+            const Instruction refInstr = instruction(ctx.refCsip);
+            Instruction tgtInstr;
+            if (ctx.identical >= refInstr.length) {
+                tgtInstr = refInstr;
+                tgtInstr.addr = ctx.tgtCsip;
+            }
+            else tgtInstr = target.instruction(ctx.tgtCsip);
             
             // mark this instruction as visited, unlike the routine finding algorithm, we do not differentiate between routine IDs
             compareQ.setRoutineId(ctx.refCsip.toLinear(), refInstr.length, VISITED_ID);
@@ -643,7 +794,7 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
                     refSkipCount = tgtSkipCount = 0;
                     refSkipOrigin = tgtSkipOrigin = Address();
                 }
-                verbose(compareStatus(refInstr, tgtInstr, true));
+                verbose(statusArg(refInstr, tgtInstr, true));
                 // an instruction match resets the allowed skip counters
                 break;
             case CMP_MISMATCH:
@@ -670,19 +821,29 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
                     if (refSkipCount || tgtSkipCount) {
                         skipContext(ctx, refSkipOrigin, tgtSkipOrigin, refSkipCount, tgtSkipCount);
                     }
-                    verbose(output_color(OUT_RED) + compareStatus(refInstr, tgtInstr, true) + output_color(OUT_DEFAULT));
-                    error("Instruction mismatch in routine " + routine.name + " at " + compareStatus(refInstr, tgtInstr, false));
+                    trace(TRC_MISMATCH, ctx.refCsip, 0, traceAddr(ctx.tgtCsip), 0, SKIP_NONE);
+                    verbose(output_color(OUT_RED), statusArg(refInstr, tgtInstr, true), output_color(OUT_DEFAULT));
+                    if (options.records) compareRecord(ctx, "compare", CMP_NAME[matchType], refInstr, tgtInstr, tgtInstr.length);
+                    error("Instruction mismatch in routine ", routine.name, " at ", statusArg(refInstr, tgtInstr, false));
                     diffContext(ctx);
-                    return false;
+                    return result(false);
                 }
                 break;
             case CMP_DIFFVAL:
-                verbose(output_color(OUT_YELLOW) + compareStatus(refInstr, tgtInstr, true) + output_color(OUT_DEFAULT));
+                verbose(output_color(OUT_YELLOW), statusArg(refInstr, tgtInstr, true), output_color(OUT_DEFAULT));
                 break;
             case CMP_DIFFTGT:
-                verbose(output_color(OUT_BRIGHTRED) + compareStatus(refInstr, tgtInstr, true) + output_color(OUT_DEFAULT));
+                verbose(output_color(OUT_BRIGHTRED), statusArg(refInstr, tgtInstr, true), output_color(OUT_DEFAULT));
                 break;                
             }
+            if (options.records) {
+                if (matchType == CMP_VARIANT) 
+                    compareRecord(ctx, "variant", CMP_NAME[matchType], refInstr, tgtInstr, ctx.tgtCsip.toLinear() - tgtInstr.addr.toLinear());
+                else if (skipType != SKIP_NONE) 
+                    compareRecord(ctx, "skip", skipType == SKIP_REF ? "ref" : "tgt", refInstr, tgtInstr, tgtInstr.length);
+                else 
+                    compareRecord(ctx, "compare", CMP_NAME[matchType], refInstr, tgtInstr, tgtInstr.length);
+            }
             // comparison result okay (instructions match or skip permitted), interpret the instructions
 
             // instruction is a call, save destination to the comparison queue 
@@ -711,12 +872,13 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
             switch (matchType) {
             case CMP_MISMATCH:
                 // if the instructions did not match and we still got here, that means we are in difference skipping mode, 
-                debug(compareStatus(refInstr, tgtInstr, false, INS_MATCH_MISMATCH));
+                trace(TRC_MISMATCH, ctx.refCsip, 0, traceAddr(ctx.tgtCsip), 0, skipType);
+                debug(statusArg(refInstr, tgtInstr, false, INS_MATCH_MISMATCH));
                 switch (skipType) {
                 case SKIP_REF: 
                     comparedSize += refInstr.length;
                     ctx.refCsip += refInstr.length;
-                    debug("Skipping over reference instruction mismatch, allowed " + to_string(refSkipCount) + " out of " + to_string(options.refSkip) + ", destination " + ctx.refCsip.toString());
+                    debug("Skipping over reference instruction mismatch, allowed ", refSkipCount, " out of ", options.refSkip, ", destination ", ctx.refCsip);
                     break;
                 case SKIP_TGT:
                     // rewind reference position if it was skipped before
@@ -725,36 +887,41 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
                         ctx.refCsip = refSkipOrigin;
                     }
                     ctx.tgtCsip += tgtInstr.length;
-                    debug("Skipping over target instruction mismatch, allowed " + to_string(tgtSkipCount)  + " out of " + to_string(options.tgtSkip) + ", destination " + ctx.tgtCsip.toString());
+                    debug("Skipping over target instruction mismatch, allowed ", tgtSkipCount, " out of ", options.tgtSkip, ", destination ", ctx.tgtCsip);
                     break;
                 default:
                     error("Unexpected: no skip despite mismatch");
-                    return false;
+                    return result(false);
                 }
+                ctx.identical = 0;
                 break;
             case CMP_VARIANT:
                 comparedSize += refInstr.length;
                 ctx.refCsip += refInstr.length;
                 // in case of a variant match, the instruction pointer in the target binary will have already been advanced by instructionsMatch()
-                debug("Variant match detected, comparison will continue at " + ctx.tgtCsip.toString());
+                debug("Variant match detected, comparison will continue at ", ctx.tgtCsip);
+                ctx.identical = 0;
                 break;
             default:
                 // normal case, advance both reference and target positions
                 comparedSize += refInstr.length;
                 ctx.refCsip += refInstr.length;
                 ctx.tgtCsip += tgtInstr.length;
+                // the positions stay in step as long as the instructions have the same length
+                ctx.identical = ctx.identical >= refInstr.length && tgtInstr.length == refInstr.length ? ctx.identical - refInstr.length : 0;
                 break;
             }
             
             // an end of a routine block is a hard stop, we do not want to go into unreachable areas which may contain invalid opcodes (e.g. data mixed with code)
             // TODO: need to handle case where we are skipping right now
             if (compareBlock.isValid() && ctx.refCsip > compareBlock.end) {
-                verbose("Reached end of routine block @ "s + compareBlock.end.toString());
+                verbose("Reached end of routine block @ ", compareBlock.end);
+                if (options.records) routineRecord(ctx, "leave", routine, compareBlock);
                 // if the current routine still contains reachable blocks after the current location, add the start of the next one to the back of the queue,
                 // so it gets picked up immediately on the next iteration of the outer loop
                 const Block rb = routine.nextReachable(ctx.refCsip);
                 if (rb.isValid()) {
-                    verbose("Routine still contains reachable blocks, next @ " + rb.toString());
+                    verbose("Routine still contains reachable blocks, next @ ", rb);
                     compareQ.saveJump(rb.begin, {});
                     if (!ctx.offMap.getCode(rb.begin).isValid()) {
                         // the offset map between the reference and the target does not have a matching entry for the next reachable block's destination,
@@ -762,26 +929,25 @@ bool Executable::compareCode(const RoutineMap &routineMap, const Executable &tar
                         // based on the hope that the size of the unreachable block matches in the target
                         // TODO: make sure an instruction matches at the destination before actually recording the mapping
                         const Address guess = ctx.tgtCsip + (rb.begin - ctx.refCsip);
-                        debug("Recording guess offset mapping based on unreachable block size: " + rb.begin.toString() + " -> " + guess.toString());
+                        debug("Recording guess offset mapping based on unreachable block size: ", rb.begin, " -> ", guess);
                         ctx.offMap.setCode(rb.begin, guess);
                     }
                 }
                 else {
-                    verbose("Completed comparison of routine " + routine.name + ", no more reachable blocks");
+                    verbose("Completed comparison of routine ", routine.name, ", no more reachable blocks");
                 }
                 break;
             }
 
             // reached predefined stop address
             if (options.stopAddr.isValid() && ctx.refCsip >= options.stopAddr) {
-                verbose("Reached stop address: " + ctx.refCsip.toString());
+                verbose("Reached stop address: ", ctx.refCsip);
                 goto success;
             }
         } // iterate over instructions at current comparison location
     } // iterate over comparison location queue
 
 success:
-    verbose(output_color(OUT_GREEN) + "Comparison result positive" + ", compared " + to_string(comparedSize) + "/" + hexVal(comparedSize) + " bytes, " 
-        + to_string(routineNames.size()) + " routines" + output_color(OUT_DEFAULT));
-    return true;
+    verbose(output_color(OUT_GREEN), "Comparison result positive", ", compared ", comparedSize, "/", hexArg(comparedSize), " bytes, ", routineNames.size(), " routines", output_color(OUT_DEFAULT));
+    return result(true);
 }
@@ -0,0 +1,130 @@
+#include "dos/format.h"
+
+#include <cstring>
+
+static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+// both hex digits of every byte value, so the conversion can proceed two digits at a time
+struct HexPairs {
+    char c[512];
+    constexpr HexPairs() : c() {
+        for (int i = 0; i < 256; ++i) {
+            c[2 * i] = HEX_DIGITS[i >> 4];
+            c[2 * i + 1] = HEX_DIGITS[i & 0xf];
+        }
+    }
+};
+static constexpr HexPairs HEX_PAIRS{};
+
+static inline char* put(char *buf, const char *str, const Size len) {
+    memcpy(buf, str, len);
+    return buf + len;
+}
+
+static inline char* hexPrefix(char *buf, const bool hdr) {
+    if (hdr) {
+        *buf++ = '0';
+        *buf++ = 'x';
+    }
+    return buf;
+}
+
+char* formatHexDigits(char *buf, uint64_t val, const int width) {
+    int digits = 1;
+    for (uint64_t v = val >> 4; v != 0; v >>= 4) digits++;
+    if (digits < width) digits = width;
+    char *const end = buf + digits;
+    char *p = end;
+    // fill from the least significant end, leading zero padding falls out of the value running out of bits
+    while (p - buf >= 2) {
+        p -= 2;
+        memcpy(p, &HEX_PAIRS.c[(val & 0xff) * 2], 2);
+        val >>= 8;
+    }
+    if (p != buf) *--p = HEX_DIGITS[val & 0xf];
+    return end;
+}
+
+char* formatHex(char *buf, const Byte val, const bool prefix, const bool pad) {
+    return formatHexDigits(hexPrefix(buf, prefix), val, pad ? 2 : 1);
+}
+
+// signed values are shown as their two's complement after promotion to int, like the stream output did
+char* formatHex(char *buf, const SByte val, const bool prefix, const bool pad) {
+    return formatHexDigits(hexPrefix(buf, prefix), static_cast<unsigned>(static_cast<int>(val)), pad ? 2 : 1);
+}
+
+char* formatHex(char *buf, const Word val, const bool prefix, const bool pad) {
+    return formatHexDigits(hexPrefix(buf, prefix), val, pad ? 4 : 1);
+}
+
+char* formatHex(char *buf, const SWord val, const bool prefix, const bool pad) {
+    return formatHexDigits(hexPrefix(buf, prefix), static_cast<Word>(val), pad ? 4 : 1);
+}
+
+char* formatHex(char *buf, const DWord val, const bool prefix, const bool pad) {
+    return formatHexDigits(hexPrefix(buf, prefix), val, pad ? 8 : 1);
+}
+
+char* formatHex(char *buf, const Offset val, const bool hdr, const int pad) {
+    return formatHexDigits(hexPrefix(buf, hdr), val, pad);
+}
+
+char* formatHex(char *buf, SOffset val, const bool hdr, const int pad) {
+    if (val < 0) {
+        *buf++ = '-';
+        val = -val;
+    }
+    return formatHexDigits(hexPrefix(buf, hdr), static_cast<uint64_t>(val), pad);
+}
+
+char* formatSignedHex(char *buf, const SByte val, const bool plus) {
+    if (val >= 0) {
+        if (plus) *buf++ = '+';
+        return formatHexDigits(hexPrefix(buf, true), val, 2);
+    }
+    *buf++ = '-';
+    return formatHexDigits(hexPrefix(buf, true), -static_cast<int>(val), 2);
+}
+
+char* formatSignedHex(char *buf, const SWord val, const bool plus) {
+    if (val >= 0) {
+        if (plus) *buf++ = '+';
+        return formatHexDigits(hexPrefix(buf, true), val, 4);
+    }
+    *buf++ = '-';
+    return formatHexDigits(hexPrefix(buf, true), -static_cast<int>(val), 4);
+}
+
+char* formatAddress(char *buf, const Address &addr, const bool brief) {
+    static const char INVALID[] = "(invalid)";
+    if (!addr.isValid()) return put(buf, INVALID, sizeof(INVALID) - 1);
+    buf = formatHexDigits(buf, addr.segment, WORD_STRLEN);
+    *buf++ = ':';
+    buf = formatHexDigits(buf, addr.offset, WORD_STRLEN);
+    if (!brief) {
+        *buf++ = '/';
+        buf = formatHexDigits(buf, addr.toLinear(), OFFSET_STRLEN);
+    }
+    return buf;
+}
+
+char* formatBlock(char *buf, const Block &block, const bool linear, const bool showSize) {
+    static const char INVALID[] = "[invalid]";
+    if (!block.isValid()) return put(buf, INVALID, sizeof(INVALID) - 1);
+    if (!linear) {
+        buf = formatAddress(buf, block.begin, true);
+        *buf++ = '-';
+        buf = formatAddress(buf, block.end, true);
+    }
+    else {
+        buf = formatHexDigits(buf, block.begin.toLinear(), OFFSET_STRLEN);
+        *buf++ = '-';
+        buf = formatHexDigits(buf, block.end.toLinear(), OFFSET_STRLEN);
+    }
+    if (showSize) {
+        *buf++ = '/';
+        buf = formatHexDigits(buf, block.size(), OFFSET_STRLEN);
+    }
+    return buf;
+}
@@ -3,15 +3,13 @@
 #include "dos/error.h"
 #include "dos/util.h"
 #include "dos/output.h"
+#include "dos/format.h"
 
-#include <sstream>
 #include <cstring>
 
 using namespace std;
 
-// TODO: handle invalid opcodes gracefully, don't throw/assert
-
-#define DEBUG(msg) output(msg, LOG_CPU, LOG_DEBUG)
+#define DEBUG(...) logOutput<LOG_DEBUG>(LOG_CPU, __VA_ARGS__)
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
 
 #define X(x) #x,
@@ -33,13 +31,19 @@ INS_GROUP_IDX
 static const char* INS_MATCH_ID[] = {
 INSTRUCTION_MATCH
 };
+static const char* INS_STATUS_ID[] = {
+INSTRUCTION_STATUS
+};
 static const char* MODRM_OPR_ID[] = {
 MODRM_OPERAND
 };
+static const char* CPU_LEVEL_ID[] = {
+CPU_LEVEL
+};
 #undef X
 
 // maps non-group opcodes to an instruction class
-static const InstructionClass OPCODE_CLASS[] = {
+static constexpr InstructionClass OPCODE_CLASS[] = {
 // 0           1           2           3           4           5           6           7           8           9           A             B           C           D           E           F
 INS_ADD,    INS_ADD,    INS_ADD,    INS_ADD,    INS_ADD,    INS_ADD,    INS_PUSH,   INS_POP,    INS_OR,     INS_OR,     INS_OR,       INS_OR,     INS_OR,     INS_OR,     INS_PUSH,   INS_ERR,    // 0
 INS_ADC,    INS_ADC,    INS_ADC,    INS_ADC,    INS_ADC,    INS_ADC,    INS_PUSH,   INS_POP,    INS_SBB,    INS_SBB,    INS_SBB,      INS_SBB,    INS_SBB,    INS_SBB,    INS_PUSH,   INS_POP,    // 1
@@ -60,7 +64,7 @@ INS_LOCK,   INS_ERR,    INS_REPNZ,  INS_REPZ,   INS_HLT,    INS_CMC,    INS_ERR,
 };
 
 // maps group opcodes to group indexes in the next table
-static const InstructionGroupIndex GRP_IDX[0x100] = {
+static constexpr InstructionGroupIndex GRP_IDX[0x100] = {
 //  0         1         2         3         4         5         6         7         8         9         A         B         C         D         E         F
 IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, // 0
 IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, // 1
@@ -81,7 +85,7 @@ IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_BAD, IGRP_3a,  IGRP_3b,
 };
 
 // maps a group index and the GRP value from a modrm byte to an instruction class for a group opcode
-static const InstructionClass GRP_INS_CLASS[6][8] = {
+static constexpr InstructionClass GRP_INS_CLASS[6][8] = {
     INS_ADD,  INS_OR,  INS_ADC,  INS_SBB,      INS_AND, INS_SUB,      INS_XOR,  INS_CMP,  // GRP1
     INS_ROL,  INS_ROR, INS_RCL,  INS_RCR,      INS_SHL, INS_SHR,      INS_ERR,  INS_SAR,  // GRP2
     INS_TEST, INS_ERR, INS_NOT,  INS_NEG,      INS_MUL, INS_IMUL,     INS_DIV,  INS_IDIV, // GRP3a
@@ -91,7 +95,7 @@ static const InstructionClass GRP_INS_CLASS[6][8] = {
 };
 
 // maps non-modrm opcodes into their first operand's type
-static const OperandType OP1_TYPE[] = {
+static constexpr OperandType OP1_TYPE[] = {
 //   0         1           2              3              4           5           6           7           8           9           A           B           C           D           E           F
 OPR_ERR,    OPR_ERR,    OPR_ERR,       OPR_ERR,       OPR_REG_AL, OPR_REG_AX, OPR_REG_ES, OPR_REG_ES, OPR_ERR,    OPR_ERR,    OPR_ERR,    OPR_ERR,    OPR_REG_AL, OPR_REG_AX, OPR_REG_CS, OPR_ERR,    // 0
 OPR_ERR,    OPR_ERR,    OPR_ERR,       OPR_ERR,       OPR_REG_AL, OPR_REG_AX, OPR_REG_SS, OPR_REG_SS, OPR_ERR,    OPR_ERR,    OPR_ERR,    OPR_ERR,    OPR_REG_AL, OPR_REG_AX, OPR_REG_DS, OPR_REG_DS, // 1
@@ -111,8 +115,8 @@ OPR_IMM8,   OPR_IMM8,   OPR_IMM8,      OPR_IMM8,      OPR_REG_AL, OPR_REG_AX, OP
 OPR_NONE,   OPR_NONE,   OPR_NONE,      OPR_NONE,      OPR_NONE,   OPR_NONE,   OPR_ERR,    OPR_ERR,    OPR_NONE,   OPR_NONE,   OPR_NONE,   OPR_NONE,   OPR_NONE,   OPR_NONE,   OPR_ERR,    OPR_ERR,    // F
 };
 
-// maps non-modrm opcodes into their first operand's type
-static const OperandType OP2_TYPE[] = {
+// maps non-modrm opcodes into their second operand's type
+static constexpr OperandType OP2_TYPE[] = {
 //   0            1              2           3           4           5           6           7           8          9          A          B          C           D           E           F
 OPR_ERR,       OPR_ERR,       OPR_ERR,    OPR_ERR,    OPR_IMM8,   OPR_IMM16,  OPR_NONE,   OPR_NONE,   OPR_ERR,   OPR_ERR,   OPR_ERR,   OPR_ERR,   OPR_IMM8,   OPR_IMM16,  OPR_NONE,   OPR_ERR,    // 0
 OPR_ERR,       OPR_ERR,       OPR_ERR,    OPR_ERR,    OPR_IMM8,   OPR_IMM16,  OPR_NONE,   OPR_NONE,   OPR_ERR,   OPR_ERR,   OPR_ERR,   OPR_ERR,   OPR_IMM8,   OPR_IMM16,  OPR_NONE,   OPR_NONE,   // 1
@@ -133,7 +137,7 @@ OPR_NONE,      OPR_NONE,      OPR_NONE,   OPR_NONE,   OPR_NONE,   OPR_NONE,   OP
 };
 
 // map operand type to operand size
-static const OperandSize OPR_SIZE[] = {
+static constexpr OperandSize OPR_SIZE[] = {
     OPRSZ_UNK,  OPRSZ_NONE, // error, none
     OPRSZ_WORD, OPRSZ_BYTE, OPRSZ_BYTE, // ax, al, ah
     OPRSZ_WORD, OPRSZ_BYTE, OPRSZ_BYTE, // bx, bl, bh
@@ -153,7 +157,7 @@ static const OperandSize OPR_SIZE[] = {
 };
 
 // map modrm operand type to operand size
-static const OperandSize MODRM_OPR_SIZE[] = {
+static constexpr OperandSize MODRM_OPR_SIZE[] = {
     OPRSZ_NONE,  // MODRM_NONE
     OPRSZ_BYTE,  // MODRM_Eb
     OPRSZ_BYTE,  // MODRM_Gb
@@ -168,6 +172,234 @@ static const OperandSize MODRM_OPR_SIZE[] = {
     OPRSZ_BYTE,  // MODRM_CL
 };
 
+// modrm operand designations of opcodes with a modrm byte
+static constexpr ModrmOperand MODRM_OP1[] = {
+//   0           1           2           3           4           5           6           7           8           9           A           B           C           D           E           F
+MODRM_Eb,     MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Eb,   MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 0
+MODRM_Eb,     MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Eb,   MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 1
+MODRM_Eb,     MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Eb,   MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 2
+MODRM_Eb,     MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Eb,   MODRM_Ev,   MODRM_Gb,   MODRM_Gv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 3
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 4
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 5
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 6
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 7
+MODRM_Eb,     MODRM_Ev,   MODRM_Eb,   MODRM_Ev,   MODRM_Gb,   MODRM_Gv,   MODRM_Gb,   MODRM_Gv,   MODRM_Eb,   MODRM_Ev,   MODRM_Gb,   MODRM_Gv,   MODRM_Ev,   MODRM_Gv,   MODRM_Sw, MODRM_NONE, // 8
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 9
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // A
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // B
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Gv,   MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // C
+MODRM_Eb,    MODRM_Ev,    MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // D
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // E
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Eb,   MODRM_Ev, // F
+};
+
+static constexpr ModrmOperand MODRM_OP2[] = {
+//   0           1           2           3           4           5           6           7           8           9           A           B           C           D           E           F
+MODRM_Gb,     MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Gb,   MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 0
+MODRM_Gb,     MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Gb,   MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 1
+MODRM_Gb,     MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Gb,   MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 2
+MODRM_Gb,     MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Gb,   MODRM_Gv,   MODRM_Eb,   MODRM_Ev, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 3
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 4
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 5
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 6
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 7
+MODRM_Ib,     MODRM_Iv,   MODRM_Ib  , MODRM_Ib,   MODRM_Eb,   MODRM_Ev,   MODRM_Eb,   MODRM_Ev,   MODRM_Gb,   MODRM_Gv,   MODRM_Eb,   MODRM_Ev,   MODRM_Sw,    MODRM_M,   MODRM_Ev, MODRM_NONE, // 8
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // 9
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // A
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // B
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE,   MODRM_Mp,   MODRM_Mp,   MODRM_Ib,   MODRM_Iv, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // C
+MODRM_1,       MODRM_1,   MODRM_CL,   MODRM_CL, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // D
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // E
+MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, MODRM_NONE, // F
+};
+
+// opcodes followed by a modrm byte
+static constexpr bool OPCODE_MODRM[256] = {
+//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 0
+    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 1
+    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 2
+    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 3
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 4
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 5
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 6
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 7
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 8
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 9
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // A
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // B
+    0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, // C
+    1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // D
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // E
+    0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, // F
+};
+
+// opcodes whose instruction class is selected by the modrm byte
+static constexpr bool OPCODE_GROUP[256] = {
+//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 1
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 2
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 3
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 4
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 5
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 6
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 7
+    1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 8
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 9
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // A
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // B
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // C
+    1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // D
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // E
+    0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, // F
+};
+
+// segment override prefixes
+static constexpr bool OPCODE_PREFIX[256] = {
+//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 1
+    0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, // 2
+    0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, // 3
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 4
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 5
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 6
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 7
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 8
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 9
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // A
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // B
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // C
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // D
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // E
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // F
+};
+
+static constexpr Byte immediateSize(const OperandType ot) {
+    switch (ot) {
+    case OPR_IMM8:      return sizeof(Byte);
+    case OPR_IMM16:
+    case OPR_MEM_OFF16: return sizeof(Word);
+    case OPR_IMM32:     return sizeof(DWord);
+    default:            return 0;
+    }
+}
+
+static constexpr Byte immediateSize(const ModrmOperand mo) {
+    switch (mo) {
+    case MODRM_Ib: return sizeof(Byte);
+    case MODRM_Iv: return sizeof(Word);
+    default:       return 0;
+    }
+}
+
+// opcodes added by the 80186, which are not valid on the 8086
+struct OpcodeEntry {
+    Byte opcode;
+    InstructionClass iclass;
+    InstructionGroupIndex group;
+    OperandType op1, op2;
+    ModrmOperand modop1, modop2;
+    bool modrm, isGroup;
+    Byte imm3;
+};
+
+static constexpr OpcodeEntry OPCODES_80186[] = {
+    { OP_PUSHA,         INS_PUSHA, IGRP_BAD, OPR_NONE,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_POPA,          INS_POPA,  IGRP_BAD, OPR_NONE,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_BOUND_Gv_M,    INS_BOUND, IGRP_BAD, OPR_ERR,   OPR_ERR,  MODRM_Gv,   MODRM_M,    true,  false, 0 },
+    { OP_PUSH_Iv,       INS_PUSH,  IGRP_BAD, OPR_IMM16, OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_IMUL_Gv_Ev_Iv, INS_IMUL,  IGRP_BAD, OPR_ERR,   OPR_ERR,  MODRM_Gv,   MODRM_Ev,   true,  false, 2 },
+    { OP_PUSH_Ib,       INS_PUSH,  IGRP_BAD, OPR_IMM8,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_IMUL_Gv_Ev_Ib, INS_IMUL,  IGRP_BAD, OPR_ERR,   OPR_ERR,  MODRM_Gv,   MODRM_Ev,   true,  false, 1 },
+    { OP_INSB,          INS_INSB,  IGRP_BAD, OPR_NONE,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_INSW,          INS_INSW,  IGRP_BAD, OPR_NONE,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_OUTSB,         INS_OUTSB, IGRP_BAD, OPR_NONE,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_OUTSW,         INS_OUTSW, IGRP_BAD, OPR_NONE,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_GRP2_Eb_Ib,    INS_ERR,   IGRP_2,   OPR_ERR,   OPR_ERR,  MODRM_Eb,   MODRM_Ib,   true,  true,  0 },
+    { OP_GRP2_Ev_Ib,    INS_ERR,   IGRP_2,   OPR_ERR,   OPR_ERR,  MODRM_Ev,   MODRM_Ib,   true,  true,  0 },
+    { OP_ENTER_Iw_Ib,   INS_ENTER, IGRP_BAD, OPR_IMM16, OPR_IMM8, MODRM_NONE, MODRM_NONE, false, false, 0 },
+    { OP_LEAVE,         INS_LEAVE, IGRP_BAD, OPR_NONE,  OPR_NONE, MODRM_NONE, MODRM_NONE, false, false, 0 },
+};
+
+static constexpr void setOpcodeDesc(OpcodeDesc &d, const OpcodeEntry &e, const bool segPrefix) {
+    d.iclass = e.iclass;
+    d.group = e.group;
+    d.op1 = e.op1;
+    d.op2 = e.op2;
+    d.modop1 = e.modop1;
+    d.modop2 = e.modop2;
+    d.modrm = e.modrm;
+    d.isGroup = e.isGroup;
+    d.segPrefix = segPrefix;
+    d.imm3 = e.imm3;
+    if (d.modrm) {
+        d.size1 = MODRM_OPR_SIZE[d.modop1];
+        d.size2 = MODRM_OPR_SIZE[d.modop2];
+        d.immSize = immediateSize(e.modop1) + immediateSize(e.modop2) + e.imm3;
+    }
+    else {
+        d.size1 = OPR_SIZE[d.op1];
+        d.size2 = OPR_SIZE[d.op2];
+        d.immSize = immediateSize(e.op1) + immediateSize(e.op2);
+    }
+}
+
+// merge the tables above into the per-opcode descriptors of a CPU level
+constexpr OpcodeTable::OpcodeTable(const CpuLevel cpu) : desc() {
+    for (int op = 0; op < 0x100; ++op) {
+        const OpcodeEntry e{ static_cast<Byte>(op), OPCODE_CLASS[op], GRP_IDX[op], OP1_TYPE[op], OP2_TYPE[op], 
+            MODRM_OP1[op], MODRM_OP2[op], OPCODE_MODRM[op], OPCODE_GROUP[op], 0 };
+        setOpcodeDesc(desc[op], e, OPCODE_PREFIX[op]);
+    }
+    if (cpu < CPU_80186) return;
+    for (const OpcodeEntry &e : OPCODES_80186) setOpcodeDesc(desc[e.opcode], e, false);
+}
+
+alignas(64) constexpr OpcodeTable OPCODE_TABLE{CPU_8086};
+alignas(64) static constexpr OpcodeTable OPCODE_TABLE_80186{CPU_80186};
+// the 80286 has no additional real mode instructions
+static const OpcodeTable* const OPCODE_TABLES[CPU_LEVEL_COUNT] = { &OPCODE_TABLE, &OPCODE_TABLE_80186, &OPCODE_TABLE_80186 };
+
+const OpcodeTable& opcodeTable(const CpuLevel cpu) {
+    return *OPCODE_TABLES[cpu];
+}
+
+const char* cpu_level_name(const CpuLevel cpu) {
+    return CPU_LEVEL_ID[cpu];
+}
+
+CpuLevel cpuLevel(const std::string &name) {
+    static const char* SHORT_NAME[] = { "8086", "186", "286" };
+    static_assert(ARRAY_SIZE(SHORT_NAME) == ARRAY_SIZE(CPU_LEVEL_ID), "CPU level names out of sync");
+    for (Size i = 0; i < CPU_LEVEL_COUNT; ++i) {
+        if (name == CPU_LEVEL_ID[i] || name == SHORT_NAME[i] || name == "80"s + SHORT_NAME[i]) return static_cast<CpuLevel>(i);
+    }
+    throw ArgError("Unsupported CPU level: " + name);
+}
+static_assert(ARRAY_SIZE(INS_CLASS_ID) <= 0x100 && ARRAY_SIZE(OPR_TYPE_ID) <= 0x100, "Instruction class or operand type does not fit the opcode descriptor");
+
+bool opcodeIsModrm(const Byte opcode) {
+    return opcodeDesc(opcode).modrm;
+}
+
+bool opcodeIsGroup(const Byte opcode) {
+    return opcodeDesc(opcode).isGroup;
+}
+
+bool opcodeIsSegmentPrefix(const Byte opcode) {
+    return opcodeDesc(opcode).segPrefix;
+}
+
+ModrmOperand modrm_op1(const Byte opcode) {
+    return static_cast<ModrmOperand>(opcodeDesc(opcode).modop1);
+}
+
+ModrmOperand modrm_op2(const Byte opcode) {
+    return static_cast<ModrmOperand>(opcodeDesc(opcode).modop2);
+}
+
 // convert an operand type with a memory offset or an immediate value to a word-sized equivalent, 
 // useful in fuzzy comparisons
 OperandType operandTypeToWord(const OperandType ot) {
@@ -227,16 +459,70 @@ Register defaultMemSegment(const OperandType ot) {
     return ret;
 }
 
-Instruction::Instruction() : addr{}, prefix(PRF_NONE), opcode(OP_INVALID), iclass(INS_ERR), length(0) {
+// 64bit finalizer of MurmurHash3, every bit of the input affects every bit of the output
+static inline uint64_t mix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
 }
 
-Instruction::Instruction(const Address &addr, const Byte *data) : addr{addr}, prefix(PRF_NONE), opcode(OP_INVALID), iclass(INS_ERR), length(0) {
-    load(data);
+static inline DWord fingerprintMix(const uint64_t key) {
+    const uint64_t h = mix64(key);
+    return static_cast<DWord>(h ^ (h >> 32));
 }
 
-void Instruction::load(const Byte *data)  {
+Instruction::Instruction() : addr{}, prefix(PRF_NONE), opcode(OP_INVALID), iclass(INS_ERR), length(0), status(INS_STATUS_INVALID), fingerprint(0) {
+}
+
+Instruction::Instruction(const Address &addr, const Byte *data, const Size size, const CpuLevel cpu) : addr{addr}, prefix(PRF_NONE), opcode(OP_INVALID), iclass(INS_ERR), length(0), status(INS_STATUS_OK), fingerprint(0) {
+    load(data, size, cpu);
+}
+
+Instruction::Instruction(const InstructionRecord &rec) : addr{rec.addr}, prefix(static_cast<InstructionPrefix>(rec.prefix)), opcode(rec.opcode), 
+    iclass(static_cast<InstructionClass>(rec.iclass)), length(rec.length), status(static_cast<InstructionStatus>(rec.status))
+{
+    op1.type = static_cast<OperandType>(rec.op1Type);
+    op1.size = static_cast<OperandSize>(rec.op1Size);
+    op1.immval.u32 = op1.type == OPR_IMM32 ? rec.imm : rec.imm & 0xffff;
+    op2.type = static_cast<OperandType>(rec.op2Type);
+    op2.size = static_cast<OperandSize>(rec.op2Size);
+    op2.immval.u32 = rec.imm >> 16;
+    fingerprint = fingerprintMix(fingerprintKey());
+}
+
+static_assert(ARRAY_SIZE(INS_PRF_ID) <= 8 && ARRAY_SIZE(OPR_SIZE_ID) <= 16, "Instruction prefix or operand size does not fit the instruction record");
+
+InstructionRecord Instruction::record() const {
+    assert(op2.type != OPR_IMM32);
+    InstructionRecord rec;
+    rec.addr = addr;
+    rec.imm = op1.type == OPR_IMM32 ? op1.immval.u32 : op1.immval.u16 | static_cast<DWord>(op2.immval.u16) << 16;
+    rec.opcode = opcode;
+    rec.iclass = iclass;
+    rec.prefix = prefix;
+    rec.length = length;
+    rec.op1Type = op1.type;
+    rec.op2Type = op2.type;
+    rec.op1Size = op1.size;
+    rec.op2Size = op2.size;
+    rec.status = status;
+    return rec;
+}
+
+void Instruction::load(const Byte *data, const Size size, const CpuLevel cpu)  {
+    // decode a short buffer from a zero-padded copy, so that decoding never reads past its end
+    Byte padded[INSTRUCTION_MAX] = {};
+    if (size < INSTRUCTION_MAX) {
+        memcpy(padded, data, size);
+        data = padded;
+    }
+    const OpcodeTable &table = opcodeTable(cpu);
     opcode = *data++;
     length++;
+    const OpcodeDesc *desc = &table.desc[opcode];
     // in case of a chain opcode, use it to set an appropriate prefix value and replace the opcode with the subsequent instruction
     // TODO: support LOCK, other prefix-like opcodes?
     if (opcode == OP_REPZ || opcode == OP_REPNZ) { 
@@ -244,62 +530,62 @@ void Instruction::load(const Byte *data)  {
         // TODO: guard against memory overflow
         opcode = *data++;
         length++;
-        DEBUG("Found chain prefix "s + INS_PRF_ID[prefix] + ", length = " + to_string(length));
+        desc = &table.desc[opcode];
+        DEBUG("Found chain prefix ", INS_PRF_ID[prefix], ", length = ", length);
     }
     // likewise in case of a segment ovverride prefix, set instruction prefix value and get next opcode
-    else if (opcodeIsSegmentPrefix(opcode)) {
+    else if (desc->segPrefix) {
         prefix = static_cast<InstructionPrefix>(((opcode - OP_PREFIX_ES) / 8) + PRF_SEG_ES); // convert opcode to instruction prefix enum, the segment prefix opcode values differ by 8
         opcode = *data++;
         length++;
-        DEBUG("Found segment prefix "s + INS_PRF_ID[prefix] + ", length = " + to_string(length));
+        desc = &table.desc[opcode];
+        DEBUG("Found segment prefix ", INS_PRF_ID[prefix], ", length = ", length);
     }
 
     // regular instruction opcode
-    if (!opcodeIsModrm(opcode)) {
-        iclass = instr_class(opcode);
+    if (!desc->modrm) {
+        iclass = static_cast<InstructionClass>(desc->iclass);
         // get type of operands
-        op1.type = OP1_TYPE[opcode];
-        op2.type = OP2_TYPE[opcode];
-        DEBUG("regular opcode "s + opcodeName(opcode) + ", operand types: op1 = "s + OPR_TYPE_ID[op1.type] + ", op2 = " + OPR_TYPE_ID[op2.type] 
-            + ", class " + INS_CLASS_ID[iclass]);        
+        op1.type = static_cast<OperandType>(desc->op1);
+        op2.type = static_cast<OperandType>(desc->op2);
+        DEBUG("regular opcode ", [=]{ return opcodeName(opcode); }, ", operand types: op1 = ", OPR_TYPE_ID[op1.type], ", op2 = ", OPR_TYPE_ID[op2.type], 
+            ", class ", INS_CLASS_ID[iclass]);        
         // TODO: do not derive size from operand type, but from opcode, same for modrm and group
-        op1.size = OPR_SIZE[op1.type];
-        op2.size = OPR_SIZE[op2.type];
+        op1.size = static_cast<OperandSize>(desc->size1);
+        op2.size = static_cast<OperandSize>(desc->size2);
     }
     // modr/m insruction opcode
-    else if (!opcodeIsGroup(opcode)) {
+    else if (!desc->isGroup) {
         const Byte modrm = *data++; // load modrm byte
         length++;
         const ModrmOperand 
-            modop1 = modrm_op1(opcode),
-            modop2 = modrm_op2(opcode);
-        iclass = instr_class(opcode);
-        DEBUG("modrm opcode "s + opcodeName(opcode) + ", modrm = " + hexVal(modrm) + ", operand types: op1 = "s + MODRM_OPR_ID[modop1] + ", op2 = " + MODRM_OPR_ID[modop2] 
-            + ", class " + INS_CLASS_ID[iclass]);
+            modop1 = static_cast<ModrmOperand>(desc->modop1),
+            modop2 = static_cast<ModrmOperand>(desc->modop2);
+        iclass = static_cast<InstructionClass>(desc->iclass);
+        DEBUG("modrm opcode ", [=]{ return opcodeName(opcode); }, ", modrm = ", hexArg(modrm), ", operand types: op1 = ", MODRM_OPR_ID[modop1], ", op2 = ", MODRM_OPR_ID[modop2], 
+            ", class ", INS_CLASS_ID[iclass]);
         // convert from messy modrm operand designation to our nice type
         op1.type = getModrmOperand(modrm, modop1);
         op2.type = getModrmOperand(modrm, modop2);
-        op1.size = MODRM_OPR_SIZE[modop1];
-        op2.size = MODRM_OPR_SIZE[modop2];
+        op1.size = static_cast<OperandSize>(desc->size1);
+        op2.size = static_cast<OperandSize>(desc->size2);
     }
     // group instruction opcode
     else {
-        assert(opcodeIsGroup(opcode));
         const Byte modrm = *data++; // load modrm byte
         length++;
         // obtain index of group for instruction class lookup
-        const InstructionGroupIndex grpIdx = GRP_IDX[opcode];
+        const InstructionGroupIndex grpIdx = static_cast<InstructionGroupIndex>(desc->group);
         const Byte grpInstrIdx = modrm_grp(modrm) >> MODRM_GRP_SHIFT;
-        DEBUG("group opcode "s + opcodeName(opcode) + ", modrm = " + hexVal(modrm) + ", group index " + GRP_IDX_ID[grpIdx] + ", instruction " + hexVal(grpInstrIdx));
+        DEBUG("group opcode ", [=]{ return opcodeName(opcode); }, ", modrm = ", hexArg(modrm), ", group index ", GRP_IDX_ID[grpIdx], ", instruction ", hexArg(grpInstrIdx));
         assert(grpIdx >= IGRP_1 && grpIdx <= IGRP_5);
         assert(grpInstrIdx < 8); // groups have up to 8 instructions (index 0-based)
-        // determine instruction class
+        // determine instruction class, INS_ERR for the unused slots of a group
         iclass = GRP_INS_CLASS[grpIdx][grpInstrIdx];
-        assert(iclass != INS_ERR);
         // the rest is just like a "normal" modrm opcode
         ModrmOperand 
-            modop1 = modrm_op1(opcode),
-            modop2 = modrm_op2(opcode);
+            modop1 = static_cast<ModrmOperand>(desc->modop1),
+            modop2 = static_cast<ModrmOperand>(desc->modop2);
         // special case for implicit 2nd operand for group 3a/3b TEST instruction
         if (iclass == INS_TEST) {
             switch(grpIdx) {
@@ -314,7 +600,7 @@ void Instruction::load(const Byte *data)  {
             assert(grpIdx == IGRP_5);
             modop1 = MODRM_Mp;
         }
-        DEBUG("modrm operand types: op1 = "s + MODRM_OPR_ID[modop1] + ", op2 = " + MODRM_OPR_ID[modop2] + ", class " + INS_CLASS_ID[iclass]);            
+        DEBUG("modrm operand types: op1 = ", MODRM_OPR_ID[modop1], ", op2 = ", MODRM_OPR_ID[modop2], ", class ", INS_CLASS_ID[iclass]);            
         // convert from messy modrm operand designation to our nice type
         op1.type = getModrmOperand(modrm, modop1);
         op2.type = getModrmOperand(modrm, modop2);
@@ -322,8 +608,15 @@ void Instruction::load(const Byte *data)  {
         op2.size = MODRM_OPR_SIZE[modop2];
     }
 
-    assert(op1.type != OPR_ERR && op2.type != OPR_ERR);
-    DEBUG("generalized operands, op1: type = "s + OPR_TYPE_ID[op1.type] + ", size = " + OPR_SIZE_ID[op1.size] + ", op2: type = " + OPR_TYPE_ID[op2.type] + ", size = " + OPR_SIZE_ID[op2.size]);
+    // unknown opcode, unused group slot or a modrm byte that selects an operand not allowed for the opcode
+    if (iclass == INS_ERR || op1.type == OPR_ERR || op2.type == OPR_ERR) {
+        status = length > size ? INS_STATUS_TRUNCATED : INS_STATUS_INVALID;
+        op1 = op2 = Operand{OPR_NONE, OPRSZ_NONE, {0}};
+        fingerprint = fingerprintMix(fingerprintKey());
+        DEBUG("Invalid instruction @", addr, ": opcode ", hexArg(opcode), ", length = ", length, ", status ", INS_STATUS_ID[status]);
+        return;
+    }
+    DEBUG("generalized operands, op1: type = ", OPR_TYPE_ID[op1.type], ", size = ", OPR_SIZE_ID[op1.size], ", op2: type = ", OPR_TYPE_ID[op2.type], ", size = ", OPR_SIZE_ID[op2.size]);
     // load immediate values if present
     Size immSize = loadImmediate(op1, data);
     data += immSize;
@@ -331,7 +624,18 @@ void Instruction::load(const Byte *data)  {
     immSize = loadImmediate(op2, data);
     data += immSize;
     length += immSize;
-    DEBUG("Instruction @" + addr.toString() + ": " + toString() + ", length = " + to_string(length));
+    // three-operand imul of the 80186, the immediate goes into the unused value of the destination register operand
+    if (desc->imm3 == sizeof(Byte)) {
+        op1.immval.u16 = *data;
+        length += sizeof(Byte);
+    }
+    else if (desc->imm3 == sizeof(Word)) {
+        memcpy(&op1.immval.u16, data, sizeof(Word));
+        length += sizeof(Word);
+    }
+    if (length > size) status = INS_STATUS_TRUNCATED;
+    fingerprint = fingerprintMix(fingerprintKey());
+    DEBUG("Instruction @", addr, ": ", *this, ", length = ", length, ", status ", INS_STATUS_ID[status]);
 }
 
 // calculate an absolute offset from an offset that is relative to this instruction's end, based on the immediate operand 
@@ -355,91 +659,174 @@ SWord Instruction::relativeOffset() const {
 }
 
 
-// lookup table for which instructions modify their first operand
-// 0: doesn't modify any regs, 1: modifies 1st operand, 2: modifies both operands, 3: special case, implicit registers
-// TODO: ret accepts operand?
-// TODO: doesn't include flags register
-static const int OPERAND_MODIFIED[] = {
-    //INS_ERR   INS_ADD      INS_PUSH    INS_POP    INS_OR     INS_ADC    INS_SBB     INS_AND    INS_DAA    INS_SUB   INS_DAS       INS_XOR   INS_AAA    INS_CMP   INS_AAS    INS_INC   INS_DEC
-    0,          1,           3,          3,         1,         1,         1,          1,         3,         1,        3,            1,        3,         0,        3,         1,        1,
-    //INS_JMP   INS_JMP_IF  INS_JMP_FAR  INS_TEST    INS_XCHG   INS_MOV    INS_LEA    INS_NOP     INS_CBW    INS_CWD    INS_CALL  INS_CALL_FAR  INS_WAIT  INS_PUSHF  INS_POPF  INS_SAHF   INS_LAHF  INS_MOVSB
-    0,          0,           0,           3,          2,         1,         1,         0,          3,         3,         0,        0,            0,        3,         3,        3,         3,        2, 
-    //INS_MOVSW INS_CMPSB    INS_CMPSW   INS_STOSB  INS_STOSW  INS_LODSB  INS_LODSW   INS_SCASB  INS_SCASW  INS_RET   INS_LES       INS_LDS   INS_RETF   INS_INT   INS_INT3   INS_INTO   INS_IRET  INS_AAM
-    3,          3,           3,          3,         3,         3,         0,          3,         3,         0,        3,            3,        0,         3,        3,          3,         0,        3, 
-    //INS_AAD   INS_XLAT     INS_LOOPNZ  INS_LOOPZ  INS_LOOP   INS_IN     INS_OUT     INS_LOCK   INS_REPNZ  INS_REPZ  INS_HLT       INS_CMC   INS_CLC    INS_STC   INS_CLI    INS_STI   INS_CLD
-    3,          3,           3,          3,         3,         1,         0,          0,         0,         0,        0,            3,        3,         3,        3,         3,        3, 
-    //INS_STD   INS_ROL      INS_ROR     INS_RCL    INS_RCR    INS_SHL    INS_SHR     INS_SAR    INS_NOT    INS_NEG   INS_MUL       INS_IMUL  INS_DIV    INS_IDIV
-    3,          1,           1,          3,         3,         1,         1,          0,         1,         1,        0,            3,        3,         3,
-};
-static_assert(ARRAY_SIZE(OPERAND_MODIFIED) == ARRAY_SIZE(INS_CLASS_ID));
-
-// TODO: basically all special cases, refactor this
-vector<Register> Instruction::touchedRegs() const {
-    const int touch = OPERAND_MODIFIED[iclass];
-    vector<Register> ret;
-    if (touch == 0) return { REG_NONE };
-    else if (touch == 1) ret = { op1.regId() }; 
-    else if (touch == 2) ret = { op1.regId(), op2.regId() };
-    else switch(iclass) {
-    case INS_AAA:
-    case INS_AAD:
-    case INS_AAM:
-    case INS_AAS: ret = { REG_AL, REG_AH }; break;
-    case INS_CALL:
-    case INS_CALL_FAR:
-    case INS_INT: ret = { REG_AX, REG_BX, REG_CX, REG_DX, REG_SI, REG_DI, REG_FLAGS }; break;
-    case INS_CBW:
-    case INS_LAHF: ret = { REG_AH }; break;
-    case INS_CMPSB:
-    case INS_CMPSW:
-    case INS_MOVSB:
-    case INS_MOVSW: ret = { REG_SI, REG_DI }; break;
-    case INS_CWD: ret = { REG_DX }; break;
-    case INS_DAA:
-    case INS_DAS: ret = { REG_AL }; break;
-    case INS_DIV:
-    case INS_IDIV:
-        if (op1.size == OPRSZ_BYTE) return { REG_AL, REG_AH };
-        else return { REG_AX, REG_DX };
-        break;
+// Register effects of the instruction classes: the implicitly read and written registers, and whether the explicit 
+// operands are read or written. Flags count as a register, the instruction pointer is not included.
+enum OperandEffect : Byte {
+    EFF_NONE = 0,
+    EFF_R1 = 1 << 0, // first operand is read
+    EFF_W1 = 1 << 1, // first operand is written
+    EFF_R2 = 1 << 2, // second operand is read
+    EFF_W2 = 1 << 3, // second operand is written
+};
+
+struct RegisterEffectDesc {
+    RegisterMask read, write;
+    Byte operands;
+};
+
+static constexpr RegisterMask 
+    M_AL = regMask(REG_AL), M_AH = regMask(REG_AH), M_AX = regMask(REG_AX), M_BX = regMask(REG_BX), 
+    M_CX = regMask(REG_CX), M_DX = regMask(REG_DX), M_SI = regMask(REG_SI), M_DI = regMask(REG_DI), 
+    M_SP = regMask(REG_SP), M_BP = regMask(REG_BP), M_DS = regMask(REG_DS), M_ES = regMask(REG_ES), M_FL = regMask(REG_FLAGS),
+    // registers saved by pusha
+    M_PUSHA = M_AX | M_BX | M_CX | M_DX | M_SI | M_DI | M_SP | M_BP,
+    // registers which a called routine or an interrupt handler may change
+    M_CLOBBER = M_AX | M_BX | M_CX | M_DX | M_SI | M_DI | M_FL;
+
+static constexpr Byte EFF_RW1 = EFF_R1 | EFF_W1, EFF_ARITH = EFF_R1 | EFF_W1 | EFF_R2;
+
+static constexpr RegisterEffectDesc REGISTER_EFFECT[] = {
+    /* INS_ERR      */ { 0,                         0,                  EFF_NONE },
+    /* INS_ADD      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_PUSH     */ { M_SP,                      M_SP,               EFF_R1 },
+    /* INS_POP      */ { M_SP,                      M_SP,               EFF_W1 },
+    /* INS_OR       */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_ADC      */ { M_FL,                      M_FL,               EFF_ARITH },
+    /* INS_SBB      */ { M_FL,                      M_FL,               EFF_ARITH },
+    /* INS_AND      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_DAA      */ { M_AL | M_FL,               M_AL | M_FL,        EFF_NONE },
+    /* INS_SUB      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_DAS      */ { M_AL | M_FL,               M_AL | M_FL,        EFF_NONE },
+    /* INS_XOR      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_AAA      */ { M_AX | M_FL,               M_AX | M_FL,        EFF_NONE },
+    /* INS_CMP      */ { 0,                         M_FL,               EFF_R1 | EFF_R2 },
+    /* INS_AAS      */ { M_AX | M_FL,               M_AX | M_FL,        EFF_NONE },
+    /* INS_INC      */ { 0,                         M_FL,               EFF_RW1 },
+    /* INS_DEC      */ { 0,                         M_FL,               EFF_RW1 },
+    /* INS_JMP      */ { 0,                         0,                  EFF_R1 },
+    /* INS_JMP_IF   */ { M_FL,                      0,                  EFF_R1 },
+    /* INS_JMP_FAR  */ { 0,                         0,                  EFF_R1 },
+    /* INS_TEST     */ { 0,                         M_FL,               EFF_R1 | EFF_R2 },
+    /* INS_XCHG     */ { 0,                         0,                  EFF_RW1 | EFF_R2 | EFF_W2 },
+    /* INS_MOV      */ { 0,                         0,                  EFF_W1 | EFF_R2 },
+    /* INS_LEA      */ { 0,                         0,                  EFF_W1 },
+    /* INS_NOP      */ { 0,                         0,                  EFF_NONE },
+    /* INS_CBW      */ { M_AL,                      M_AH,               EFF_NONE },
+    /* INS_CWD      */ { M_AX,                      M_DX,               EFF_NONE },
+    /* INS_CALL     */ { M_SP,                      M_SP | M_CLOBBER,   EFF_R1 },
+    /* INS_CALL_FAR */ { M_SP,                      M_SP | M_CLOBBER,   EFF_R1 },
+    /* INS_WAIT     */ { 0,                         0,                  EFF_NONE },
+    /* INS_PUSHF    */ { M_SP | M_FL,               M_SP,               EFF_NONE },
+    /* INS_POPF     */ { M_SP,                      M_SP | M_FL,        EFF_NONE },
+    /* INS_SAHF     */ { M_AH,                      M_FL,               EFF_NONE },
+    /* INS_LAHF     */ { M_FL,                      M_AH,               EFF_NONE },
+    /* INS_MOVSB    */ { M_SI | M_DI | M_DS | M_ES | M_FL, M_SI | M_DI, EFF_NONE },
+    /* INS_MOVSW    */ { M_SI | M_DI | M_DS | M_ES | M_FL, M_SI | M_DI, EFF_NONE },
+    /* INS_CMPSB    */ { M_SI | M_DI | M_DS | M_ES | M_FL, M_SI | M_DI | M_FL, EFF_NONE },
+    /* INS_CMPSW    */ { M_SI | M_DI | M_DS | M_ES | M_FL, M_SI | M_DI | M_FL, EFF_NONE },
+    /* INS_STOSB    */ { M_AL | M_DI | M_ES | M_FL, M_DI,               EFF_NONE },
+    /* INS_STOSW    */ { M_AX | M_DI | M_ES | M_FL, M_DI,               EFF_NONE },
+    /* INS_LODSB    */ { M_SI | M_DS | M_FL,        M_AL | M_SI,        EFF_NONE },
+    /* INS_LODSW    */ { M_SI | M_DS | M_FL,        M_AX | M_SI,        EFF_NONE },
+    /* INS_SCASB    */ { M_AL | M_DI | M_ES | M_FL, M_DI | M_FL,        EFF_NONE },
+    /* INS_SCASW    */ { M_AX | M_DI | M_ES | M_FL, M_DI | M_FL,        EFF_NONE },
+    /* INS_RET      */ { M_SP,                      M_SP,               EFF_NONE },
+    /* INS_LES      */ { 0,                         M_ES,               EFF_W1 },
+    /* INS_LDS      */ { 0,                         M_DS,               EFF_W1 },
+    /* INS_RETF     */ { M_SP,                      M_SP,               EFF_NONE },
+    /* INS_INT      */ { M_SP | M_FL,               M_SP | M_CLOBBER,   EFF_NONE },
+    /* INS_INT3     */ { M_SP | M_FL,               M_SP | M_CLOBBER,   EFF_NONE },
+    /* INS_INTO     */ { M_SP | M_FL,               M_SP | M_CLOBBER,   EFF_NONE },
+    /* INS_IRET     */ { M_SP,                      M_SP | M_FL,        EFF_NONE },
+    /* INS_AAM      */ { M_AL,                      M_AX | M_FL,        EFF_NONE },
+    /* INS_AAD      */ { M_AX,                      M_AX | M_FL,        EFF_NONE },
+    /* INS_XLAT     */ { M_AL | M_BX | M_DS,        M_AL,               EFF_NONE },
+    /* INS_LOOPNZ   */ { M_CX | M_FL,               M_CX,               EFF_NONE },
+    /* INS_LOOPZ    */ { M_CX | M_FL,               M_CX,               EFF_NONE },
+    /* INS_LOOP     */ { M_CX,                      M_CX,               EFF_NONE },
+    /* INS_IN       */ { 0,                         0,                  EFF_W1 | EFF_R2 },
+    /* INS_OUT      */ { 0,                         0,                  EFF_R1 | EFF_R2 },
+    /* INS_LOCK     */ { 0,                         0,                  EFF_NONE },
+    /* INS_REPNZ    */ { 0,                         0,                  EFF_NONE },
+    /* INS_REPZ     */ { 0,                         0,                  EFF_NONE },
+    /* INS_HLT      */ { 0,                         0,                  EFF_NONE },
+    /* INS_CMC      */ { M_FL,                      M_FL,               EFF_NONE },
+    /* INS_CLC      */ { 0,                         M_FL,               EFF_NONE },
+    /* INS_STC      */ { 0,                         M_FL,               EFF_NONE },
+    /* INS_CLI      */ { 0,                         M_FL,               EFF_NONE },
+    /* INS_STI      */ { 0,                         M_FL,               EFF_NONE },
+    /* INS_CLD      */ { 0,                         M_FL,               EFF_NONE },
+    /* INS_STD      */ { 0,                         M_FL,               EFF_NONE },
+    /* INS_ROL      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_ROR      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_RCL      */ { M_FL,                      M_FL,               EFF_ARITH },
+    /* INS_RCR      */ { M_FL,                      M_FL,               EFF_ARITH },
+    /* INS_SHL      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_SHR      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_SAR      */ { 0,                         M_FL,               EFF_ARITH },
+    /* INS_NOT      */ { 0,                         0,                  EFF_RW1 },
+    /* INS_NEG      */ { 0,                         M_FL,               EFF_RW1 },
+    // the implicit registers of multiplication and division depend on the operand size, see registerEffect()
+    /* INS_MUL      */ { 0,                         M_FL,               EFF_R1 },
+    /* INS_IMUL     */ { 0,                         M_FL,               EFF_R1 },
+    /* INS_DIV      */ { 0,                         M_FL,               EFF_R1 },
+    /* INS_IDIV     */ { 0,                         M_FL,               EFF_R1 },
+    /* INS_PUSHA    */ { M_PUSHA,                   M_SP,               EFF_NONE },
+    /* INS_POPA     */ { M_SP,                      M_PUSHA,            EFF_NONE },
+    /* INS_BOUND    */ { 0,                         0,                  EFF_R1 | EFF_R2 },
+    /* INS_INSB     */ { M_DX | M_DI | M_ES | M_FL, M_DI,               EFF_NONE },
+    /* INS_INSW     */ { M_DX | M_DI | M_ES | M_FL, M_DI,               EFF_NONE },
+    /* INS_OUTSB    */ { M_DX | M_SI | M_DS | M_FL, M_SI,               EFF_NONE },
+    /* INS_OUTSW    */ { M_DX | M_SI | M_DS | M_FL, M_SI,               EFF_NONE },
+    /* INS_ENTER    */ { M_SP | M_BP,               M_SP | M_BP,        EFF_NONE },
+    /* INS_LEAVE    */ { M_BP,                      M_SP | M_BP,        EFF_NONE },
+};
+static_assert(ARRAY_SIZE(REGISTER_EFFECT) == ARRAY_SIZE(INS_CLASS_ID), "Register effect table does not cover all instruction classes");
+
+// registers used for computing the address of a memory operand
+static constexpr RegisterMask memOperandRegs(const OperandType type) {
+    switch (type) {
+    case OPR_MEM_BX_SI: case OPR_MEM_BX_SI_OFF8: case OPR_MEM_BX_SI_OFF16: return M_BX | M_SI;
+    case OPR_MEM_BX_DI: case OPR_MEM_BX_DI_OFF8: case OPR_MEM_BX_DI_OFF16: return M_BX | M_DI;
+    case OPR_MEM_BP_SI: case OPR_MEM_BP_SI_OFF8: case OPR_MEM_BP_SI_OFF16: return M_BP | M_SI;
+    case OPR_MEM_BP_DI: case OPR_MEM_BP_DI_OFF8: case OPR_MEM_BP_DI_OFF16: return M_BP | M_DI;
+    case OPR_MEM_SI: case OPR_MEM_SI_OFF8: case OPR_MEM_SI_OFF16: return M_SI;
+    case OPR_MEM_DI: case OPR_MEM_DI_OFF8: case OPR_MEM_DI_OFF16: return M_DI;
+    case OPR_MEM_BP_OFF8: case OPR_MEM_BP_OFF16: return M_BP;
+    case OPR_MEM_BX: case OPR_MEM_BX_OFF8: case OPR_MEM_BX_OFF16: return M_BX;
+    default: return 0;
+    }
+}
+
+RegisterEffect Instruction::registerEffect() const {
+    const RegisterEffectDesc &desc = REGISTER_EFFECT[iclass];
+    RegisterEffect ret{desc.read, desc.write};
+    // three-operand imul writes the product of the second operand and the immediate into the first
+    const Byte operands = hasImmediate3() ? EFF_W1 | EFF_R2 : desc.operands;
+    if (operands & EFF_R1) ret.read |= regMask(op1.regId());
+    if (operands & EFF_W1) ret.write |= regMask(op1.regId());
+    if (operands & EFF_R2) ret.read |= regMask(op2.regId());
+    if (operands & EFF_W2) ret.write |= regMask(op2.regId());
+    // a memory operand reads the registers of its address whether it is read or written itself
+    if (memOperand()) ret.read |= memOperandRegs(memOperand()->type) | regMask(memSegmentId());
+    switch (hasImmediate3() ? INS_ERR : iclass) {
     case INS_MUL:
     case INS_IMUL:
-        if (op1.size == OPRSZ_BYTE) return { REG_AX };
-        else return { REG_AX, REG_DX };
+        if (op1.size == OPRSZ_BYTE) { ret.read |= M_AL; ret.write |= M_AX; }
+        else { ret.read |= M_AX; ret.write |= M_AX | M_DX; }
         break;
-    case INS_LDS: ret = { op1.regId(), REG_DS }; break;
-    case INS_LES: ret = { op1.regId(), REG_ES }; break;
-    case INS_LODSB: ret = { REG_AL, REG_SI }; break;
-    case INS_LODSW: ret = { REG_AX, REG_SI }; break;
-    case INS_LOOP:
-    case INS_LOOPZ:
-    case INS_LOOPNZ: ret = { REG_CX }; break;
-    case INS_POP: ret = { op1.regId(), REG_SP }; break;
-    case INS_POPF: ret = { REG_FLAGS, REG_SP }; break;
-    case INS_PUSH:
-    case INS_PUSHF: ret = { REG_SP }; break;
-    case INS_RCL:
-    case INS_RCR: ret = { op1.regId(), REG_FLAGS }; break;
-    case INS_CMC:
-    case INS_CLC:
-    case INS_CLI:
-    case INS_STI:
-    case INS_STC:
-    case INS_CLD:
-    case INS_STD:
-    case INS_TEST:
-    case INS_SAHF: ret = { REG_FLAGS }; break;
-    case INS_SCASB: 
-    case INS_SCASW: ret = { REG_DI, REG_FLAGS }; break;
-    case INS_STOSW:
-    case INS_STOSB: ret = { REG_DI };
-    case INS_XLAT: ret = { REG_AL };
+    case INS_DIV:
+    case INS_IDIV:
+        if (op1.size == OPRSZ_BYTE) { ret.read |= M_AX; ret.write |= M_AX; }
+        else { ret.read |= M_AX | M_DX; ret.write |= M_AX | M_DX; }
         break;
     default:
-        throw CpuError("Unknown instruction class for touched reg: "s + INS_CLASS_ID[iclass]);
+        break;
+    }
+    if (prefix == PRF_CHAIN_REPNZ || prefix == PRF_CHAIN_REPZ) {
+        ret.read |= M_CX;
+        ret.write |= M_CX;
     }
-    if (prefix == PRF_CHAIN_REPNZ || prefix == PRF_CHAIN_REPZ) 
-        ret.push_back(REG_CX);
     return ret;
 }
 
@@ -478,7 +865,8 @@ static const char* INS_NAME[] = {
     "???", "add", "push", "pop", "or", "adc", "sbb", "and", "daa", "sub", "das", "xor", "aaa", "cmp", "aas", "inc", "dec", "jmp", "???", "jmp far", "test", "xchg", "mov", "lea", "nop", "cbw", "cwd",
     "call", "call far", "wait", "pushf", "popf", "sahf", "lahf", "movsb", "movsw", "cmpsb", "cmpsw", "stosb", "stosw", "lodsb", "lodsw", "scasb", "scasw", "ret", "les", "lds", "retf", "int",
     "int3", "into", "iret", "aam", "aad", "xlat", "loopnz", "loopz", "loop", "in", "out", "lock", "repnz", "repz", "hlt", "cmc", "clc", "stc", "cli", "sti", "cld", "std",
-    "rol", "ror", "rcl", "rcr", "shl", "shr", "sar", "not", "neg", "mul", "imul", "div", "idiv"
+    "rol", "ror", "rcl", "rcr", "shl", "shr", "sar", "not", "neg", "mul", "imul", "div", "idiv",
+    "pusha", "popa", "bound", "insb", "insw", "outsb", "outsw", "enter", "leave"
 };
 static_assert(ARRAY_SIZE(INS_NAME) == ARRAY_SIZE(INS_CLASS_ID));
 
@@ -501,29 +889,45 @@ static const char* PRF_NAME[] = {
 };
 
 std::string Instruction::Operand::toString() const {
-    ostringstream str;
+    std::string str;
+    format(str);
+    return str;
+}
+
+void Instruction::Operand::format(std::string &str) const {
     if (operandIsReg(type))
-        str << OPR_NAME[type];
-    else if (operandIsMemNoOffset(type))
-        str << "[" << OPR_NAME[type] << "]";
+        str += OPR_NAME[type];
+    else if (operandIsMemNoOffset(type)) {
+        str += '[';
+        str += OPR_NAME[type];
+        str += ']';
+    }
     else if (operandIsMemWithByteOffset(type)) {
-        if (type == OPR_MEM_OFF8) str << "[" << hexVal(immval.u8, true, false)  << "]";
-        else str << "[" << OPR_NAME[type] << signedHexVal(static_cast<SByte>(immval.u8)) << "]";
+        str += '[';
+        if (type == OPR_MEM_OFF8) appendHex(str, immval.u8, true, false);
+        else {
+            str += OPR_NAME[type];
+            appendSignedHex(str, static_cast<SByte>(immval.u8));
+        }
+        str += ']';
     }
     else if (operandIsMemWithWordOffset(type)) {
-        if (type == OPR_MEM_OFF16) str << "[" << hexVal(immval.u16, true, false) << "]";
-        else str << "[" << OPR_NAME[type] << signedHexVal(static_cast<SWord>(immval.u16)) << "]";
+        str += '[';
+        if (type == OPR_MEM_OFF16) appendHex(str, immval.u16, true, false);
+        else {
+            str += OPR_NAME[type];
+            appendSignedHex(str, static_cast<SWord>(immval.u16));
+        }
+        str += ']';
     }
     else if (type == OPR_IMM0 || type == OPR_IMM1)
-        str << OPR_NAME[type];
+        str += OPR_NAME[type];
     else if (type == OPR_IMM8)
-        str << hexVal(immval.u8, true, false);
+        appendHex(str, immval.u8, true, false);
     else if (type == OPR_IMM16)
-        str << hexVal(immval.u16, true, false);
+        appendHex(str, immval.u16, true, false);
     else if (type == OPR_IMM32)
-        str << hexVal(immval.u32, true, false);
-
-    return str.str();
+        appendHex(str, immval.u32, true, false);
 }
 
 InstructionMatch Instruction::Operand::match(const Operand &other) const {
@@ -553,10 +957,17 @@ InstructionMatch Instruction::Operand::match(const Operand &other) const {
 }
 
 std::string Instruction::toString(const bool extended) const {
-    ostringstream str;
+    std::string str;
+    format(str, extended);
+    return str;
+}
+
+void Instruction::format(std::string &str, const bool extended) const {
     // output chain prefix if present
-    if (prefix > PRF_SEG_DS)
-        str << PRF_NAME[prefix] << " ";
+    if (prefix > PRF_SEG_DS) {
+        str += PRF_NAME[prefix];
+        str += ' ';
+    }
     
     // output instruction name
     // conditional jumps, lookup specific jump name
@@ -564,57 +975,60 @@ std::string Instruction::toString(const bool extended) const {
         Byte idx = opcode - OP_JO_Jb;
         // jcxz special case
         if (idx >= JMP_NAME_COUNT) idx = JMP_NAME_COUNT - 1;
-        str << JMP_NAME[idx];
+        str += JMP_NAME[idx];
     }
     // otherwise just output name corresponding to instruction class
     else {
-        str << INS_NAME[iclass];
+        str += INS_NAME[iclass];
     }
     // special extra label for short jump opcode
-    if (opcode == OP_JMP_Jb) str << " short";
+    if (opcode == OP_JMP_Jb) str += " short";
 
     // output operands
     if (op1.type != OPR_NONE) {
-        str << " ";
+        str += ' ';
         // show size prefix if not implicit from operands
         if (operandIsMem(op1.type) && operandIsImmediate(op2.type)) {
             OperandSize immSize = op1.size;
             if (immSize == OPRSZ_UNK) immSize = op2.size;
             switch(immSize) {
-            case OPRSZ_BYTE:  str << "byte ";  break;
-            case OPRSZ_WORD:  str << "word ";  break;
-            case OPRSZ_DWORD: str << "dword "; break;
+            case OPRSZ_BYTE:  str += "byte ";  break;
+            case OPRSZ_WORD:  str += "word ";  break;
+            case OPRSZ_DWORD: str += "dword "; break;
             default:
                 throw CpuError("unexpected immediate operand size: "s + OPR_SIZE_ID[immSize]);
             }
         }
         // segment override prefix if present
         if (prefix > PRF_NONE && prefix < PRF_CHAIN_REPNZ && operandIsMem(op1.type))
-            str << PRF_NAME[prefix];
+            str += PRF_NAME[prefix];
         // for near branch instructions (call, jump, loop), the immediate relative offset operand is added to the address 
         // of the byte past the current instruction to form an absolute offset
         if (isNearBranch() && operandIsImmediate(op1.type)) {
-            const Word aoff = absoluteOffset();
-            str << hexVal(aoff, true, false);
+            appendHex(str, absoluteOffset(), true, false);
             if (extended) {
                 SWord roff = relativeOffset();
-                if (roff < 0) { roff = -roff; str << " (" << hexVal(roff, true, false) << " up)"; }
-                else str << " (" << hexVal(roff, true, false) << " down)";
+                str += " (";
+                if (roff < 0) { roff = -roff; appendHex(str, roff, true, false); str += " up)"; }
+                else { appendHex(str, roff, true, false); str += " down)"; }
             }
         }
         else {
-            str << op1.toString();
+            op1.format(str);
         }
     }
     if (op2.type != OPR_NONE) {
-        str << ", ";
+        str += ", ";
         // segment override prefix if present
         if (prefix > PRF_NONE && prefix < PRF_CHAIN_REPNZ && operandIsMem(op2.type))
-            str << PRF_NAME[prefix];
-        str << op2.toString();
+            str += PRF_NAME[prefix];
+        op2.format(str);
+    }
+    if (hasImmediate3()) {
+        str += ", ";
+        if (opcode == OP_IMUL_Gv_Ev_Ib) appendHex(str, static_cast<Byte>(immediate3()), true, false);
+        else appendHex(str, immediate3(), true, false);
     }
-
-    return str.str();
 }
 
 InstructionMatch Instruction::match(const Instruction &other) const {
@@ -625,9 +1039,12 @@ InstructionMatch Instruction::match(const Instruction &other) const {
         return INS_MATCH_MISMATCH;
 
     // this can only return FULL (everything matches), DIFF (operand type match, different value) or MISMATCH (operand type different)
-    const InstructionMatch 
+    InstructionMatch 
         op1match = op1.match(other.op1), 
         op2match = op2.match(other.op2);
+    // the immediate of a three-operand imul is counted towards its destination operand
+    if (op1match == INS_MATCH_FULL && hasImmediate3() && immediate3() != other.immediate3())
+        op1match = INS_MATCH_DIFF;
 
     if (op1match == INS_MATCH_MISMATCH || op2match == INS_MATCH_MISMATCH)
         return INS_MATCH_MISMATCH; // either operand mismatch -> instruction mismatch
@@ -641,37 +1058,58 @@ InstructionMatch Instruction::match(const Instruction &other) const {
     return INS_MATCH_FULL;
 }
 
+// The fields which match() looks at, packed losslessly into a key. Operands which match across their byte and word 
+// forms are normalized to the word form, and the opcode only distinguishes the conditional jumps.
+uint64_t Instruction::fingerprintKey() const {
+    return static_cast<uint64_t>(prefix) 
+        | static_cast<uint64_t>(iclass) << 8 
+        | static_cast<uint64_t>(iclass == INS_JMP_IF ? opcode : 0) << 16
+        | static_cast<uint64_t>(operandTypeToWord(op1.type)) << 24 
+        | static_cast<uint64_t>(operandTypeToWord(op2.type)) << 32;
+}
+
+DWord Instruction::valueFingerprint() const {
+    auto value = [](const Operand &op) -> uint64_t {
+        if (operandIsMemWithByteOffset(op.type) || op.type == OPR_IMM8) return op.immval.u8;
+        else if (operandIsMemWithWordOffset(op.type) || op.type == OPR_IMM16) return op.immval.u16;
+        else if (op.type == OPR_IMM32) return op.immval.u32;
+        return 0;
+    };
+    const uint64_t imm3 = hasImmediate3() ? immediate3() : 0;
+    return fingerprintMix(mix64(fingerprintKey()) ^ (value(op1) | value(op2) << 32 | imm3 << 48));
+}
+
 // lookup table for converting modrm mod and mem values into OperandType
-static const OperandType MODRM_BYTE_MEM_OP[4][8] = {
+static constexpr OperandType MODRM_BYTE_MEM_OP[4][8] = {
     OPR_MEM_BX_SI,       OPR_MEM_BX_DI,       OPR_MEM_BP_SI,       OPR_MEM_BP_DI,       OPR_MEM_SI,       OPR_MEM_DI,       OPR_MEM_OFF16,    OPR_MEM_BX,       // mod 00 (no displacement)
     OPR_MEM_BX_SI_OFF8,  OPR_MEM_BX_DI_OFF8,  OPR_MEM_BP_SI_OFF8,  OPR_MEM_BP_DI_OFF8,  OPR_MEM_SI_OFF8,  OPR_MEM_DI_OFF8,  OPR_MEM_BP_OFF8,  OPR_MEM_BX_OFF8,  // mod 01 (8bit displacement)
     OPR_MEM_BX_SI_OFF16, OPR_MEM_BX_DI_OFF16, OPR_MEM_BP_SI_OFF16, OPR_MEM_BP_DI_OFF16, OPR_MEM_SI_OFF16, OPR_MEM_DI_OFF16, OPR_MEM_BP_OFF16, OPR_MEM_BX_OFF16, // mod 10 (16bit displacement)
     OPR_REG_AL,          OPR_REG_CL,          OPR_REG_DL,          OPR_REG_BL,          OPR_REG_AH,       OPR_REG_CH,       OPR_REG_DH,       OPR_REG_BH,       // mod 11 (register)
 };
 
-static const OperandType MODRM_WORD_MEM_OP[4][8] = {
+static constexpr OperandType MODRM_WORD_MEM_OP[4][8] = {
     OPR_MEM_BX_SI,       OPR_MEM_BX_DI,       OPR_MEM_BP_SI,       OPR_MEM_BP_DI,       OPR_MEM_SI,       OPR_MEM_DI,       OPR_MEM_OFF16,    OPR_MEM_BX,       // mod 00 (no displacement)
     OPR_MEM_BX_SI_OFF8,  OPR_MEM_BX_DI_OFF8,  OPR_MEM_BP_SI_OFF8,  OPR_MEM_BP_DI_OFF8,  OPR_MEM_SI_OFF8,  OPR_MEM_DI_OFF8,  OPR_MEM_BP_OFF8,  OPR_MEM_BX_OFF8,  // mod 01 (8bit displacement)
     OPR_MEM_BX_SI_OFF16, OPR_MEM_BX_DI_OFF16, OPR_MEM_BP_SI_OFF16, OPR_MEM_BP_DI_OFF16, OPR_MEM_SI_OFF16, OPR_MEM_DI_OFF16, OPR_MEM_BP_OFF16, OPR_MEM_BX_OFF16, // mod 10 (16bit displacement)
     OPR_REG_AX,          OPR_REG_CX,          OPR_REG_DX,          OPR_REG_BX,          OPR_REG_SP,       OPR_REG_BP,       OPR_REG_SI,       OPR_REG_DI,       // mod 11 (register)
 };
 
-static const OperandType MODRM_MEM_OP[4][8] = {
+static constexpr OperandType MODRM_MEM_OP[4][8] = {
     OPR_MEM_BX_SI,       OPR_MEM_BX_DI,       OPR_MEM_BP_SI,       OPR_MEM_BP_DI,       OPR_MEM_SI,       OPR_MEM_DI,       OPR_MEM_OFF16,    OPR_MEM_BX,       // mod 00 (no displacement)
     OPR_MEM_BX_SI_OFF8,  OPR_MEM_BX_DI_OFF8,  OPR_MEM_BP_SI_OFF8,  OPR_MEM_BP_DI_OFF8,  OPR_MEM_SI_OFF8,  OPR_MEM_DI_OFF8,  OPR_MEM_BP_OFF8,  OPR_MEM_BX_OFF8,  // mod 01 (8bit displacement)
     OPR_MEM_BX_SI_OFF16, OPR_MEM_BX_DI_OFF16, OPR_MEM_BP_SI_OFF16, OPR_MEM_BP_DI_OFF16, OPR_MEM_SI_OFF16, OPR_MEM_DI_OFF16, OPR_MEM_BP_OFF16, OPR_MEM_BX_OFF16, // mod 10 (16bit displacement)
     OPR_ERR,             OPR_ERR,             OPR_ERR,             OPR_ERR,             OPR_ERR,          OPR_ERR,          OPR_ERR,          OPR_ERR,          // mod 11 (register)
 };
 
-static const OperandType MODRM_BYTE_REG_OP[8] = {
+static constexpr OperandType MODRM_BYTE_REG_OP[8] = {
     OPR_REG_AL, OPR_REG_CL, OPR_REG_DL, OPR_REG_BL, OPR_REG_AH, OPR_REG_CH, OPR_REG_DH, OPR_REG_BH,
 };
 
-static const OperandType MODRM_WORD_REG_OP[8] = {
+static constexpr OperandType MODRM_WORD_REG_OP[8] = {
     OPR_REG_AX, OPR_REG_CX, OPR_REG_DX, OPR_REG_BX, OPR_REG_SP, OPR_REG_BP, OPR_REG_SI, OPR_REG_DI,
 };
 
-static const OperandType MODRM_SEGREG_OP[8] = {
+static constexpr OperandType MODRM_SEGREG_OP[8] = {
     OPR_REG_ES, OPR_REG_CS, OPR_REG_SS, OPR_REG_DS, OPR_ERR, OPR_ERR, OPR_ERR, OPR_ERR,
 };
 
@@ -721,7 +1159,7 @@ Size Instruction::loadImmediate(Operand &op, const Byte *data) {
         size = sizeof(Byte);
         memcpy(&byteVal, data, size);
         op.immval.u8 = byteVal;
-        DEBUG("8bit operand, value = "s + hexVal(op.immval.u8) + ", instruction length = " + to_string(length + size));
+        DEBUG("8bit operand, value = ", hexArg(op.immval.u8), ", instruction length = ", length + size);
         break;
     case OPR_MEM_OFF16:
     case OPR_MEM_BX_SI_OFF16:
@@ -736,7 +1174,7 @@ Size Instruction::loadImmediate(Operand &op, const Byte *data) {
         size = sizeof(Word);
         memcpy(&wordVal, data, size);
         op.immval.u16 = wordVal;
-        DEBUG("16bit operand, value = "s + hexVal(op.immval.u16) + ", instruction length = " + to_string(length + size));
+        DEBUG("16bit operand, value = ", hexArg(op.immval.u16), ", instruction length = ", length + size);
         break;    
     case OPR_IMM0:
         op.immval.u32 = 0;
@@ -750,7 +1188,7 @@ Size Instruction::loadImmediate(Operand &op, const Byte *data) {
         size = sizeof(DWord);
         memcpy(&dwordVal, data, size);
         op.immval.u32 = dwordVal;
-        DEBUG("32bit immediate = "s + hexVal(op.immval.u32) + ", instruction length = " + to_string(length + size));
+        DEBUG("32bit immediate = ", hexArg(op.immval.u32), ", instruction length = ", length + size);
         break;
     default:
         // register and memory operands with no displacement 
@@ -790,9 +1228,132 @@ Register prefixRegId(const InstructionPrefix p) {
 }
 
 InstructionClass instr_class(const Byte opcode) {
-    return OPCODE_CLASS[opcode];
+    return static_cast<InstructionClass>(opcodeDesc(opcode).iclass);
 }
 
 const char* instr_class_name(const InstructionClass iclass) {
     return INS_CLASS_ID[iclass];
-}
\ No newline at end of file
+}
+
+const char* instr_status_name(const InstructionStatus status) {
+    return INS_STATUS_ID[status];
+}
+
+static constexpr bool modrmIsMem(const ModrmOperand mo) {
+    return mo == MODRM_Eb || mo == MODRM_Ev || mo == MODRM_M || mo == MODRM_Mp;
+}
+
+static constexpr Byte displacementSize(const OperandType ot) {
+    switch (ot) {
+    case OPR_MEM_BX_SI_OFF8:
+    case OPR_MEM_BX_DI_OFF8:
+    case OPR_MEM_BP_SI_OFF8:
+    case OPR_MEM_BP_DI_OFF8:
+    case OPR_MEM_SI_OFF8:
+    case OPR_MEM_DI_OFF8:
+    case OPR_MEM_BP_OFF8:
+    case OPR_MEM_BX_OFF8:    return sizeof(Byte);
+    case OPR_MEM_OFF16:
+    case OPR_MEM_BX_SI_OFF16:
+    case OPR_MEM_BX_DI_OFF16:
+    case OPR_MEM_BP_SI_OFF16:
+    case OPR_MEM_BP_DI_OFF16:
+    case OPR_MEM_SI_OFF16:
+    case OPR_MEM_DI_OFF16:
+    case OPR_MEM_BP_OFF16:
+    case OPR_MEM_BX_OFF16:   return sizeof(Word);
+    default:                 return 0;
+    }
+}
+
+// Length of an instruction without prefix by its opcode and the following byte, following the same steps as Instruction::load()
+static constexpr Byte opcodeLength(const OpcodeTable &table, const Byte opcode, const Byte modrm) {
+    const OpcodeDesc &d = table.desc[opcode];
+    if (!d.modrm) return d.iclass != INS_ERR && d.op1 != OPR_ERR && d.op2 != OPR_ERR ? 1 + d.immSize : 0;
+    const Byte 
+        modVal = modrm_mod(modrm) >> MODRM_MOD_SHIFT,
+        regVal = modrm_reg(modrm) >> MODRM_REG_SHIFT,
+        mem = modrm_mem(modrm);
+    ModrmOperand modop1 = static_cast<ModrmOperand>(d.modop1), modop2 = static_cast<ModrmOperand>(d.modop2);
+    if (d.isGroup) {
+        const InstructionClass iclass = GRP_INS_CLASS[d.group][regVal];
+        if (iclass == INS_ERR) return 0;
+        if (iclass == INS_TEST) modop2 = d.group == IGRP_3a ? MODRM_Ib : MODRM_Iv;
+        else if (iclass == INS_CALL_FAR || iclass == INS_JMP_FAR) modop1 = MODRM_Mp;
+    }
+    if ((modop1 == MODRM_Sw || modop2 == MODRM_Sw) && MODRM_SEGREG_OP[regVal] == OPR_ERR) return 0;
+    const bool memOnly = modop1 == MODRM_M || modop1 == MODRM_Mp || modop2 == MODRM_M || modop2 == MODRM_Mp;
+    if (memOnly && MODRM_MEM_OP[modVal][mem] == OPR_ERR) return 0;
+    Byte length = 2 + immediateSize(modop1) + immediateSize(modop2) + d.imm3;
+    if (modrmIsMem(modop1) || modrmIsMem(modop2)) length += displacementSize(MODRM_MEM_OP[modVal][mem]);
+    return length;
+}
+
+// Precomputed lengths for the length-only decoder, which reduce it to two lookups with no branches. 
+// The second table covers every opcode with every value of the following byte, so it takes 64k.
+struct LengthTable {
+    Byte prefix[0x100];           // 1 for the chain and segment override prefixes
+    Byte length[0x100][0x100];    // by opcode and the following byte, 0 if the sequence does not decode
+    constexpr LengthTable(const OpcodeTable &table);
+};
+
+constexpr LengthTable::LengthTable(const OpcodeTable &table) : prefix(), length() {
+    for (int op = 0; op < 0x100; ++op) {
+        prefix[op] = op == OP_REPZ || op == OP_REPNZ || table.desc[op].segPrefix;
+        for (int next = 0; next < 0x100; ++next) length[op][next] = opcodeLength(table, op, next);
+    }
+}
+
+static constexpr LengthTable LENGTH_TABLE{OPCODE_TABLE}, LENGTH_TABLE_80186{OPCODE_TABLE_80186};
+static const LengthTable* const LENGTH_TABLES[CPU_LEVEL_COUNT] = { &LENGTH_TABLE, &LENGTH_TABLE_80186, &LENGTH_TABLE_80186 };
+
+// both the plain and the prefixed interpretation are looked up, so that the lookups do not wait on each other
+static inline Byte prefixedLength(const Byte prefix, const Byte plain, const Byte afterPrefix) {
+    return prefix ? (afterPrefix ? afterPrefix + 1 : 0) : plain;
+}
+
+Byte instructionLength(const Byte *data, const CpuLevel cpu) {
+    // same as the decoder, only one prefix is recognized and the byte after it is taken as the opcode whatever it is
+    const LengthTable &lt = *LENGTH_TABLES[cpu];
+    return prefixedLength(lt.prefix[data[0]], lt.length[data[0]][data[1]], lt.length[data[1]][data[2]]);
+}
+
+Size instructionBoundaries(const Byte *data, const Size size, vector<Byte> &bitmap, const CpuLevel cpu) {
+    const LengthTable &lt = *LENGTH_TABLES[cpu];
+    static constexpr Size CHUNK_SIZE = 4096;
+    bitmap.assign((size + 7) / 8, 0);
+    const Size bulkSize = size > INSTRUCTION_MAX ? size - INSTRUCTION_MAX : 0;
+    Byte length[CHUNK_SIZE + 1];
+    Size count = 0, pos = 0;
+    // The bulk of the buffer is processed in chunks, first the lengths are looked up for every offset in the chunk,
+    // which are independent of each other and pipeline well. Following the chain of instructions through the chunk
+    // then only takes a single load per instruction, and does not branch on the decoded bytes.
+    for (Size chunk = 0; chunk < bulkSize; chunk += CHUNK_SIZE) {
+        const Byte *d = data + chunk;
+        const Size chunkSize = min(CHUNK_SIZE, bulkSize - chunk);
+        for (Size i = 0; i <= chunkSize; ++i) length[i] = lt.length[d[i]][d[i + 1]];
+        for (Size i = 0; i < chunkSize; ++i) length[i] = prefixedLength(lt.prefix[d[i]], length[i], length[i + 1]);
+        while (pos < chunk + chunkSize) {
+            const Byte l = length[pos - chunk];
+            const bool valid = l != 0;
+            bitmap[pos >> 3] |= valid << (pos & 7);
+            count += valid;
+            pos += valid ? l : 1;
+        }
+    }
+    // near the end, decode from a zero-padded copy to avoid reading past the buffer and drop a truncated instruction
+    while (pos < size) {
+        Byte tail[INSTRUCTION_PEEK] = {};
+        memcpy(tail, data + pos, min(size - pos, INSTRUCTION_PEEK));
+        const Byte l = instructionLength(tail, cpu);
+        if (l == 0) { 
+            pos++; 
+            continue; 
+        }
+        if (pos + l > size) break;
+        bitmap[pos >> 3] |= 1 << (pos & 7);
+        count++;
+        pos += l;
+    }
+    return count;
+}
@@ -0,0 +1,110 @@
+#include "dos/json.h"
+#include "dos/sink.h"
+#include "dos/format.h"
+
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+
+JsonWriter& JsonWriter::begin(const char *type) {
+    buf_.clear();
+    buf_ += "{\"type\":";
+    string_(type);
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char *key, const char *val) {
+    key_(key);
+    string_(val);
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char *key, const std::string &val) {
+    return field(key, val.c_str());
+}
+
+JsonWriter& JsonWriter::field(const char *key, const bool val) {
+    key_(key);
+    buf_ += val ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char *key, const Size val) {
+    char num[HEX_STRMAX];
+    key_(key);
+    buf_.append(num, snprintf(num, sizeof(num), "%zu", val));
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char *key, const SOffset val) {
+    char num[HEX_STRMAX];
+    key_(key);
+    buf_.append(num, snprintf(num, sizeof(num), "%lld", static_cast<long long>(val)));
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char *key, const double val) {
+    char num[DBL_MAX_10_EXP + 8]; // sign, every integer digit, point and decimals
+    key_(key);
+    // JSON has no representation for infinity or NaN
+    if (!std::isfinite(val)) {
+        buf_ += "null";
+        return *this;
+    }
+    buf_.append(num, snprintf(num, sizeof(num), "%.3f", val));
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char *key, const Address &val) {
+    key_(key);
+    if (!val.isValid()) {
+        buf_ += "null";
+        return *this;
+    }
+    buf_ += '"';
+    appendAddress(buf_, val, true);
+    buf_ += '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::bytes(const char *key, const Byte *data, const Size size) {
+    key_(key);
+    buf_ += '"';
+    for (Size i = 0; i < size; ++i) appendHex(buf_, data[i], false, true);
+    buf_ += '"';
+    return *this;
+}
+
+void JsonWriter::end() {
+    buf_ += '}';
+    sink_.write(buf_, true);
+    count_++;
+}
+
+void JsonWriter::key_(const char *key) {
+    buf_ += ",\"";
+    buf_ += key;
+    buf_ += "\":";
+}
+
+void JsonWriter::string_(const char *str) {
+    static const char HEX[] = "0123456789abcdef";
+    buf_ += '"';
+    for (; *str; ++str) {
+        const unsigned char c = *str;
+        switch (c) {
+        case '"':  buf_ += "\\\""; break;
+        case '\\': buf_ += "\\\\"; break;
+        case '\n': buf_ += "\\n"; break;
+        case '\t': buf_ += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                buf_ += "\\u00";
+                buf_ += HEX[c >> 4];
+                buf_ += HEX[c & 0xf];
+            }
+            else buf_ += c;
+        }
+    }
+    buf_ += '"';
+}
@@ -2,28 +2,186 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 
 #include "dos/memory.h"
 #include "dos/error.h"
 #include "dos/mz.h"
 #include "dos/util.h"
+#include "dos/format.h"
+#include "dos/sink.h"
 
 using namespace std;
 
-Memory::Memory() : break_(INIT_BREAK) {
-    const Byte pattern[] = { 0xde, 0xad, 0xbe, 0xef };
-    
-    for (Offset i = 0, j = 0; i < MEM_TOTAL; ++i) {
-        // initialize memory data with initial pattern
-        data_[i] = pattern[j];
-        if (++j >= sizeof pattern) j = 0;
-    }
+// the memory content before anything is written to it
+const Byte* Memory::patternPage() {
+    struct PatternPage {
+        Byte data[Memory::MEM_PAGE_SIZE];
+        PatternPage() {
+            const Byte pattern[] = { 0xde, 0xad, 0xbe, 0xef };
+            for (Offset i = 0; i < sizeof data; ++i) data[i] = pattern[i % sizeof pattern];
+        }
+    };
+    static const PatternPage page;
+    return page.data;
+}
+
+bool CheckedAccess::valid(const Memory&, const Offset addr, const bool write) {
+    if (addr >= MEM_TOTAL) throw MemoryError((write ? "Write to "s : "Read from "s) + "address outside memory bounds: " + hexVal(addr));
+    return true;
+}
+
+bool FaultAccess::valid(const Memory &mem, const Offset addr, const bool write) {
+    if (addr < MEM_TOTAL) return true;
+    if (mem.fault_) mem.fault_(addr, write);
+    return false;
+}
+
+// every new flat buffer gets a different generation
+static Size nextFlatGeneration() {
+    static atomic<Size> generation{0};
+    return ++generation;
+}
+
+Memory::Memory() : flatBegin_(0), flatSize_(0), flatGeneration_(0), map_(), break_(INIT_BREAK) {
 }
 
 Memory::Memory(const Word segment, const Byte *data, const Size size) : Memory() {
+    // a paragraph of slack past the data, so peeking at the bytes following the last instruction stays in the flat range
+    mapFlat(SEG_TO_OFFSET(segment), size + PARAGRAPH_SIZE);
     writeBuf(SEG_TO_OFFSET(segment), data, size);
 }
 
+Memory::Memory(const MzImage &mz) : Memory() {
+    const Offset addr = SEG_TO_OFFSET(mz.loadSegment());
+    mapFlat(addr, mz.loadModuleSize() + PARAGRAPH_SIZE);
+    writeImage(addr, mz);
+}
+
+AccessMap::AccessMap() {
+    for (auto &b : bits_) b.assign(MEM_TOTAL / 8, 0);
+}
+
+void AccessMap::mark(const Offset addr, const Size size, const AccessType type) {
+    for (Offset a = addr; a < addr + size; ++a) mark(Memory::wrap(a), type);
+}
+
+vector<Block> AccessMap::blocks(const AccessType type, const Block &range) const {
+    vector<Block> ret;
+    const Offset end = min(range.end.toLinear() + 1, MEM_TOTAL);
+    Offset a = range.begin.toLinear();
+    while (a < end) {
+        // skip over empty bytes of the bitmap at once
+        if ((a & 7) == 0 && bits_[type][a >> 3] == 0) { a += 8; continue; }
+        if (!test(a, type)) { a++; continue; }
+        const Offset begin = a;
+        while (a < end && test(a, type)) a++;
+        ret.emplace_back(begin, a - 1);
+    }
+    return ret;
+}
+
+vector<Block> AccessMap::dataBlocks(const Block &range) const {
+    vector<Block> ret;
+    const Offset end = min(range.end.toLinear() + 1, MEM_TOTAL);
+    auto isData = [this](const Offset a) { return (test(a, ACCESS_READ) || test(a, ACCESS_WRITE)) && !test(a, ACCESS_EXEC); };
+    for (Offset a = range.begin.toLinear(); a < end; ) {
+        if (!isData(a)) { a++; continue; }
+        const Offset begin = a;
+        while (a < end && isData(a)) a++;
+        ret.emplace_back(begin, a - 1);
+    }
+    return ret;
+}
+
+void AccessMap::clear() {
+    for (auto &b : bits_) fill(b.begin(), b.end(), 0);
+}
+
+void Memory::enableAccessMap() {
+    if (!access_) access_ = make_shared<AccessMap>();
+}
+
+Size Memory::pageCount() const {
+    Size count = 0;
+    for (const Byte *p : map_) if (p) count++;
+    return count;
+}
+
+Size Memory::privatePageCount() const {
+    Size count = 0;
+    for (Size p = 0; p < MEM_PAGE_COUNT; ++p) {
+        if (pages_[p]) count += pages_[p].use_count() == 1;
+        else if (map_[p]) count += flat_.use_count() == 1;
+    }
+    return count;
+}
+
+Memory::Buffer Memory::allocBuffer(const Size size) {
+    return Buffer{new Byte[size], default_delete<Byte[]>()};
+}
+
+// the data of the page containing the address for writing, allocated on first use and copied if shared
+Byte* Memory::page(const Offset addr) {
+    const Size p = pageNumber(addr);
+    if (!map_[p]) {
+        pages_[p] = allocBuffer(MEM_PAGE_SIZE);
+        memcpy(pages_[p].get(), patternPage(), MEM_PAGE_SIZE);
+        map_[p] = pages_[p].get();
+    }
+    else if (pages_[p] && pages_[p].use_count() > 1) {
+        Buffer copy = allocBuffer(MEM_PAGE_SIZE);
+        memcpy(copy.get(), pages_[p].get(), MEM_PAGE_SIZE);
+        pages_[p] = move(copy);
+        map_[p] = pages_[p].get();
+    }
+    else if (!pages_[p] && flat_.use_count() > 1) {
+        unshareFlat();
+    }
+    return map_[p];
+}
+
+// take a private copy of the flat buffer before writing to it
+void Memory::unshareFlat() {
+    Buffer copy = allocBuffer(flatSize_);
+    memcpy(copy.get(), flat_.get(), flatSize_);
+    for (Size p = pageNumber(flatBegin_), last = pageNumber(flatBegin_ + flatSize_ - 1); p <= last; ++p) 
+        map_[p] = copy.get() + (map_[p] - flat_.get());
+    flat_ = move(copy);
+    flatGeneration_ = nextFlatGeneration();
+}
+
+void Memory::mapFlat(const Offset addr, const Size size) {
+    if (size == 0) return;
+    if (addr >= MEM_TOTAL) throw MemoryError("Flat range outside memory bounds: "s + hexVal(addr));
+    Size first = pageNumber(addr), last = pageNumber(min(addr + size, MEM_TOTAL) - 1);
+    if (flatSize_) {
+        const Size flatFirst = pageNumber(flatBegin_), flatLast = pageNumber(flatBegin_ + flatSize_ - 1);
+        if (first >= flatFirst && last <= flatLast) return;
+        // only one flat range is kept, grow it to also cover the pages in between
+        first = min(first, flatFirst);
+        last = max(last, flatLast);
+    }
+    const Size newSize = (last - first + 1) * MEM_PAGE_SIZE;
+    Buffer flat = allocBuffer(newSize);
+    for (Size p = first; p <= last; ++p) {
+        Byte *dest = flat.get() + (p - first) * MEM_PAGE_SIZE;
+        memcpy(dest, map_[p] ? map_[p] : patternPage(), MEM_PAGE_SIZE);
+        pages_[p].reset();
+        map_[p] = dest;
+    }
+    flat_ = move(flat);
+    flatBegin_ = first * MEM_PAGE_SIZE;
+    flatSize_ = newSize;
+    flatGeneration_ = nextFlatGeneration();
+}
+
+void Memory::pointerError(const Offset addr) const {
+    throw MemoryError("Pointer to address outside of flat memory range: "s + hexVal(addr));
+}
+
 void Memory::allocBlock(const Size para) {
     const Size size = para * PARAGRAPH_SIZE;
     if (break_ + size <= MEM_END)
@@ -40,44 +198,151 @@ void Memory::freeBlock(const Size para) {
         throw MemoryError("No room to free "s + to_string(size) + ", avail = "s + to_string(availableBytes()));
 }
 
-Byte Memory::readByte(const Offset addr) const {
-    if (addr >= MEM_TOTAL) throw MemoryError(std::string("Read byte outside memory bounds"));
-    return data_[addr];
-}
-
-Word Memory::readWord(const Offset addr) const {
-    if (addr >= MEM_TOTAL) throw MemoryError(std::string("Read word outside memory bounds"));
-    Word ret;
-    memcpy(&ret, &data_[addr], sizeof(ret));
-    return ret;
-}
-
-void Memory::writeByte(const Offset addr, const Byte value) {
-    if (addr >= MEM_TOTAL) throw MemoryError(std::string("Byte write outside memory bounds"));
-    data_[addr] = value;
+void Memory::readBuf(const Offset addr, Byte *data, const Size size) const {
+    if (addr + size > MEM_TOTAL) throw MemoryError(std::string("Buffer read outside memory bounds"));
+    for (Offset pos = addr, end = addr + size; pos < end; ) {
+        const Size chunk = min(end - pos, MEM_PAGE_SIZE - pageOffset(pos));
+        const Byte *p = map_[pageNumber(pos)];
+        memcpy(data, (p ? p : patternPage()) + pageOffset(pos), chunk);
+        data += chunk;
+        pos += chunk;
+    }
 }
 
-void Memory::writeWord(const Offset addr, const Word value) {
-    if (addr >= MEM_TOTAL) throw MemoryError(std::string("Word write outside memory bounds"));
-    memcpy(&data_[addr], &value, sizeof(value));
+void Memory::writeWordAt(const Offset lo, const Offset hi, const Word value) {
+    if (hi == lo + 1 && pageOffset(lo) != MEM_PAGE_SIZE - 1) {
+        memcpy(page(lo) + pageOffset(lo), &value, sizeof(value));
+        return;
+    }
+    page(lo)[pageOffset(lo)] = lowByte(value);
+    page(hi)[pageOffset(hi)] = hiByte(value);
 }
 
 void Memory::writeBuf(const Offset addr, const Byte *data, const Size size) {
     if (addr + size > MEM_TOTAL) throw MemoryError(std::string("Buffer write outside memory bounds"));
-    copy(data, data + size, begin(data_) + addr);
+    for (Offset pos = addr, end = addr + size; pos < end; ) {
+        const Size chunk = min(end - pos, MEM_PAGE_SIZE - pageOffset(pos));
+        memcpy(page(pos) + pageOffset(pos), data, chunk);
+        data += chunk;
+        pos += chunk;
+    }
+}
+
+void Memory::writeImage(const Offset addr, const MzImage &mz) {
+    writeBuf(addr, mz.loadModuleData(), mz.loadModuleSize());
+    for (const auto &p : mz.relocationPatches()) writeWord(addr + p.offset, p.value);
 }
 
 string Memory::info() const {
     ostringstream infoStr;
-    infoStr << "total size = " << MEM_TOTAL << " / " << MEM_TOTAL / KB << " kB @" << hexVal(reinterpret_cast<Offset>(base())) << ", "
+    infoStr << "total size = " << MEM_TOTAL << " / " << MEM_TOTAL / KB << " kB, allocated = " << pageCount() * MEM_PAGE_SIZE / KB << " kB, "
             << "available = " << availableBytes() << " / " << availableBytes() / KB << " kB";
     return infoStr.str();
 }
 
+// The comparisons skip over equal bytes with memcmp() in 64-byte chunks, which the C library implements with vector
+// instructions, and go through runs of differing bytes 8 bytes at a time.
+static Size equalLength(const Byte *a, const Byte *b, const Size size) {
+    const Size chunk = 64;
+    Size pos = 0;
+    while (pos + chunk <= size && memcmp(a + pos, b + pos, chunk) == 0) pos += chunk;
+    while (pos < size && a[pos] == b[pos]) pos++;
+    return pos;
+}
+
+static Size differentLength(const Byte *a, const Byte *b, const Size size) {
+    Size pos = 0;
+    for (uint64_t wa, wb; pos + sizeof(wa) <= size; pos += sizeof(wa)) {
+        memcpy(&wa, a + pos, sizeof(wa));
+        memcpy(&wb, b + pos, sizeof(wb));
+        // stop at a word with an equal byte, which is a zero byte in the xor of the words
+        const uint64_t x = wa ^ wb;
+        if ((x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull) break;
+    }
+    while (pos < size && a[pos] != b[pos]) pos++;
+    return pos;
+}
+
+// append the differing ranges of the buffers at the address, joining a range with one ending right before it
+static void diffRuns(const Byte *a, const Byte *b, const Size size, const Offset addr, vector<Block> &runs) {
+    for (Size pos = equalLength(a, b, size); pos < size; pos += equalLength(a + pos, b + pos, size - pos)) {
+        const Size len = differentLength(a + pos, b + pos, size - pos);
+        const Offset begin = addr + pos, end = begin + len - 1;
+        if (!runs.empty() && runs.back().end.toLinear() + 1 == begin) runs.back().end = Address{end};
+        else runs.emplace_back(begin, end);
+        pos += len;
+    }
+}
+
+vector<Block> Memory::diff(const Memory &other, const Block &range) const {
+    const Offset begin = range.begin.toLinear(), end = range.end.toLinear() + 1;
+    if (end > MEM_TOTAL) throw MemoryError("Diff range outside memory bounds: "s + range.toString());
+    vector<Block> runs;
+    for (Offset pos = begin; pos < end; ) {
+        const Size chunk = min(end - pos, MEM_PAGE_SIZE - pageOffset(pos));
+        const Byte *a = pageData(pos), *b = other.pageData(pos);
+        // pages shared between copies, the flat buffer and untouched pages compare equal without looking at them
+        if (a != b) diffRuns(a + pageOffset(pos), b + pageOffset(pos), chunk, pos, runs);
+        pos += chunk;
+    }
+    return runs;
+}
+
+vector<Block> Memory::diff(const Offset addr, const Byte *data, const Size size) const {
+    if (addr + size > MEM_TOTAL) throw MemoryError("Diff buffer outside memory bounds: "s + hexVal(addr));
+    vector<Block> runs;
+    for (Offset pos = addr, end = addr + size; pos < end; ) {
+        const Size chunk = min(end - pos, MEM_PAGE_SIZE - pageOffset(pos));
+        diffRuns(pageData(pos) + pageOffset(pos), data + (pos - addr), chunk, pos, runs);
+        pos += chunk;
+    }
+    return runs;
+}
+
+vector<Block> Memory::diffFile(const Offset addr, const std::string &path) const {
+    const FileStatus stat = checkFile(path);
+    if (!stat.exists) throw IoError("File does not exist: " + path);
+    vector<Byte> data(stat.size);
+    if (!data.empty() && !readBinaryFile(path, data.data(), data.size())) throw IoError("Unable to read file: " + path);
+    return diff(addr, data.data(), data.size());
+}
+
+void Memory::hexDump(OutputSink &sink, const std::vector<Block> &ranges) const {
+    const Size bpl = 16; // display bytes per line
+    Byte bytes[bpl];
+    string line;
+    line.reserve(HEX_STRMAX + bpl * 4);
+    Offset next = 0; // start of the first line not dumped yet
+    for (const Block &r : ranges) {
+        if (!r.isValid()) continue;
+        Offset pos = max(r.begin.toLinear() & ~(bpl - 1), next);
+        const Offset end = min(r.end.toLinear() + 1, MEM_TOTAL);
+        if (pos > next && next != 0) sink.write("[...]", true);
+        for (; pos < end; pos += bpl) {
+            readBuf(pos, bytes, bpl);
+            char buf[HEX_STRMAX], *p = buf;
+            line.assign("0x");
+            line.append(buf, formatHexDigits(buf, pos, 8));
+            line.append(": ");
+            for (const Byte b : bytes) {
+                p = formatHexDigits(buf, b, 2);
+                *p++ = ' ';
+                line.append(buf, p);
+            }
+            for (const Byte b : bytes) line.push_back(b >= 0x20 && b <= 0x7e ? static_cast<char>(b) : '.');
+            sink.write(line, true);
+        }
+        next = max(next, pos);
+    }
+    sink.flush();
+}
+
 void Memory::dump(const Block &range, const std::string &path) const {
-    auto memoryPtr = pointer(range.begin.toLinear());
+    vector<Byte> buf(range.size());
+    readBuf(range.begin.toLinear(), buf.data(), buf.size());
+    const Byte *memoryPtr = buf.data();
     if (path.empty()) { // dump to screen
-        hexDump(memoryPtr, range.size(), 0, false);
+        ::hexDump(memoryPtr, range.size(), 0, false);
     }
     else { // dump to file
         ofstream dumpFile{path, ios::binary};
@@ -8,11 +8,16 @@
 #include <regex>
 #include <cassert>
 #include <cstddef>
+#include <algorithm>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "dos/mz.h"
 #include "dos/error.h"
 #include "dos/util.h"
 #include "dos/output.h"
+#include "dos/search.h"
 
 using namespace std;
 
@@ -24,8 +29,8 @@ static void debug(const string &msg) {
     output(msg, LOG_OS, LOG_DEBUG);
 }
 
-// parse and read exe header and relocation table
-MzImage::MzImage(const std::string &path) : path_(path), loadSegment_(0) {
+// map the file and parse the exe header, the relocation table and the original values at the relocations from the mapping
+MzImage::MzImage(const std::string &path) : path_(path), data_(nullptr), mapping_(nullptr), mappingSize_(0), loadSegment_(0) {
     if (path_.empty()) 
         throw ArgError("Empty path for MzImage!");
     const auto file = checkFile(path);
@@ -38,79 +43,85 @@ MzImage::MzImage(const std::string &path) : path_(path), loadSegment_(0) {
     filesize_ = file.size;
     if (filesize_ < MZ_HEADER_SIZE)
         throw IoError(string("MzImage file too small (") + to_string(filesize_) + ")!");
+    map();
+    // the destructor does not run for a throwing constructor
+    try { parse(); }
+    catch (...) { unmap(); throw; }
+    debug("Loaded MZ exe header from "s + path_ + ", entrypoint @ " + entrypoint().toString() + ", stack @ " + stackPointer().toString());
+}
 
+void MzImage::parse() {
+    const Byte *fileData = static_cast<const Byte*>(mapping_);
     // parse MZ header
-    // TODO: use fstream and ios::binary
-    FILE *mzFile = fopen(path_.c_str(), "r");
-    if (!mzFile)
-        throw IoError("Unable to open file "s + path_);
-    auto totalSize = fread(&header_, 1, MZ_HEADER_SIZE, mzFile);
-    if (totalSize != MZ_HEADER_SIZE) {
-        fclose(mzFile);
-        throw IoError("Incorrect read size from MzImage file: "s + to_string(totalSize));
-    }
+    memcpy(&header_, fileData, MZ_HEADER_SIZE);
     if (header_.signature != MZ_SIGNATURE) {
         ostringstream msg("MzImage file has incorrect signature (0x", std::ios_base::ate);
         msg << std::hex << header_.signature << ")!";
-        fclose(mzFile);
         throw IoError(msg.str());
     }
 
-    // read in any bytes between end of header and beginning of relocation table: optional overlay information?
+    // any bytes between end of header and beginning of relocation table: optional overlay information?
     debug("Relocation table at offset "s + hexVal(header_.reloc_table_offset) + ", header size = " + hexVal(MZ_HEADER_SIZE));
     if (header_.reloc_table_offset > MZ_HEADER_SIZE) {
-        const Size ovlInfoSize = header_.reloc_table_offset - MZ_HEADER_SIZE;
-        ovlinfo_ = vector<Byte>(ovlInfoSize);
-        fread(ovlinfo_.data(), 1, ovlInfoSize, mzFile);
+        const Size ovlInfoEnd = min<Size>(header_.reloc_table_offset, filesize_);
+        ovlinfo_.assign(fileData + MZ_HEADER_SIZE, fileData + ovlInfoEnd);
     }
 
-    // read in relocation entries
-    if (header_.num_relocs) {
-        if (fseek(mzFile, header_.reloc_table_offset, SEEK_SET) != 0) {
-            fclose(mzFile);
-            throw IoError("Unable to seek to relocation table!");
-        }
-        for (size_t i = 0; i < header_.num_relocs; ++i) {
-            Word relocData[2];
-            auto relocReadSize = fread(&relocData, 1, MZ_RELOC_SIZE, mzFile);
-            if (relocReadSize != MZ_RELOC_SIZE) {
-                fclose(mzFile);
-                throw IoError("Invalid relocation read size from MzImage file: "s + to_string(relocReadSize));
-            }
-            Relocation reloc;
-            reloc.segment = relocData[1];
-            reloc.offset = relocData[0];
-            relocs_.push_back(reloc);
-        }
+    // relocation entries
+    const Size relocTableEnd = header_.reloc_table_offset + header_.num_relocs * MZ_RELOC_SIZE;
+    if (header_.num_relocs && relocTableEnd > filesize_) 
+        throw IoError("Relocation table of "s + to_string(header_.num_relocs) + " entries at " + hexVal(header_.reloc_table_offset) 
+            + " extends past the end of " + path_ + ": " + to_string(relocTableEnd) + " > " + to_string(filesize_));
+    relocs_.resize(header_.num_relocs);
+    const Byte *relocData = fileData + header_.reloc_table_offset;
+    for (auto &reloc : relocs_) {
+        memcpy(&reloc.offset, relocData, sizeof(Word));
+        memcpy(&reloc.segment, relocData + sizeof(Word), sizeof(Word));
+        relocData += MZ_RELOC_SIZE;
     }
 
     // calculate load module offset
     loadModuleOffset_ = header_.header_paragraphs * PARAGRAPH_SIZE;
     if (header_.pages_in_file == 0)
         throw DosError("Page count in MZ header is zero");
-    loadModuleSize_ = (header_.pages_in_file - 1) * PAGE_SIZE + header_.last_page_size - loadModuleOffset_;
+    if (header_.last_page_size > PAGE_SIZE)
+        throw DosError("Invalid last page size in MZ header: "s + to_string(header_.last_page_size));
+    // a last page size of zero means the last page is full
+    const Size imageSize = (header_.pages_in_file - 1) * PAGE_SIZE + (header_.last_page_size ? header_.last_page_size : PAGE_SIZE);
+    if (loadModuleOffset_ > imageSize)
+        throw DosError("Header size in MZ header exceeds the image size: "s + to_string(loadModuleOffset_) + " > " + to_string(imageSize));
+    loadModuleSize_ = imageSize - loadModuleOffset_;
     // store original values at relocation offsets
     for (auto &reloc : relocs_) {
-        Address relocAddr(reloc.segment, reloc.offset);
-        Offset fileOffset = relocAddr.toLinear() + loadModuleOffset_;
-        if (fseek(mzFile, fileOffset, SEEK_SET) != 0) {
-            fclose(mzFile);
-            throw IoError("Unable to seek to relocation offset!");
-        }
-        Word relocVal;
-        auto relocValSize = fread(&relocVal, 1, sizeof(Word), mzFile);
-        if (relocValSize != sizeof(Word)) {
-            fclose(mzFile);
-            throw IoError("Invalid relocation value read size from MzImage file: "s + to_string(relocValSize));
-        }
-        reloc.value = relocVal;
+        const Offset fileOffset = Address(reloc.segment, reloc.offset).toLinear() + loadModuleOffset_;
+        if (fileOffset + sizeof(Word) > filesize_) 
+            throw IoError("Relocation at "s + Address(reloc.segment, reloc.offset).toString() + " points past the end of " + path_ + ": " + hexVal(fileOffset));
+        memcpy(&reloc.value, fileData + fileOffset, sizeof(Word));
     }
-    fclose(mzFile);
-    debug("Loaded MZ exe header from "s + path_ + ", entrypoint @ " + entrypoint().toString() + ", stack @ " + stackPointer().toString());
 }
 
-MzImage::MzImage(const std::vector<Byte> &code) : filesize_(0), loadModuleSize_(code.size()), loadModuleOffset_(0), entrypoint_(0, 0), loadSegment_(0) {
-    std::copy(code.begin(), code.end(), std::back_inserter(loadModuleData_));
+MzImage::MzImage(const std::vector<Byte> &code) : filesize_(0), loadModuleSize_(code.size()), loadModuleData_(code), 
+    data_(loadModuleData_.data()), mapping_(nullptr), mappingSize_(0), loadModuleOffset_(0), entrypoint_(0, 0), loadSegment_(0) {
+}
+
+MzImage::~MzImage() {
+    unmap();
+}
+
+void MzImage::map() {
+    const int fd = open(path_.c_str(), O_RDONLY);
+    if (fd < 0) throw IoError("Unable to open exe file: " + path_);
+    void *mapping = mmap(nullptr, filesize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) throw IoError("Unable to map exe file: " + path_);
+    mapping_ = mapping;
+    mappingSize_ = filesize_;
+}
+
+void MzImage::unmap() {
+    if (mapping_) munmap(mapping_, mappingSize_);
+    mapping_ = nullptr;
+    mappingSize_ = 0;
 }
 
 std::string MzImage::dump() const {
@@ -165,54 +176,56 @@ std::string MzImage::dump() const {
     return msg.str();
 }
 
-std::string byteBufString(const std::vector<Byte> &bytes) {
-    ostringstream str;
-    for (Byte b : bytes) { 
-        str << hexVal(b, false) << " ";
+Address MzImage::find(const std::vector<SWord> &pattern) const {
+    const auto found = findAll(pattern);
+    return found.empty() ? Address{} : found.front();
+}
+
+std::vector<Address> MzImage::findAll(const std::vector<SWord> &pattern) const {
+    vector<Address> ret;
+    for (const auto &m : findAll(vector<vector<SWord>>{pattern})) ret.emplace_back(m.offset);
+    return ret;
+}
+
+std::vector<PatternSearch::Match> MzImage::findAll(const std::vector<std::vector<SWord>> &patterns) const {
+    // search through a copy with the relocations applied, like the load module appears in memory
+    vector<Byte> module(data_, data_ + loadModuleSize_);
+    for (const auto &p : patches_) {
+        module[p.offset] = lowByte(p.value);
+        module[p.offset + 1] = hiByte(p.value);
     }
-    return str.str();
+    return PatternSearch{patterns}.findAll(module.data(), module.size());
 }
 
-Address MzImage::find(const std::vector<SWord> &pattern) const {
-    // too lazy to implement Boyer-Moore
-    const Size patSize = pattern.size();
-    Address found;
-    vector<Byte> buffer(patSize);
-    for (Offset dataIdx = 0; dataIdx + patSize < loadModuleSize_; ++dataIdx) {
-        std::copy(loadModuleData_.begin() + dataIdx, loadModuleData_.begin() + dataIdx + patSize, buffer.begin());
-        //debug("dataIdx = " + hexVal(dataIdx) + ", buffer: " + byteBufString(buffer));
-        bool match = true;
-        // ouch, O(n^2)
-        for (Offset patIdx = 0; patIdx < pattern.size(); ++patIdx) {
-            const SWord pat = pattern[patIdx];
-            //debug(hexVal(pat, false) + " ");
-            if (pattern[patIdx] == -1) continue;
-            if (pattern[patIdx] != buffer[patIdx]) { match = false; break; }
-        }
-        if (match) { found = Address{dataIdx}; break; }
+Byte MzImage::loadModuleByte(const Offset off) const {
+    // the patch covering the byte starts either at it or at the one before
+    auto it = upper_bound(patches_.begin(), patches_.end(), off, [](const Offset o, const RelocationPatch &p) { return o < p.offset; });
+    if (it != patches_.begin()) {
+        --it;
+        if (it->offset == off) return lowByte(it->value);
+        if (it->offset + 1 == off) return hiByte(it->value);
     }
-    return found;
+    return data_[off];
 }
 
-// read actual load module data
+// compute the relocated values, the load module itself is not copied or modified
 void MzImage::load(const Word loadSegment) {
     debug("Loading executable code: size = "s + hexVal(loadModuleSize_) + " bytes starting at file offset "s + hexVal(loadModuleOffset_) + ", relocation factor " + hexVal(loadSegment));
-    ifstream mzFile(path_, ios::binary);
-    if (!mzFile.is_open()) throw IoError("Unable to open exe file: " + path_);
-    mzFile.seekg(loadModuleOffset_);
-    loadModuleData_.reserve(loadModuleSize_);
+    if (loadModuleOffset_ + loadModuleSize_ > filesize_) 
+        throw IoError("Load module extends past the end of "s + path_ + ": " + to_string(loadModuleOffset_ + loadModuleSize_) + " > " + to_string(filesize_));
+    data_ = static_cast<const Byte*>(mapping_) + loadModuleOffset_;
     loadSegment_ = loadSegment;
-    mzFile.read(reinterpret_cast<char*>(loadModuleData_.data()), loadModuleSize_);
-    const auto bytesRead = mzFile.gcount();
-    if (!mzFile) throw IoError("Error while reading load module data from "s + path_);
-    if (bytesRead != loadModuleSize_) throw IoError("Incorrect number of bytes read from "s  + path_ + ": " + to_string(bytesRead));
-    mzFile.close();
-    // patch relocations
+    // the relocations go into a sorted overlay, a later relocation of the same word takes precedence
+    patches_.clear();
     for (const Relocation &r : relocs_) {
-        const Address addr(r.segment, r.offset);
-        const Offset off = addr.toLinear();
-        const Word patchedVal = r.value + loadSegment;
-        loadModuleData_[off] = lowByte(patchedVal);
-        loadModuleData_[off + 1] = hiByte(patchedVal);
+        const Offset off = Address(r.segment, r.offset).toLinear();
+        if (off + sizeof(Word) > loadModuleSize_) {
+            debug("Ignoring relocation outside of load module at "s + hexVal(off));
+            continue;
+        }
+        patches_.push_back({off, static_cast<Word>(r.value + loadSegment)});
     }
+    stable_sort(patches_.begin(), patches_.end(), [](const RelocationPatch &a, const RelocationPatch &b) { return a.offset < b.offset; });
+    auto last = unique(patches_.rbegin(), patches_.rend(), [](const RelocationPatch &a, const RelocationPatch &b) { return a.offset == b.offset; });
+    patches_.erase(patches_.begin(), last.base());
 }
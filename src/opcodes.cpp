@@ -103,22 +103,22 @@ static const char* OPCODE_NAMES[256] = {
     "POP_BP",
     "POP_SI",
     "POP_DI",
-    "XXX_0x60",
-    "XXX_0x61",
-    "XXX_0x62",
+    "PUSHA",
+    "POPA",
+    "BOUND_Gv_M",
     "XXX_0x63",
     "XXX_0x64",
     "XXX_0x65",
     "XXX_0x66",
     "XXX_0x67",
-    "XXX_0x68",
-    "XXX_0x69",
-    "XXX_0x6a",
-    "XXX_0x6b",
-    "XXX_0x6c",
-    "XXX_0x6d",
-    "XXX_0x6e",
-    "XXX_0x6f",
+    "PUSH_Iv",
+    "IMUL_Gv_Ev_Iv",
+    "PUSH_Ib",
+    "IMUL_Gv_Ev_Ib",
+    "INSB",
+    "INSW",
+    "OUTSB",
+    "OUTSW",
     "JO_Jb",
     "JNO_Jb",
     "JB_Jb",
@@ -199,16 +199,16 @@ static const char* OPCODE_NAMES[256] = {
     "MOV_BP_Iv",
     "MOV_SI_Iv",
     "MOV_DI_Iv",
-    "XXX_0xc0",
-    "XXX_0xc1",
+    "GRP2_Eb_Ib",
+    "GRP2_Ev_Ib",
     "RET_Iw",
     "RET",
     "LES_Gv_Mp",
     "LDS_Gv_Mp",
     "MOV_Eb_Ib",
     "MOV_Ev_Iv",
-    "XXX_0xc8",
-    "XXX_0xc9",
+    "ENTER_Iw_Ib",
+    "LEAVE",
     "RETF_Iw",
     "RETF",
     "INT_3",
@@ -273,78 +273,6 @@ std::string opcodeString(const Byte opcode) {
     return hexVal(opcode) + " (" + opcodeName(opcode) + ")";
 }
 
-static const int OPCODE_MODRM[256] = {
-//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
-    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 0
-    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 1
-    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 2
-    1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, // 3
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 4
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 5
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 6
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 7
-    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 8
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 9
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // A
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // B
-    0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, // C
-    1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // D
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // E
-    0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, // F
-};
-
-bool opcodeIsModrm(const Byte opcode) {
-    return OPCODE_MODRM[opcode] == 1;
-}
-
-static const int OPCODE_GROUP[256] = {
-//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 1
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 2
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 3
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 4
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 5
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 6
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 7
-    1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 8
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 9
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // A
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // B
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // C
-    1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // D
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // E
-    0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, // F
-};
-
-bool opcodeIsGroup(const Byte opcode) {
-    return OPCODE_GROUP[opcode] == 1;
-}
-
-static const int OPCODE_PREFIX[256] = {
-//  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 1
-    0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, // 2
-    0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, // 3
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 4
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 5
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 6
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 7
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 8
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 9
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // A
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // B
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // C
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // D
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // E
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // F
-};
-
-bool opcodeIsSegmentPrefix(const Byte opcode) {
-    return OPCODE_PREFIX[opcode] == 1;
-}
-
 bool opcodeIsConditionalJump(const Byte opcode) {
     return (opcode >= OP_JO_Jb && opcode <= OP_JG_Jb) || opcode == OP_JCXZ_Jb;
 }
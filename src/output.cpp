@@ -1,26 +1,47 @@
 #include "dos/output.h"
+#include "dos/sink.h"
 
-#include <iostream>
-#include <map>
+#include <memory>
 
 using namespace std;
 
 static LogPriority globalPriority = LOG_INFO;
 
-static map<LogModule, bool> moduleVisible = {
-    { LOG_SYSTEM,    true },
-    { LOG_CPU,       true },
-    { LOG_MEMORY,    true },
-    { LOG_OS,        true },
-    { LOG_INTERRUPT, true },
-    { LOG_ANALYSIS,  true },
-    { LOG_OTHER,     true },
-};
+// indexed by LogModule, checked on every output call so keep it a plain array instead of a map
+static bool moduleVisible[LOG_OTHER + 1] = { true, true, true, true, true, true, true };
+
+bool outputEnabled(const LogModule mod, const LogPriority pri) {
+    return pri >= globalPriority && moduleVisible[mod];
+}
+
+// created on first use, destroying it at exit flushes whatever is still pending
+static unique_ptr<OutputSink> sink;
+
+static OutputSink& activeSink() {
+    if (!sink) sink.reset(new AsyncSink(stdout));
+    return *sink;
+}
 
 void output(const std::string &msg, const LogModule mod, const LogPriority pri, const bool suppressNewline) {
-    if (pri < globalPriority || !moduleVisible[mod]) return;
-    cout << msg;
-    if (!suppressNewline) cout << endl;
+    if (!outputEnabled(mod, pri)) return;
+    OutputSink &out = activeSink();
+    out.write(msg, !suppressNewline);
+    // make sure errors are visible right away in case the process does not survive them
+    if (pri >= LOG_ERROR) out.flush();
+}
+
+std::string& logBuffer() {
+    static thread_local std::string buffer;
+    return buffer;
+}
+
+void outputFlush() {
+    if (sink) sink->flush();
+}
+
+void setOutputSink(OutputSink *newSink) {
+    outputFlush();
+    sink.reset(newSink);
 }
 
 void setOutputLevel(const LogPriority minPriority) {
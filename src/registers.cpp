@@ -155,6 +155,12 @@ void RegisterState::setUnknown(const Register r) {
     setState(r, 0, false);
 }
 
+void RegisterState::setUnknown(const RegisterMask mask) {
+    for (int r = REG_AL; r <= REG_FLAGS; ++r) {
+        if (mask & regMask(static_cast<Register>(r))) setUnknown(static_cast<Register>(r));
+    }
+}
+
 string RegisterState::stateString(const Register r) const {
     if (regIsWord(r))
         return (isKnown(r) ? hexVal(regs_.get(r), false, true) : "????");
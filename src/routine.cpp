@@ -49,18 +49,18 @@ Block Routine::nextReachable(const Address &from) const {
 
 bool Routine::colides(const Block &block, const bool checkExtents) const {
     if (checkExtents && extents.intersects(block)) {
-        debug("Block "s + block.toString() + " colides with extents of routine " + toString(false));
+        debug("Block ", block, " colides with extents of routine ", toString(false));
         return true;
     }    
     for (const auto &b : reachable) {
         if (b.intersects(block)) {
-            debug("Block "s + block.toString() + " colides with reachable block " + b.toString() + " of routine " + toString(false));
+            debug("Block ", block, " colides with reachable block ", b, " of routine ", toString(false));
             return true;
         }
     }
     for (const auto &b : unreachable) {
         if (b.intersects(block)) {
-            debug("Block "s + block.toString() + " colides with unreachable block " + b.toString() + " of routine " + toString(false));
+            debug("Block ", block, " colides with unreachable block ", b, " of routine ", toString(false));
             return true;
         }
     }    
@@ -110,7 +110,7 @@ RoutineMap::RoutineMap(const ScanQueue &sq, const std::vector<Segment> &segs, co
     Block b(startOffset);
     prevId = curBlockId = prevBlockId = NULL_ROUTINE;
     Segment curSeg = findSegment(startOffset);
-    debug("=== Starting in segment " + curSeg.toString());
+    debug("=== Starting in segment ", curSeg);
 
     for (Offset mapOffset = startOffset; mapOffset < endOffset; ++mapOffset) {
         // find segment matching currently processed offset
@@ -118,7 +118,7 @@ RoutineMap::RoutineMap(const ScanQueue &sq, const std::vector<Segment> &segs, co
         Segment offSeg = findSegment(mapOffset);
         if (offSeg != curSeg) {
             curSeg = offSeg;
-            debug("=== Segment change to " + curSeg.toString());
+            debug("=== Segment change to ", curSeg);
         }
         // convert map offset to segmented address
         Address curAddr{mapOffset};
@@ -130,7 +130,7 @@ RoutineMap::RoutineMap(const ScanQueue &sq, const std::vector<Segment> &segs, co
         // the condition prevents attempting to close a (yet non-existent) block at the first byte of the load module
         if (mapOffset != startOffset) closeBlock(b, curAddr, sq); 
         // start new block
-        debug(curAddr.toString() + ": starting block for routine_" + to_string(curId));
+        debug(curAddr, ": starting block for routine_", curId);
         b = Block(curAddr);
         curBlockId = curId;
         // last thing to do is memorize current id as previous for discovering when needing to close again
@@ -138,9 +138,16 @@ RoutineMap::RoutineMap(const ScanQueue &sq, const std::vector<Segment> &segs, co
     }
     // close last block finishing on the last byte of the memory map
     closeBlock(b, endOffset, sq);
+    // keep the suspected data locations which did not end up claimed by a routine through another path
+    for (const Block &d : sq.suspectData()) {
+        if (sq.getRoutineId(d.begin.toLinear()) != NULL_ROUTINE) continue;
+        if (std::find(dataBlocks.begin(), dataBlocks.end(), d) == dataBlocks.end()) dataBlocks.push_back(d);
+    }
 
     // TODO: coalesce adjacent blocks, see routine_35 of hello.exe: 1415-14f7 R1412-1414 R1415-14f7
 
+    // a routine whose entrypoint does not decode has no code, the location is kept as suspected data instead
+    routines.erase(std::remove_if(routines.begin(), routines.end(), [](const Routine &r) { return r.reachable.empty(); }), routines.end());
     // calculate routine extents
     for (auto &r : routines) {
         Address entrypoint = r.entrypoint();
@@ -157,7 +164,7 @@ RoutineMap::RoutineMap(const ScanQueue &sq, const std::vector<Segment> &segs, co
             if (b.begin < r.extents.begin) continue; // ignore blocks that begin before the routine entrypoint
             r.extents.coalesce(b);
         }
-        debug("Calculated routine extents: "s + r.toString(false));
+        debug("Calculated routine extents: ", r.toString(false));
     }
     
     sort();
@@ -170,7 +177,7 @@ RoutineMap::RoutineMap(const std::string &path, const Word reloc) {
     smatch match;
     if (regex_match(path, match, LSTFILE_RE)) loadFromIdaFile(path, reloc);
     else loadFromMapFile(path, reloc);
-    debug("Done, found "s + to_string(routines.size()) + " routines");
+    debug("Done, found ", routines.size(), " routines");
     sort();
 }
 
@@ -196,14 +203,14 @@ Size RoutineMap::match(const RoutineMap &other) const {
         bool routineMatch = false;
         for (const auto &ro : other.routines) {
             if (r.extents == ro.extents) {
-                debug("Found routine match for "s + r.toString(false) + " with " + ro.toString(false));
+                debug("Found routine match for ", r.toString(false), " with ", ro.toString(false));
                 routineMatch = true;
                 matchCount++;
                 break;
             }
         }
         if (!routineMatch) {
-            debug("Unable to find match for "s + r.toString(false));
+            debug("Unable to find match for ", r.toString(false));
         }
     }
     return matchCount;
@@ -224,8 +231,7 @@ void RoutineMap::closeBlock(Block &b, const Address &next, const ScanQueue &sq)
 
     b.end = Address{next.toLinear() - 1};
     b.end.move(b.begin.segment);
-    debug(next.toString() + ": closing block " + b.toString() + ", curId = " + to_string(curId) + ", prevId = " + to_string(prevId) 
-        + ", curBlockId = " + to_string(curBlockId) + ", prevBlockId = " + to_string(prevBlockId));
+    debug(next, ": closing block ", b, ", curId = ", curId, ", prevId = ", prevId, ", curBlockId = ", curBlockId, ", prevBlockId = ", prevBlockId);
 
     if (!b.isValid())
         throw AnalysisError("Attempted to close invalid block");
@@ -281,6 +287,7 @@ void RoutineMap::sort() {
     std::sort(routines.begin(), routines.end());
     // sort unclaimed blocks by block start
     std::sort(unclaimed.begin(), unclaimed.end());
+    std::sort(dataBlocks.begin(), dataBlocks.end());
     // sort blocks within routines by block start
     for (auto &r : routines) {
         std::sort(r.reachable.begin(), r.reachable.end());
@@ -322,6 +329,14 @@ void RoutineMap::save(const std::string &path, const Word reloc, const bool over
         }
         file << endl;
     }
+    for (const auto &d : dataBlocks) {
+        Block rblock{d};
+        rblock.rebase(reloc);
+        Segment dseg = findSegment(d.begin.segment);
+        if (dseg.type == Segment::SEG_NONE) 
+            throw AnalysisError("Unable to find segment for suspected data block " + d.toString());
+        file << "data " << dseg.name << " " << hexVal(rblock.begin.offset, false) << "-" << hexVal(rblock.end.offset, false) << endl;
+    }
 }
 
 // TODO: implement a print mode of all blocks (reachable, unreachable, unclaimed) printed linearly, not grouped under routines
@@ -350,6 +365,9 @@ string RoutineMap::dump() const {
     for (const auto &r : printRoutines) {
         str << r.toString(true) << endl;
     }
+    for (const auto &d : dataBlocks) {
+        str << "suspected data: " << d.toString() << endl;
+    }
     return str.str();
 }
 
@@ -394,7 +412,8 @@ enum BlockType { BLOCK_NONE, BLOCK_EXTENTS, BLOCK_REACHABLE, BLOCK_UNREACHABLE }
 
 void RoutineMap::loadFromMapFile(const std::string &path, const Word reloc) {
     static const regex RANGE_RE{"([0-9a-fA-F]{1,4})-([0-9a-fA-F]{1,4})"};
-    debug("Loading routine map from "s + path + ", relocating to " + hexVal(reloc));
+    static const regex DATA_RE{"^data ([_a-zA-Z0-9]+) ([0-9a-fA-F]{1,4})-([0-9a-fA-F]{1,4})"};
+    debug("Loading routine map from ", path, ", relocating to ", hexArg(reloc));
     ifstream mapFile{path};
     string line, token;
     Size lineno = 0;
@@ -407,10 +426,18 @@ void RoutineMap::loadFromMapFile(const std::string &path, const Word reloc) {
         else if (!(match = Segment::stringMatch(line)).empty()) {
             Segment s(match);
             s.address += reloc;
-            debug("Loaded segment: " + s.toString());
+            debug("Loaded segment: ", s);
             segments.push_back(s);
             continue;
         }
+        // suspected data block
+        else if (regex_match(line, match, DATA_RE)) {
+            const Segment dseg = findSegment(match.str(1));
+            if (dseg.type == Segment::SEG_NONE) throw ParseError("Line " + to_string(lineno) + ": unknown segment '" + match.str(1) + "'");
+            dataBlocks.emplace_back(Address{dseg.address, static_cast<Word>(stoi(match.str(2), nullptr, 16))}, 
+                                    Address{dseg.address, static_cast<Word>(stoi(match.str(3), nullptr, 16))});
+            continue;
+        }
         // otherwise try interpreting as a routine description
         istringstream sstr{line};
         Routine r;
@@ -472,7 +499,7 @@ void RoutineMap::loadFromMapFile(const std::string &path, const Word reloc) {
             }
         } // iterate over tokens in a routine definition
         if (r.extents.isValid()) {
-            debug("routine: "s + r.toString());
+            debug("routine: ", r);
             routines.push_back(r);
         }
     } // iterate over mapfile lines
@@ -481,7 +508,7 @@ void RoutineMap::loadFromMapFile(const std::string &path, const Word reloc) {
 // create routine map from IDA .lst file
 // TODO: add collision checks
 void RoutineMap::loadFromIdaFile(const std::string &path, const Word reloc) {
-    debug("Loading IDA routine map from "s + path + ", relocation factor " + hexVal(reloc));
+    debug("Loading IDA routine map from ", path, ", relocation factor ", hexArg(reloc));
     ifstream fstr{path};
     string line, lastAddr;
     Size lineno = 1;
@@ -509,20 +536,20 @@ void RoutineMap::loadFromIdaFile(const std::string &path, const Word reloc) {
         if (endpAddr.isValid() && curAddr != endpAddr) {
             auto &r = routines.back();
             r.extents.end = curAddr - 1; // go one byte before current address
-            debug("Closing routine "s + r.name + " @ " + r.extents.end.toString());
+            debug("Closing routine ", r.name, " @ ", r.extents.end);
             endpAddr = Address(); // makes address invalid
         }
         // start new routine
         if (token[2] == "proc") { 
             routines.emplace_back(Routine{token[1], curAddr});
             const auto &r = routines.back();
-            debug("Found start of routine "s + r.name + " @ " + r.extents.begin.toString());
+            debug("Found start of routine ", r.name, " @ ", r.extents.begin);
         }
         // routine end, but IDA places endp at the offset of the beginning of the last instruction, 
         // and we want the end to include the last instructions' bytes, so just memorize the address and close the routine later
         else if (token[2] == "endp") { 
             endpAddr = curAddr;
-            debug("Found end of routine @ " + endpAddr.toString());
+            debug("Found end of routine @ ", endpAddr);
         }
         lineno++;
     }
@@ -0,0 +1,152 @@
+#include "dos/search.h"
+#include "dos/error.h"
+
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <deque>
+
+using namespace std;
+
+// Horspool needs to skip at least this far on average to beat scanning with memchr(), which is vectorized by the C library
+static constexpr Size MIN_HORSPOOL_SHIFT = 4;
+static constexpr uint32_t NO_STATE = numeric_limits<uint32_t>::max();
+
+PatternSearch::PatternSearch(const Pattern &pattern) : PatternSearch(vector<Pattern>{pattern}) {}
+
+PatternSearch::PatternSearch(const std::vector<Pattern> &patterns) : patterns_(patterns), horspool_(false) {
+    for (const Pattern &p : patterns_) {
+        if (p.empty()) throw ArgError("Empty search pattern");
+        Key key{0, 0};
+        for (Size i = 0, run = 0; i < p.size(); ++i) {
+            if (p[i] < -1 || p[i] > 0xff) throw ArgError("Invalid search pattern value: " + to_string(p[i]));
+            run = p[i] == -1 ? 0 : run + 1;
+            if (run > key.size) key = {i + 1 - run, run};
+        }
+        keys_.push_back(key);
+    }
+    if (patterns_.size() == 1) buildShifts();
+    else buildAutomaton();
+}
+
+std::vector<PatternSearch::Match> PatternSearch::findAll(const Byte *data, const Size size) const {
+    vector<Match> hits;
+    if (patterns_.size() == 1) findSingle(data, size, hits);
+    else findMultiple(data, size, hits);
+    return hits;
+}
+
+bool PatternSearch::matches(const Pattern &pattern, const Byte *data) const {
+    for (Size i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != -1 && pattern[i] != data[i]) return false;
+    }
+    return true;
+}
+
+// The shift for the byte under the last position of the window is the distance from its last occurrence in the
+// pattern to the end, a wildcard matches every byte so no shift can go past the last wildcard.
+void PatternSearch::buildShifts() {
+    const Pattern &p = patterns_.front();
+    const Size m = p.size();
+    Size dflt = m;
+    for (Size i = 0; i + 1 < m; ++i) if (p[i] == -1) dflt = m - 1 - i;
+    shift_.fill(dflt);
+    for (Size i = m - dflt; i + 1 < m; ++i) shift_[p[i]] = m - 1 - i;
+    horspool_ = dflt >= MIN_HORSPOOL_SHIFT;
+}
+
+void PatternSearch::findSingle(const Byte *data, const Size size, std::vector<Match> &hits) const {
+    const Pattern &p = patterns_.front();
+    const Size m = p.size();
+    if (size < m) return;
+    const Key &key = keys_.front();
+    if (key.size == 0) { // only wildcards
+        for (Offset pos = 0; pos + m <= size; ++pos) hits.push_back({pos, 0});
+    }
+    else if (horspool_) {
+        for (Offset pos = 0; pos + m <= size; pos += shift_[data[pos + m - 1]]) {
+            if (matches(p, data + pos)) hits.push_back({pos, 0});
+        }
+    }
+    else {
+        // look for the first byte of the longest fixed run, it can be anywhere between its position in the pattern
+        // and the same distance from the last possible place of a match
+        const Byte anchor = static_cast<Byte>(p[key.begin]);
+        const Byte *end = data + size - m + key.begin + 1;
+        for (const Byte *pos = data + key.begin; pos < end; ++pos) {
+            pos = static_cast<const Byte*>(memchr(pos, anchor, end - pos));
+            if (!pos) break;
+            const Byte *start = pos - key.begin;
+            if (matches(p, start)) hits.push_back({static_cast<Offset>(start - data), 0});
+        }
+    }
+}
+
+void PatternSearch::buildAutomaton() {
+    State root;
+    root.next.fill(NO_STATE);
+    states_.push_back(root);
+    // trie of the keys
+    for (Size i = 0; i < patterns_.size(); ++i) {
+        const Key &key = keys_[i];
+        if (key.size == 0) { wildcards_.push_back(i); continue; }
+        uint32_t s = 0;
+        for (Size j = key.begin; j < key.begin + key.size; ++j) {
+            const Byte b = static_cast<Byte>(patterns_[i][j]);
+            if (states_[s].next[b] == NO_STATE) {
+                State child;
+                child.next.fill(NO_STATE);
+                states_[s].next[b] = static_cast<uint32_t>(states_.size());
+                states_.push_back(child);
+            }
+            s = states_[s].next[b];
+        }
+        states_[s].output.push_back(i);
+    }
+    // Breadth-first over the trie, turning the missing transitions into the ones of the failure state, which is the
+    // state of the longest proper suffix of the current one. The outputs of the failure state are collected as well.
+    vector<uint32_t> fail(states_.size(), 0);
+    deque<uint32_t> queue;
+    for (auto &n : states_[0].next) {
+        if (n == NO_STATE) n = 0;
+        else queue.push_back(n);
+    }
+    while (!queue.empty()) {
+        const uint32_t s = queue.front();
+        queue.pop_front();
+        for (Size b = 0; b < 256; ++b) {
+            const uint32_t n = states_[s].next[b];
+            if (n == NO_STATE) {
+                states_[s].next[b] = states_[fail[s]].next[b];
+                continue;
+            }
+            fail[n] = states_[fail[s]].next[b];
+            const auto &inherited = states_[fail[n]].output;
+            states_[n].output.insert(states_[n].output.end(), inherited.begin(), inherited.end());
+            queue.push_back(n);
+        }
+    }
+}
+
+void PatternSearch::findMultiple(const Byte *data, const Size size, std::vector<Match> &hits) const {
+    for (const Size i : wildcards_) {
+        for (Offset pos = 0; pos + patterns_[i].size() <= size; ++pos) hits.push_back({pos, i});
+    }
+    if (states_.size() > 1) {
+        uint32_t s = 0;
+        for (Size i = 0; i < size; ++i) {
+            s = states_[s].next[data[i]];
+            for (const Size p : states_[s].output) {
+                // the key ends at the current byte, see if the complete pattern around it fits and matches
+                const Key &key = keys_[p];
+                if (i + 1 < key.begin + key.size) continue;
+                const Offset start = i + 1 - key.size - key.begin;
+                if (start + patterns_[p].size() <= size && matches(patterns_[p], data + start)) hits.push_back({start, p});
+            }
+        }
+    }
+    // hits are found in the order of the key ends
+    sort(hits.begin(), hits.end(), [](const Match &a, const Match &b) {
+        return a.offset < b.offset || (a.offset == b.offset && a.pattern < b.pattern);
+    });
+}
@@ -0,0 +1,119 @@
+#include "dos/sink.h"
+#include "dos/error.h"
+
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+// backstop for missed wakeups, the writer normally gets notified when new data arrives
+static const auto WRITER_POLL = chrono::milliseconds(20);
+
+static Size ringSize(const Size capacity) {
+    Size size = 1;
+    while (size < capacity) size <<= 1;
+    return size;
+}
+
+void StreamSink::write(const std::string &msg, const bool newline) {
+    stream_ << msg;
+    if (newline) stream_ << '\n';
+}
+
+void StreamSink::flush() {
+    stream_.flush();
+}
+
+AsyncSink::AsyncSink(std::FILE *file, const Size capacity) : file_(file), ownFile_(false), ring_(ringSize(capacity)), mask_(ring_.size() - 1) {
+    start();
+}
+
+AsyncSink::AsyncSink(const std::string &path, const Size capacity) : file_(fopen(path.c_str(), "w")), ownFile_(true), ring_(ringSize(capacity)), mask_(ring_.size() - 1) {
+    if (file_ == nullptr) throw IoError("Unable to open output file: " + path);
+    start();
+}
+
+AsyncSink::~AsyncSink() {
+    stop_ = true;
+    wakeWriter();
+    writer_.join();
+    if (ownFile_) fclose(file_);
+}
+
+void AsyncSink::start() {
+    head_ = tail_ = 0;
+    flushed_ = 0;
+    idle_ = stop_ = false;
+    writer_ = thread(&AsyncSink::run, this);
+}
+
+void AsyncSink::write(const std::string &msg, const bool newline) {
+    put(msg.data(), msg.size());
+    if (newline) put("\n", 1);
+    if (idle_) wakeWriter();
+}
+
+void AsyncSink::flush() {
+    const Size target = tail_;
+    wakeWriter();
+    unique_lock<mutex> lock(mutex_);
+    while (flushed_ < target) drained_.wait_for(lock, WRITER_POLL);
+}
+
+// copy data into the ring, waiting for the writer to free up space if needed
+void AsyncSink::put(const char *data, Size size) {
+    const Size cap = ring_.size();
+    Size tail = tail_.load(memory_order_relaxed);
+    while (size > 0) {
+        const Size avail = cap - (tail - head_.load(memory_order_acquire));
+        if (avail == 0) {
+            wakeWriter();
+            this_thread::yield();
+            continue;
+        }
+        const Size count = min(size, avail);
+        const Size pos = tail & mask_;
+        const Size first = min(count, cap - pos);
+        memcpy(ring_.data() + pos, data, first);
+        memcpy(ring_.data(), data + first, count - first);
+        tail += count;
+        tail_.store(tail); // sequentially consistent against the idle_ check in write()
+        data += count;
+        size -= count;
+    }
+}
+
+void AsyncSink::wakeWriter() {
+    { lock_guard<mutex> lock(mutex_); }
+    wake_.notify_one();
+}
+
+void AsyncSink::run() {
+    const Size cap = ring_.size();
+    while (true) {
+        const Size head = head_.load(memory_order_relaxed);
+        const Size tail = tail_.load(memory_order_acquire);
+        if (head != tail) {
+            // write out everything accumulated so far, in at most two pieces if the data wraps around the ring
+            const Size pos = head & mask_;
+            const Size count = tail - head;
+            const Size first = min(count, cap - pos);
+            fwrite(ring_.data() + pos, 1, first, file_);
+            if (count > first) fwrite(ring_.data(), 1, count - first, file_);
+            head_.store(tail, memory_order_release);
+            fflush(file_);
+            {
+                lock_guard<mutex> lock(mutex_);
+                flushed_ = tail;
+            }
+            drained_.notify_all();
+            continue;
+        }
+        if (stop_) break;
+        unique_lock<mutex> lock(mutex_);
+        idle_ = true;
+        wake_.wait_for(lock, WRITER_POLL, [this]{ return stop_ || tail_ != head_; });
+        idle_ = false;
+    }
+}
@@ -0,0 +1,37 @@
+#include "dos/store.h"
+
+#include <limits>
+#include <cassert>
+
+using namespace std;
+
+Instruction InstructionStore::get(const Address &addr, const Byte *data) {
+    const Offset off = addr.toLinear();
+    // outside of the area, nowhere to keep the result
+    if (!contains(off)) {
+        misses_++;
+        return Instruction{addr, data, INSTRUCTION_MAX, cpu_};
+    }
+    uint32_t &entry = index_[off - base_];
+    if (entry != 0) {
+        hits_++;
+        // the same location can be reached through a different segment:offset
+        Instruction i{records_[entry - 1]};
+        i.addr = addr;
+        return i;
+    }
+    misses_++;
+    // an instruction running past the end of the area is truncated
+    const Instruction i{addr, data, base_ + index_.size() - off, cpu_};
+    assert(records_.size() < numeric_limits<uint32_t>::max());
+    records_.push_back(i.record());
+    entry = static_cast<uint32_t>(records_.size());
+    return i;
+}
+
+string InstructionStore::statusString() const {
+    const Size lookups = hits_ + misses_;
+    return to_string(size()) + " instructions decoded, " + to_string(hits_) + " hits, " + to_string(misses_) + " misses"
+        + (lookups ? " (" + to_string(hits_ * 100 / lookups) + "% hit rate)" : "");
+}
+
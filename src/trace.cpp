@@ -0,0 +1,189 @@
+#include "dos/trace.h"
+#include "dos/error.h"
+#include "dos/util.h"
+
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char TRACE_MAGIC[8] = { 'M', 'Z', 'T', 'R', 'A', 'C', 'E', 0 };
+static const DWord TRACE_VERSION = 1;
+// records are mapped in chunks of this count, the file gets truncated to the actual size when closed
+static const Size TRACE_CHUNK = 0x10000;
+
+struct TraceHeader {
+    char magic[8];
+    DWord version;
+    DWord count; // only written on close, zero in traces of runs that did not finish
+};
+static_assert(sizeof(TraceHeader) == sizeof(TraceRecord), "Trace header must keep records aligned");
+
+static const char* TRACE_EVENT_NAME[] = {
+    "none",
+    "search",
+    "call",
+    "jump",
+    "claim",
+    "codemap",
+    "datamap",
+    "stackmap",
+    "mismatch",
+    "seed",
+    "data",
+};
+static_assert(sizeof(TRACE_EVENT_NAME) / sizeof(TRACE_EVENT_NAME[0]) == TRC_COUNT, "Trace event names out of sync");
+
+static const char* SKIP_NAME[] = { "fatal", "ref skip", "tgt skip" };
+
+const char* traceEventName(const TraceEvent ev) {
+    return ev < TRC_COUNT ? TRACE_EVENT_NAME[ev] : "???";
+}
+
+TraceEvent traceEventFromName(const std::string &name) {
+    for (int i = TRC_NONE + 1; i < TRC_COUNT; ++i) {
+        if (name == TRACE_EVENT_NAME[i]) return static_cast<TraceEvent>(i);
+    }
+    return TRC_NONE;
+}
+
+std::string TraceRecord::toString() const {
+    const auto ev = static_cast<TraceEvent>(event);
+    const bool conflict = flags != 0;
+    ostringstream str;
+    str << setw(8) << left << traceEventName(ev) << " r" << setw(5) << left << routine << " ";
+    switch (ev) {
+    case TRC_SEARCH:
+        str << address() << " " << (flags ? "call" : "jump") << ", queue = " << value;
+        break;
+    case TRC_CALL:
+        str << address();
+        if (value) str << ", reclaimed from r" << value;
+        break;
+    case TRC_JUMP:
+    case TRC_SEED:
+        str << address();
+        break;
+    case TRC_CLAIM:
+    case TRC_DATA:
+        str << address() << ", " << value << " bytes";
+        break;
+    case TRC_CODEMAP:
+        str << address() << " -> " << auxAddress() << (conflict ? " conflict" : "");
+        break;
+    case TRC_DATAMAP:
+    case TRC_STACKMAP:
+        str << signedHexVal(static_cast<SWord>(aux)) << " -> " << signedHexVal(static_cast<SWord>(value)) << (conflict ? " conflict" : "");
+        break;
+    case TRC_MISMATCH:
+        str << address() << " != " << auxAddress() << ", " << (flags < 3 ? SKIP_NAME[flags] : "???");
+        break;
+    default:
+        str << hexVal(addr) << " " << hexVal(aux) << " " << hexVal(value) << " " << hexVal(flags);
+        break;
+    }
+    return str.str();
+}
+
+TraceWriter *traceOut = nullptr;
+
+void traceOpen(const std::string &path) {
+    traceClose();
+    traceOut = new TraceWriter(path);
+}
+
+void traceClose() {
+    delete traceOut;
+    traceOut = nullptr;
+}
+
+TraceWriter::TraceWriter(const std::string &path) : records_(nullptr), count_(0), capacity_(0) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) throw IoError("Unable to create trace file " + path);
+    try {
+        map(TRACE_CHUNK);
+    }
+    catch (...) {
+        close(fd_);
+        throw;
+    }
+    auto header = reinterpret_cast<TraceHeader*>(records_) - 1;
+    memcpy(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header->version = TRACE_VERSION;
+    header->count = 0;
+}
+
+TraceWriter::~TraceWriter() {
+    // not mapped if growing the file failed
+    if (records_) {
+        auto header = reinterpret_cast<TraceHeader*>(records_) - 1;
+        header->count = static_cast<DWord>(count_);
+        unmap();
+    }
+    // failing to truncate leaves empty records at the end, which the reader skips anyway
+    const int ret = ftruncate(fd_, sizeof(TraceHeader) + count_ * sizeof(TraceRecord));
+    (void)ret;
+    close(fd_);
+}
+
+void TraceWriter::map(const Size capacity) {
+    const Size size = sizeof(TraceHeader) + capacity * sizeof(TraceRecord);
+    if (ftruncate(fd_, size) != 0) throw IoError("Unable to extend trace file");
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mem == MAP_FAILED) throw IoError("Unable to map trace file");
+    records_ = reinterpret_cast<TraceRecord*>(static_cast<TraceHeader*>(mem) + 1);
+    capacity_ = capacity;
+}
+
+void TraceWriter::unmap() {
+    if (!records_) return;
+    munmap(reinterpret_cast<TraceHeader*>(records_) - 1, sizeof(TraceHeader) + capacity_ * sizeof(TraceRecord));
+    records_ = nullptr;
+}
+
+void TraceWriter::grow() {
+    const Size capacity = capacity_ + TRACE_CHUNK;
+    unmap();
+    map(capacity);
+}
+
+TraceReader::TraceReader(const std::string &path) : mapSize_(0), data_(nullptr), records_(nullptr), count_(0) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) throw IoError("Unable to open trace file " + path);
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || static_cast<Size>(st.st_size) < sizeof(TraceHeader)) {
+        close(fd_);
+        throw IoError("Trace file too small: " + path);
+    }
+    mapSize_ = st.st_size;
+    void *mem = mmap(nullptr, mapSize_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (mem == MAP_FAILED) {
+        close(fd_);
+        throw IoError("Unable to map trace file " + path);
+    }
+    data_ = static_cast<const Byte*>(mem);
+    auto header = reinterpret_cast<const TraceHeader*>(data_);
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header->version != TRACE_VERSION) {
+        munmap(mem, mapSize_);
+        close(fd_);
+        throw IoError("Not a trace file or unsupported version: " + path);
+    }
+    records_ = reinterpret_cast<const TraceRecord*>(header + 1);
+    const Size maxCount = (mapSize_ - sizeof(TraceHeader)) / sizeof(TraceRecord);
+    count_ = header->count;
+    // trace of an interrupted run, use all records up to the empty space at the end of the last mapped chunk
+    if (count_ == 0 || count_ > maxCount) {
+        count_ = maxCount;
+        while (count_ > 0 && records_[count_ - 1].event == TRC_NONE) count_--;
+    }
+}
+
+TraceReader::~TraceReader() {
+    munmap(const_cast<Byte*>(data_), mapSize_);
+    close(fd_);
+}
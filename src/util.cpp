@@ -7,6 +7,7 @@
 #include <sys/stat.h>
 
 #include "dos/util.h"
+#include "dos/format.h"
 #include "dos/output.h"
 #include "dos/error.h"
 
@@ -55,87 +56,53 @@ void hexDump(const Byte *buf, const Size size, const Size off, const bool header
 }
 
 std::string signedHexVal(const SByte val, bool plus) {
-    ostringstream str;
-    if (val >= 0) {
-        if (plus) str << "+";
-        str << "0x" << hex << setw(2) << setfill('0') << (int)(val);
-    }
-    else str << "-0x" << hex << setw(2) << setfill('0') << (int)(~val + 1);
-    return str.str();
+    char buf[HEX_STRMAX];
+    return string(buf, formatSignedHex(buf, val, plus));
 }
 
 std::string signedHexVal(const SWord val, bool plus) {
-    ostringstream str;
-    if (val >= 0) {
-        if (plus) str << "+";
-        str << "0x" << hex << setw(4) << setfill('0') << val;
-    }
-    else str << "-0x" << hex << setw(4) << setfill('0') << ~val + 1;
-    return str.str();
+    char buf[HEX_STRMAX];
+    return string(buf, formatSignedHex(buf, val, plus));
 }
 
-// TODO: templatize
 std::string hexVal(const Byte val, bool prefix, bool pad) {
-    std::ostringstream str;
-    if (prefix) str << "0x";
-    if (pad) str << std::setw(2) << std::setfill('0');
-    str << std::hex << (int)val;
-    return str.str();
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, val, prefix, pad));
 }
 
 std::string hexVal(const SByte val, bool prefix, bool pad) {
-    std::ostringstream str;
-    if (prefix) str << "0x";
-    if (pad) str << std::setw(2) << std::setfill('0');
-    str << std::hex << (int)val;
-    return str.str();
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, val, prefix, pad));
 }
 
 std::string hexVal(const Word val, bool prefix, bool pad) {
-    std::ostringstream str;
-    if (prefix) str << "0x";
-    if (pad) str << std::setw(4) << std::setfill('0');
-    str << std::hex <<  val;
-    return str.str();    
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, val, prefix, pad));
 }
 
 std::string hexVal(const SWord val, bool prefix, bool pad) {
-    std::ostringstream str;
-    if (prefix) str << "0x";
-    if (pad) str << std::setw(4) << std::setfill('0');
-    str << std::hex << val;
-    return str.str();    
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, val, prefix, pad));
 }
 
 std::string hexVal(const DWord val, bool prefix, bool pad) {
-    std::ostringstream str;
-    if (prefix) str << "0x";
-    if (pad) str << std::setw(8) << std::setfill('0');
-    str << std::hex <<  val;
-    return str.str();    
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, val, prefix, pad));
 }
 
 std::string hexVal(const Offset val, const bool hdr, const int pad) {
-    std::ostringstream str;
-    if (hdr) str << "0x";
-    if (pad) str << setfill('0') << setw(pad);
-    str << hex <<  val;
-    return str.str();
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, val, hdr, pad));
 }
 
 std::string hexVal(SOffset val, const bool hdr, const int pad) {
-    std::ostringstream str;
-    if (val < 0) { str << "-"; val = -val; }
-    if (hdr) str << "0x";
-    if (pad) str << setfill('0') << setw(pad);
-    str << hex <<  val;
-    return str.str();
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, val, hdr, pad));
 }
 
 std::string hexVal(const void* ptr) {
-    ostringstream str;
-    str << "0x" << hex << reinterpret_cast<uint64_t>(ptr);
-    return str.str();
+    char buf[HEX_STRMAX];
+    return string(buf, formatHex(buf, static_cast<Offset>(reinterpret_cast<uintptr_t>(ptr))));
 }
 
 std::istream& safeGetline(std::istream& is, std::string& t) {
@@ -1,5 +1,6 @@
 #include <string>
 #include <algorithm>
+#include <limits>
 #include "debug.h"
 #include "gtest/gtest.h"
 #include "dos/util.h"
@@ -8,6 +9,10 @@
 #include "dos/analysis.h"
 #include "dos/opcodes.h"
 #include "dos/executable.h"
+#include "dos/trace.h"
+#include "dos/format.h"
+#include "dos/json.h"
+#include "dos/sink.h"
 
 using namespace std;
 
@@ -94,6 +99,17 @@ TEST_F(AnalysisTest, RegisterState) {
     ASSERT_EQ(rs.regString(REG_BH), "BH = ab"s);
     ASSERT_EQ(rs.regString(REG_BL), "BL = cd"s);    
     TRACELN(rs.toString());    
+
+    TRACELN("Marking BH and CX as unknown in bulk");
+    rs.setValue(REG_CX, 0x5678);
+    rs.setValue(REG_DX, 0x9abc);
+    rs.setUnknown(regMask(REG_BH) | regMask(REG_CX) | regMask(REG_NONE));
+    ASSERT_FALSE(rs.isKnown(REG_BH));
+    ASSERT_TRUE(rs.isKnown(REG_BL));
+    ASSERT_FALSE(rs.isKnown(REG_CX));
+    ASSERT_TRUE(rs.isKnown(REG_DX));
+    ASSERT_TRUE(rs.isKnown(REG_AL));
+    TRACELN(rs.toString());    
 }
 
 TEST_F(AnalysisTest, RoutineMap) {
@@ -225,6 +241,128 @@ TEST_F(AnalysisTest, FindFarRoutines) {
     ASSERT_EQ(far2.entrypoint().segment, loadSegment+1);    
 }
 
+TEST_F(AnalysisTest, FindRoutinesData) {
+    const vector<Byte> code = {
+        0x74, 0x03, // jz 0x5
+        0xe8, 0x03, 0x00, // call 0x8
+        0x0f,       // not an 8086 opcode
+        0xc3,       // ret
+        0x90,       // nop
+        0xb8, 0x01  // truncated mov ax,imm
+    };
+    Executable exe{0, code};
+    const RoutineMap map = exe.findRoutines();
+    // the call leads into data, which does not make a routine
+    ASSERT_EQ(map.size(), 1);
+    const vector<Block> expected = { Block{0x5}, Block{0x8, 0x9} };
+    ASSERT_EQ(map.getDataBlocks(), expected);
+    // none of the suspected data is claimed by the routines
+    for (const Block &b : expected) ASSERT_FALSE(map.getRoutine(b.begin).isValid());
+    // the blocks survive saving and loading the map
+    const string path = "data.map";
+    map.save(path, 0, true);
+    const RoutineMap loaded{path};
+    ASSERT_EQ(loaded.getDataBlocks(), expected);
+    ASSERT_EQ(loaded.size(), map.size());
+    deleteFile(path);
+}
+
+TEST_F(AnalysisTest, InstructionStore) {
+    MzImage mz{"bin/hello.exe"};
+    mz.load(0x1000);
+    Executable exe{mz};
+    const RoutineMap map = exe.findRoutines();
+    const InstructionStore &store = exe.instructions();
+    ASSERT_GT(store.size(), 0);
+    // everything was decoded exactly once
+    ASSERT_EQ(store.misses(), store.size());
+    const Size decoded = store.size(), hits = store.hits();
+    // a second pass is served entirely from the store
+    exe.findRoutines();
+    ASSERT_EQ(store.size(), decoded);
+    ASSERT_EQ(store.misses(), decoded);
+    ASSERT_GT(store.hits(), hits);
+    // and the stored instructions are the same as freshly decoded ones
+    for (Size i = 0; i < map.size(); ++i) {
+        for (const Block &b : map.getRoutine(i).reachable) {
+            for (Address a = b.begin; a <= b.end; ) {
+                const Instruction stored = exe.instruction(a), fresh{a, exeCode(exe).pointer(a)};
+                ASSERT_EQ(stored.toString(), fresh.toString());
+                ASSERT_EQ(stored.length, fresh.length);
+                a += stored.length;
+            }
+        }
+    }
+    ASSERT_EQ(store.size(), decoded);
+}
+
+TEST_F(AnalysisTest, FindPrologues) {
+    const vector<Byte> code = {
+        0xB8,0x01,0x00, // mov ax,1
+        0xC3,           // ret
+        0x55,0x8B,0xEC, // push bp; mov bp,sp
+        0x5D,0xC3,      // pop bp; ret
+        0x55,0x89,0xE5, // push bp; mov bp,sp (alternate encoding)
+        0x5D,0xC3,      // pop bp; ret
+        0x55,0x8B       // truncated
+    };
+    const vector<Offset> expected = { 4, 9 };
+    ASSERT_EQ(findPrologues(code.data(), code.size()), expected);
+    // unreachable from the entrypoint, only found when seeded from the prologues
+    Executable e1{0, code}, e2{0, code};
+    ASSERT_EQ(e1.findRoutines().size(), 1);
+    const RoutineMap map = e2.findRoutines(true);
+    ASSERT_EQ(map.size(), 3);
+    ASSERT_TRUE(map.findByEntrypoint(Address{0, 4}).isValid());
+    ASSERT_TRUE(map.findByEntrypoint(Address{0, 9}).isValid());
+    // enter with a nesting level of 0, only a prologue from the 80186 on
+    const vector<Byte> enterCode = {
+        0x55,0x8B,0xEC,      // push bp; mov bp,sp
+        0xC8,0x04,0x00,0x00, // enter 0x4,0x0
+        0xC8,0x04,0x00,0x01, // enter 0x4,0x1
+        0xC9,0xC3,           // leave; ret
+        0xC8,0x02,0x00       // truncated
+    };
+    const vector<Offset> expected186 = { 0, 3 };
+    ASSERT_EQ(findPrologues(enterCode.data(), enterCode.size()), vector<Offset>{ 0 });
+    ASSERT_EQ(findPrologues(enterCode.data(), enterCode.size(), CPU_80186), expected186);
+}
+
+TEST_F(AnalysisTest, Trace) {
+    const string path = "hello.trace";
+    MzImage mz{"bin/hello.exe"};
+    mz.load(0x1000);
+    Executable exe{mz};
+    traceOpen(path);
+    const RoutineMap map = exe.findRoutines();
+    // enough records to need more than the initially mapped chunk of the file
+    for (int i = 0; i < 0x10000; ++i) trace(TRC_JUMP, Address(0x1000, i & 0xffff), 0xab);
+    const Size written = traceOut->count();
+    traceClose();
+
+    TraceReader reader{path};
+    ASSERT_EQ(reader.size(), written);
+    Size searches = 0, claims = 0, calls = 0;
+    for (const auto &rec : reader) {
+        TRACELN(rec.toString());
+        switch (rec.event) {
+        case TRC_SEARCH: searches++; break;
+        case TRC_CLAIM: claims++; ASSERT_GT(rec.value, 0); break;
+        case TRC_CALL: calls++; break;
+        }
+    }
+    ASSERT_GT(searches, 0);
+    ASSERT_GT(claims, 0);
+    // the entrypoint routine is seeded and not recorded as a call
+    ASSERT_EQ(calls + 1, map.size());
+    const TraceRecord &last = *(reader.end() - 1);
+    ASSERT_EQ(last.event, TRC_JUMP);
+    ASSERT_EQ(last.routine, 0xab);
+    ASSERT_EQ(last.address(), Address(0x1000, 0xffff));
+    ASSERT_EQ(last.toString(), "jump     r171   1000:ffff/01ffff");
+    deleteFile(path);
+}
+
 TEST_F(AnalysisTest, RoutineMapCollision) {
     const string path = "bad.map";
     RoutineMap rm = emptyRoutineMap();
@@ -317,6 +455,83 @@ TEST_F(AnalysisTest, CodeCompareSkip) {
     ASSERT_TRUE(e3.compareCode(RoutineMap{}, e2, opt));
 }
 
+TEST_F(AnalysisTest, CodeCompareRecords) {
+    const vector<Byte> refCode = {
+        0x90, // nop
+        0x41, // inc cx
+        0xa1, 0x10, 0x00, // mov ax, [0x10]
+    };
+    const vector<Byte> tgtCode = {
+        0x9c, // pushf
+        0x41, // inc cx
+        0xa1, 0x20, 0x00, // mov ax, [0x20]
+    };
+    Executable e1{0, refCode}, e2{0, tgtCode};
+    ostringstream str;
+    StreamSink sink{str};
+    JsonWriter records{sink};
+    AnalysisOptions opt;
+    opt.refSkip = 1;
+    opt.tgtSkip = 1;
+    opt.strict = false;
+    opt.records = &records;
+    ASSERT_TRUE(e1.compareCode(RoutineMap{}, e2, opt));
+    sink.flush();
+    TRACELN(str.str());
+    // one line per record: the routine entry, three skips until the targets line up again, two compared pairs and the result
+    const vector<string> lines = splitString(str.str(), '\n');
+    ASSERT_EQ(records.count(), 7);
+    ASSERT_GE(lines.size(), records.count());
+    ASSERT_EQ(lines[0], R"({"type":"routine","event":"enter","name":"unknown","ref":"0000:0000","tgt":"0000:0000"})");
+    ASSERT_EQ(lines[1], R"({"type":"skip","ref":"0000:0000","tgt":"0000:0000","refbytes":"90","tgtbytes":"9c","refinstr":"nop","tgtinstr":"pushf","result":"ref"})");
+    ASSERT_EQ(lines[2], R"({"type":"skip","ref":"0000:0001","tgt":"0000:0000","refbytes":"41","tgtbytes":"9c","refinstr":"inc cx","tgtinstr":"pushf","result":"tgt"})");
+    ASSERT_EQ(lines[4], R"({"type":"compare","ref":"0000:0001","tgt":"0000:0001","refbytes":"41","tgtbytes":"41","refinstr":"inc cx","tgtinstr":"inc cx","result":"match"})");
+    ASSERT_EQ(lines[5], R"({"type":"compare","ref":"0000:0002","tgt":"0000:0002","refbytes":"a11000","tgtbytes":"a12000","refinstr":"mov ax, [0x10]","tgtinstr":"mov ax, [0x20]","result":"diffval","mapseg":"DS","mapref":16,"maptgt":32})");
+    ASSERT_EQ(lines[6], R"({"type":"result","match":true,"compared":5,"routines":0})");
+    // values without a JSON representation become null
+    ostringstream numStr;
+    StreamSink numSink{numStr};
+    JsonWriter{numSink}.begin("num").field("a", 1.5).field("b", numeric_limits<double>::infinity()).field("c", numeric_limits<double>::quiet_NaN()).end();
+    numSink.flush();
+    ASSERT_EQ(numStr.str(), R"({"type":"num","a":1.500,"b":null,"c":null})" "\n");
+}
+
+TEST_F(AnalysisTest, CodeCompareStats) {
+    MzImage mz{"bin/hello.exe"};
+    mz.load(0);
+    Executable e1{mz}, e2{mz};
+    auto map = RoutineMap{"hello.map"};
+    CompareStats stats;
+    AnalysisOptions opt;
+    opt.stats = &stats;
+    // identical executables never need the decoded comparison, and every block is identical to its end
+    ASSERT_TRUE(e1.compareCode(map, e2, opt));
+    TRACELN(stats.toString());
+    ASSERT_GT(stats.instructions, 0);
+    ASSERT_EQ(stats.spanMatches + stats.rawMatches, stats.instructions);
+    ASSERT_GT(stats.blocks, 0);
+    ASSERT_EQ(stats.fullBlocks, stats.blocks);
+
+    // without a map there are no blocks, instructions with identical bytes still match without decoding
+    const vector<Byte> refCode = {
+        0x41, // inc cx
+        0xa1, 0x10, 0x00, // mov ax, [0x10]
+        0x90, // nop
+    };
+    const vector<Byte> tgtCode = {
+        0x41, // inc cx
+        0xa1, 0x20, 0x00, // mov ax, [0x20]
+        0x90, // nop
+    };
+    Executable e3{0, refCode}, e4{0, tgtCode};
+    opt.strict = false;
+    ASSERT_TRUE(e3.compareCode(RoutineMap{}, e4, opt));
+    ASSERT_EQ(stats.instructions, 3);
+    ASSERT_EQ(stats.spanMatches, 0);
+    ASSERT_EQ(stats.rawMatches, 2);
+    ASSERT_EQ(stats.blocks, 0);
+}
+
 TEST_F(AnalysisTest, CodeCompareUnreachable) {
     // two blocks of identical code with an undefined opcode in the middle
     TRACELN("=== case 1");
@@ -380,6 +595,51 @@ TEST_F(AnalysisTest, SignedHex) {
     ASSERT_EQ(signedHexVal(neg8val), "-0x0a");
 }
 
+TEST_F(AnalysisTest, HexFormat) {
+    ASSERT_EQ(hexVal(Byte(0xa)), "0x0a");
+    ASSERT_EQ(hexVal(Byte(0xa), false, false), "a");
+    ASSERT_EQ(hexVal(SByte(-1)), "0xffffffff");
+    ASSERT_EQ(hexVal(Word(0xbc)), "0x00bc");
+    ASSERT_EQ(hexVal(SWord(-2)), "0xfffe");
+    ASSERT_EQ(hexVal(DWord(0x1234abcd), false), "1234abcd");
+    ASSERT_EQ(hexVal(Offset(0x1234), false, 6), "001234");
+    ASSERT_EQ(hexVal(Offset(0)), "0x0");
+    ASSERT_EQ(hexVal(SOffset(-0x10)), "-0x10");
+    ASSERT_EQ(signedHexVal(SByte(-128)), "-0x80");
+    ASSERT_EQ(signedHexVal(SWord(-32768)), "-0x8000");
+
+    char buf[BLOCK_STRMAX];
+    const Address addr{0x1234, 0xabcd};
+    ASSERT_EQ(string(buf, formatAddress(buf, addr)), "1234:abcd/01cf0d");
+    ASSERT_EQ(addr.toString(true), "1234:abcd");
+    ASSERT_EQ(Address().toString(), "(invalid)");
+    const Block block{Address(0x1000, 0x10), Address(0x1000, 0x2f)};
+    ASSERT_EQ(string(buf, formatBlock(buf, block)), "1000:0010-1000:002f/000020");
+    ASSERT_EQ(block.toString(true), "010010-01002f/000020");
+    ASSERT_EQ(Block().toString(), "[invalid]");
+
+    string str = "at ";
+    appendAddress(str, addr, true);
+    appendHex(str, Word(0x12), false);
+    appendSignedHex(str, SByte(-3));
+    ASSERT_EQ(str, "at 1234:abcd0012-0x03");
+}
+
+TEST_F(AnalysisTest, LazyOutput) {
+    const Address addr{0x1234, 0xabcd};
+    const Byte b = 0xf;
+    ASSERT_EQ(logString("at ", addr, ", value ", hexArg(b), ", count ", 42, '!', [](){ return "?"s; }), "at 1234:abcd/01cf0d, value 0x0f, count 42!?");
+
+    // formatting of arguments must not take place when the message is filtered out
+    bool called = false;
+    auto probe = [&](){ called = true; return "x"s; };
+    setModuleVisibility(LOG_OTHER, false);
+    ASSERT_FALSE(outputEnabled(LOG_OTHER, LOG_ERROR));
+    logOutput<LOG_ERROR>(LOG_OTHER, "suppressed ", probe);
+    setModuleVisibility(LOG_OTHER, true);
+    ASSERT_FALSE(called);
+}
+
 TEST_F(AnalysisTest, Variants) {
     ASSERT_EQ(splitString("a;bc;def", ';'), vector<string>({"a", "bc", "def"}));
     ASSERT_EQ(splitString("abcdef", ';'), vector<string>({"abcdef"}));
@@ -10,6 +10,7 @@
 #include "dos/util.h"
 #include "dos/interrupt.h"
 #include "dos/instruction.h"
+#include "dos/error.h"
 
 using namespace std;
 using ::testing::_;
@@ -106,6 +107,121 @@ TEST_F(CpuTest, Flags) {
     ASSERT_EQ(getReg(REG_FLAGS), 0x0);
 }
 
+TEST_F(CpuTest, ConditionalJump) {
+    const Byte code[] = {
+        OP_MOV_AX_Iv, 0x34, 0x12,   // 0: mov ax,0x1234
+        OP_JZ_Jb, 0x10,             // 3: jz 0x15
+        OP_JNZ_Jb, 0x03,            // 5: jnz 0xa
+        OP_NOP, OP_NOP, OP_NOP,
+        OP_JNZ_Jb, 0xf4,            // a: jnz 0x0
+    };
+    const Word codeSeg = 0x1010; // past a PSP at a segment boundary
+    mem_->writeBuf(SEG_TO_OFFSET(codeSeg), code, sizeof(code));
+    cpu_->init(Address{codeSeg, 0}, Address{0x2000, 0}, sizeof(code));
+    regs_->setFlag(FLAG_ZERO, false);
+    // ip moves past the executed instruction, or to the jump target relative to the end of the jump
+    const Word ips[] = { 0x3, 0x5, 0xa, 0x0 };
+    for (const Word ip : ips) {
+        cpu_->step();
+        ASSERT_EQ(getReg(REG_IP), ip);
+    }
+    ASSERT_EQ(getReg(REG_AX), 0x1234);
+    // the jump is taken on the flag, not the other way around
+    regs_->setFlag(FLAG_ZERO, true);
+    setReg(REG_IP, 3);
+    cpu_->step();
+    ASSERT_EQ(getReg(REG_IP), 0x15);
+    setReg(REG_IP, 5);
+    cpu_->step();
+    ASSERT_EQ(getReg(REG_IP), 0x7);
+}
+
+TEST_F(CpuTest, CodeAfterFork) {
+    const Byte code[] = { OP_JNZ_Jb, 0x10 };
+    const Word codeSeg = 0x1010; // past a PSP at a segment boundary
+    const Offset codeStart = SEG_TO_OFFSET(codeSeg);
+    mem_->writeBuf(codeStart, code, sizeof(code));
+    cpu_->init(Address{codeSeg, 0}, Address{0x2000, 0}, sizeof(code));
+    regs_->setFlag(FLAG_ZERO, false);
+    // the first write after taking a snapshot replaces the flat buffer the code is executed from
+    {
+        const Memory snapshot = mem_->snapshot();
+        mem_->writeByte(codeStart + 1, 0x20);
+        cpu_->step();
+        ASSERT_EQ(getReg(REG_IP), 0x22);
+        // and the original code is executed again after going back to the snapshot
+        mem_->restore(snapshot);
+        setReg(REG_IP, 0);
+        cpu_->step();
+        ASSERT_EQ(getReg(REG_IP), 0x12);
+    }
+    // the code remains valid after the snapshot is gone
+    Memory fork = mem_->fork();
+    mem_->writeByte(codeStart + 1, 0x30);
+    fork = Memory{};
+    setReg(REG_IP, 0);
+    cpu_->step();
+    ASSERT_EQ(getReg(REG_IP), 0x32);
+}
+
+TEST_F(CpuTest, AccessMap) {
+    const Byte code[] = {
+        OP_MOV_AL_Ob, 0x10, 0x00,       // mov al,[0x10]
+        OP_MOV_Ov_AX, 0x20, 0x00,       // mov [0x20],ax
+        OP_MOV_BX_Iv, 0x30, 0x00,       // mov bx,0x30
+        OP_MOV_Eb_Ib, 0x07, 0x55,       // mov byte [bx],0x55
+        OP_MOV_Gv_Ev, 0x4f, 0x02,       // mov cx,[bx+0x2]
+        // the operands follow the segment override prefix
+        OP_PREFIX_ES, OP_MOV_AX_Ov, 0x40, 0x00,             // mov ax,es:[0x40]
+        OP_PREFIX_ES, OP_MOV_Ev_Gv, 0x47, 0x04,             // mov es:[bx+0x4],ax
+        OP_PREFIX_ES, OP_MOV_Eb_Ib, 0x06, 0x50, 0x00, 0x77, // mov byte es:[0x50],0x77
+    };
+    const Word codeSeg = 0x1010; // past a PSP at a segment boundary
+    const Offset codeStart = SEG_TO_OFFSET(codeSeg);
+    mem_->writeBuf(codeStart, code, sizeof(code));
+    mem_->enableAccessMap();
+    cpu_->init(Address{codeSeg, 0}, Address{0x2000, 0}, sizeof(code));
+    // data is relative to ds, which points at the PSP
+    const Offset dataStart = SEG_TO_OFFSET(getReg(REG_DS));
+    mem_->writeByte(dataStart + 0x10, 0xab);
+    mem_->writeWord(dataStart + 0x32, 0x1234);
+    const Word extraSeg = 0x3000;
+    const Offset extraStart = SEG_TO_OFFSET(extraSeg);
+    setReg(REG_ES, extraSeg);
+    mem_->writeWord(extraStart + 0x40, 0x5678);
+    const Word ax = static_cast<Word>((getReg(REG_AX) & 0xff00) | 0xab);
+    for (Size i = 0; i < 8; ++i) cpu_->step();
+    ASSERT_EQ(getReg(REG_IP), sizeof(code));
+    ASSERT_EQ(getReg(REG_BX), 0x30);
+    ASSERT_EQ(getReg(REG_CX), 0x1234);
+    ASSERT_EQ(getReg(REG_AX), 0x5678);
+    ASSERT_EQ(mem_->readWord(dataStart + 0x20), ax);
+    ASSERT_EQ(mem_->readByte(dataStart + 0x30), 0x55);
+    ASSERT_EQ(mem_->readWord(extraStart + 0x34), 0x5678);
+    ASSERT_EQ(mem_->readByte(extraStart + 0x50), 0x77);
+
+    const AccessMap *access = mem_->accessMap();
+    const Block all{0, MEM_TOTAL - 1};
+    auto exec = access->blocks(ACCESS_EXEC, all);
+    ASSERT_EQ(exec.size(), 1);
+    ASSERT_EQ(exec[0], Block(codeStart, codeStart + sizeof(code) - 1));
+    auto data = access->dataBlocks(all);
+    ASSERT_EQ(data.size(), 7);
+    ASSERT_EQ(data[0], Block(dataStart + 0x10, dataStart + 0x10));
+    ASSERT_EQ(data[1], Block(dataStart + 0x20, dataStart + 0x21));
+    ASSERT_EQ(data[2], Block(dataStart + 0x30, dataStart + 0x30));
+    ASSERT_EQ(data[3], Block(dataStart + 0x32, dataStart + 0x33));
+    ASSERT_EQ(data[4], Block(extraStart + 0x34, extraStart + 0x35));
+    ASSERT_EQ(data[5], Block(extraStart + 0x40, extraStart + 0x41));
+    ASSERT_EQ(data[6], Block(extraStart + 0x50, extraStart + 0x50));
+    ASSERT_TRUE(access->test(dataStart + 0x10, ACCESS_READ));
+    ASSERT_FALSE(access->test(dataStart + 0x10, ACCESS_WRITE));
+    ASSERT_TRUE(access->test(dataStart + 0x20, ACCESS_WRITE));
+    ASSERT_FALSE(access->test(dataStart + 0x20, ACCESS_READ));
+    ASSERT_TRUE(access->test(extraStart + 0x40, ACCESS_READ));
+    ASSERT_TRUE(access->test(extraStart + 0x50, ACCESS_WRITE));
+}
+
 TEST_F(CpuTest, DISABLED_Arithmetic) {
     // TODO: implement an assembler to generate code from a vector of structs
     const Byte code[] = {
@@ -441,6 +557,224 @@ TEST_F(CpuTest, Instruction) {
         ASSERT_EQ(ins.length, lengths[i]);
         codeofs += ins.length;
     }
+
+    // formatting all instructions into one buffer yields the same text, without reallocating it
+    std::string listing, expected;
+    listing.reserve(1024);
+    const char *data = listing.data();
+    codeofs = 0;
+    for (int i = 0; i < icount; ++i) {
+        Instruction ins(Address(0, codeofs), code + codeofs);
+        ins.format(listing);
+        listing += '\n';
+        expected += instructions[i] + '\n';
+        codeofs += ins.length;
+    }
+    ASSERT_EQ(listing, expected);
+    ASSERT_EQ(listing.data(), data);
+}
+
+TEST_F(CpuTest, OpcodeTable) {
+    // the descriptors merge the per-property tables, check a few representative opcodes
+    const OpcodeDesc &mov = opcodeDesc(OP_MOV_AX_Iv);
+    ASSERT_EQ(mov.iclass, INS_MOV);
+    ASSERT_EQ(mov.op1, OPR_REG_AX);
+    ASSERT_EQ(mov.op2, OPR_IMM16);
+    ASSERT_EQ(mov.size2, OPRSZ_WORD);
+    ASSERT_EQ(mov.immSize, 2);
+    ASSERT_FALSE(mov.modrm);
+    const OpcodeDesc &movModrm = opcodeDesc(OP_MOV_Ev_Iv);
+    ASSERT_TRUE(movModrm.modrm);
+    ASSERT_FALSE(movModrm.isGroup);
+    ASSERT_EQ(movModrm.modop1, MODRM_Ev);
+    ASSERT_EQ(movModrm.immSize, 2);
+    const OpcodeDesc &grp = opcodeDesc(OP_GRP1_Eb_Ib);
+    ASSERT_TRUE(grp.modrm && grp.isGroup);
+    ASSERT_EQ(grp.group, IGRP_1);
+    ASSERT_EQ(grp.size1, OPRSZ_BYTE);
+    ASSERT_EQ(grp.immSize, 1);
+    ASSERT_EQ(opcodeDesc(OP_CALL_Ap).immSize, 4);
+    ASSERT_TRUE(opcodeDesc(OP_PREFIX_ES).segPrefix);
+    // consistent with the accessors
+    for (int op = 0; op < 0x100; ++op) {
+        ASSERT_EQ(opcodeDesc(op).modrm, opcodeIsModrm(op));
+        ASSERT_EQ(opcodeDesc(op).iclass, instr_class(op));
+    }
+}
+
+TEST_F(CpuTest, InstructionLength) {
+    // agrees with the full decoder for every opcode and modrm byte, with and without a prefix, on every CPU level
+    Byte code[8] = { 0, 0, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc };
+    const Byte prefixes[] = { OP_NOP, OP_REPZ, OP_PREFIX_ES };
+    for (const CpuLevel cpu : { CPU_8086, CPU_80186 }) {
+        Size decoded = 0;
+        for (const Byte prefix : prefixes) {
+            const Size start = prefix == OP_NOP ? 1 : 0;
+            code[0] = prefix;
+            for (int op = 0; op < 0x100; ++op) {
+                code[1] = op;
+                // the modrm opcodes of the 80186 are not covered by opcodeIsModrm()
+                for (int modrm = 0; modrm < (opcodeIsModrm(op) || cpu != CPU_8086 ? 0x100 : 1); ++modrm) {
+                    code[2] = modrm;
+                    const Size length = ::instructionLength(code + start, cpu);
+                    const Instruction ins{Address{0x1000, 0}, code + start, INSTRUCTION_MAX, cpu};
+                    ASSERT_EQ(length != 0, ins.isValid()) << cpu_level_name(cpu) << " opcode " << hexVal(static_cast<Byte>(op)) << ", modrm " << hexVal(static_cast<Byte>(modrm));
+                    if (length == 0) continue;
+                    ASSERT_EQ(length, ins.length) << cpu_level_name(cpu) << " opcode " << hexVal(static_cast<Byte>(op)) << ", modrm " << hexVal(static_cast<Byte>(modrm));
+                    decoded++;
+                }
+            }
+        }
+        ASSERT_GT(decoded, 0x8000);
+    }
+    const Byte test[] = { 0xf6, 0x06, 0x34, 0x12, 0x56 }; // test byte [0x1234],0x56
+    ASSERT_EQ(::instructionLength(test), 5);
+    const Byte testWord[] = { 0xf7, 0x47, 0x02, 0x34, 0x12 }; // test word [bx+0x2],0x1234
+    ASSERT_EQ(::instructionLength(testWord), 5);
+    const Byte badGroup[] = { 0xfe, 0x10 }; // group 4 has no instruction for GRP field 2
+    ASSERT_EQ(::instructionLength(badGroup), 0);
+    const Byte badSegReg[] = { 0x8e, 0xf0 }; // mov with no segment register for REG field 6
+    ASSERT_EQ(::instructionLength(badSegReg), 0);
+    const Byte lesReg[] = { 0xc4, 0xc0 }; // les needs a memory operand
+    ASSERT_EQ(::instructionLength(lesReg), 0);
+
+    const Byte sweep[] = {
+        0x55,             // push bp
+        0x8b, 0xec,       // mov bp,sp
+        0x26, 0xc4, 0x1e, 0x34, 0x12, // les bx,es:[0x1234]
+        0x0f,             // not an 8086 opcode, skipped
+        0xc3,             // ret
+        0xb8, 0x01,       // truncated mov ax,imm
+    };
+    vector<Byte> bitmap;
+    ASSERT_EQ(instructionBoundaries(sweep, sizeof(sweep), bitmap), 4);
+    ASSERT_EQ(bitmap.size(), 2);
+    const Offset starts[] = { 0, 1, 3, 9 };
+    Size found = 0;
+    for (Offset off = 0; off < sizeof(sweep); ++off) {
+        if (!isInstructionBoundary(bitmap, off)) continue;
+        ASSERT_LT(found, sizeof(starts) / sizeof(starts[0]));
+        ASSERT_EQ(off, starts[found++]);
+    }
+    ASSERT_EQ(found, 4);
+
+    // same result as a plain sweep over a buffer spanning several of the chunks it is processed in
+    vector<Byte> noise(10000);
+    DWord seed = 1;
+    for (Byte &b : noise) b = (seed = seed * 1103515245 + 12345) >> 16;
+    ASSERT_GT(instructionBoundaries(noise.data(), noise.size(), bitmap), 0);
+    Offset off = 0;
+    while (off + INSTRUCTION_PEEK <= noise.size()) {
+        const Byte length = ::instructionLength(noise.data() + off);
+        const Offset next = off + (length ? length : 1);
+        if (next > noise.size()) break;
+        ASSERT_EQ(isInstructionBoundary(bitmap, off), length != 0) << "offset " << off;
+        for (++off; off < next; ++off) ASSERT_FALSE(isInstructionBoundary(bitmap, off)) << "offset " << off;
+    }
+}
+
+TEST_F(CpuTest, CpuLevel) {
+    const Address addr{0x1000, 0};
+    const vector<vector<Byte>> code = {
+        { 0x60 },                               // pusha
+        { 0x61 },                               // popa
+        { 0x62, 0x06, 0x34, 0x12 },             // bound ax,[0x1234]
+        { 0x68, 0x34, 0x12 },                   // push 0x1234
+        { 0x69, 0xc3, 0x34, 0x12 },             // imul ax,bx,0x1234
+        { 0x6a, 0x05 },                         // push 0x5
+        { 0x6b, 0x47, 0x02, 0x0a },             // imul ax,[bx+0x2],0xa
+        { 0x6c }, { 0x6d }, { 0x6e }, { 0x6f }, // insb, insw, outsb, outsw
+        { 0xc0, 0xe0, 0x04 },                   // shl al,0x4
+        { 0xc1, 0x2e, 0x34, 0x12, 0x03 },       // shr word [0x1234],0x3
+        { 0xc8, 0x10, 0x00, 0x00 },             // enter 0x10,0x0
+        { 0xc9 },                               // leave
+    };
+    const vector<string> expected = {
+        "pusha", "popa", "bound ax, [0x1234]", "push 0x1234", "imul ax, bx, 0x1234", "push 0x5", "imul ax, [bx+0x02], 0xa",
+        "insb", "insw", "outsb", "outsw", "shl al, 0x4", "shr word [0x1234], 0x3", "enter 0x10, 0x0", "leave"
+    };
+    ASSERT_EQ(code.size(), expected.size());
+    for (Size i = 0; i < code.size(); ++i) {
+        const Instruction i186{addr, code[i].data(), code[i].size(), CPU_80186};
+        ASSERT_EQ(i186.status, INS_STATUS_OK) << expected[i];
+        ASSERT_EQ(i186.toString(), expected[i]);
+        ASSERT_EQ(i186.length, code[i].size()) << expected[i];
+        ASSERT_EQ(::instructionLength(code[i].data(), CPU_80286), code[i].size()) << expected[i];
+        // none of these exist on the 8086
+        ASSERT_EQ(Instruction(addr, code[i].data(), code[i].size()).status, INS_STATUS_INVALID) << expected[i];
+        ASSERT_EQ(::instructionLength(code[i].data()), 0) << expected[i];
+    }
+    // the immediate of the three-operand imul takes part in matching and in the fingerprint
+    const Byte imul1[] = { 0x6b, 0xc3, 0x0a }, imul2[] = { 0x6b, 0xc3, 0x0b };
+    const Instruction i1{addr, imul1, sizeof(imul1), CPU_80186}, i2{addr, imul2, sizeof(imul2), CPU_80186};
+    ASSERT_EQ(i1.match(i2), INS_MATCH_DIFFOP1);
+    ASSERT_EQ(i1.fingerprint, i2.fingerprint);
+    ASSERT_NE(i1.valueFingerprint(), i2.valueFingerprint());
+    ASSERT_EQ(Instruction{i1.record()}.toString(), "imul ax, bx, 0xa");
+    const RegisterEffect effect = i1.registerEffect();
+    ASSERT_EQ(effect.read, regMask(REG_BX));
+    ASSERT_EQ(effect.write, regMask(REG_AX) | regMask(REG_FLAGS));
+
+    ASSERT_EQ(cpuLevel("186"), CPU_80186);
+    ASSERT_EQ(cpuLevel("80286"), CPU_80286);
+    ASSERT_EQ(cpuLevel("CPU_8086"), CPU_8086);
+    ASSERT_THROW(cpuLevel("386"), ArgError);
+}
+
+TEST_F(CpuTest, InstructionStatus) {
+    const Address addr{0x1000, 0};
+    const Byte valid[] = { 0xb8, 0x34, 0x12 }; // mov ax,0x1234
+    ASSERT_EQ(Instruction(addr, valid, sizeof(valid)).status, INS_STATUS_OK);
+    // invalid encodings decode without throwing
+    const Byte badOpcode[] = { 0x0f, 0x00 }; // not an 8086 opcode
+    Instruction i{addr, badOpcode};
+    ASSERT_EQ(i.status, INS_STATUS_INVALID);
+    ASSERT_FALSE(i.isValid());
+    ASSERT_EQ(i.length, 1);
+    const Byte badGroup[] = { 0xff, 0xf8 }; // group 5 has no instruction for GRP field 7
+    i = Instruction{addr, badGroup};
+    ASSERT_EQ(i.status, INS_STATUS_INVALID);
+    ASSERT_EQ(i.length, 2);
+    ASSERT_EQ(i.registerEffect().write, 0);
+    const Byte farJumpReg[] = { 0xff, 0xe8 }; // far jump needs a memory operand
+    ASSERT_EQ(Instruction(addr, farJumpReg).status, INS_STATUS_INVALID);
+    // encodings which do not fit into the available bytes
+    ASSERT_EQ(Instruction(addr, valid, 2).status, INS_STATUS_TRUNCATED);
+    const Byte prefixOnly[] = { 0x26 }; // segment prefix at the end of the buffer
+    ASSERT_EQ(Instruction(addr, prefixOnly, sizeof(prefixOnly)).status, INS_STATUS_TRUNCATED);
+    // the status survives the instruction record
+    i = Instruction{addr, valid, 2};
+    ASSERT_EQ(Instruction(i.record()).status, INS_STATUS_TRUNCATED);
+}
+
+TEST_F(CpuTest, InstructionRecord) {
+    ASSERT_LE(sizeof(InstructionRecord), 16);
+    const Address a{0x1000, 0x20};
+    const Byte callFar[] = { 0x9a, 0x78, 0x56, 0x34, 0x12 }; // call far 0x1234:0x5678
+    const Byte movMemImm[] = { 0x26, 0xc7, 0x80, 0x34, 0x12, 0x78, 0x56 }; // mov word es:[bx+si+0x1234], 0x5678
+    const Byte testImm[] = { 0xf6, 0x46, 0xfe, 0x80 }; // test byte [bp-0x2], 0x80
+    for (const Byte *code : { callFar, movMemImm, testImm }) {
+        const Instruction ins{a, code};
+        const Instruction unpacked{ins.record()};
+        ASSERT_EQ(unpacked.toString(), ins.toString());
+        ASSERT_EQ(unpacked.length, ins.length);
+        ASSERT_EQ(unpacked.prefix, ins.prefix);
+        ASSERT_EQ(unpacked.addr, ins.addr);
+        ASSERT_EQ(unpacked.match(ins), INS_MATCH_FULL);
+    }
+    // every valid opcode with a few modrm bytes covering the displacement sizes
+    Byte code[8] = { 0, 0, 0x9a, 0xbc, 0xde, 0xf0, 0x12, 0x34 };
+    for (int op = 0; op < 0x100; ++op) {
+        code[0] = op;
+        for (const Byte modrm : { 0x06, 0x47, 0x9a, 0xc3 }) {
+            code[1] = modrm;
+            if (::instructionLength(code) == 0) continue;
+            const Instruction ins{a, code};
+            ASSERT_EQ(Instruction{ins.record()}.toString(), ins.toString());
+            ASSERT_EQ(Instruction{ins.record()}.fingerprint, ins.fingerprint);
+            ASSERT_EQ(Instruction{ins.record()}.valueFingerprint(), ins.valueFingerprint());
+        }
+    }
 }
 
 TEST_F(CpuTest, InstructionMatch) {
@@ -454,6 +788,77 @@ TEST_F(CpuTest, InstructionMatch) {
     ASSERT_EQ(i2.match(i1), INS_MATCH_MISMATCH);
 }
 
+TEST_F(CpuTest, InstructionFingerprint) {
+    const Address a{0x1000, 0x0};
+    const Byte movOff1[] = { 0xa1, 0x10, 0x00 }; // mov ax, [0x10]
+    const Byte movOff2[] = { 0xa1, 0x20, 0x00 }; // mov ax, [0x20]
+    const Byte movReg[] = { 0x8b, 0x1e, 0x10, 0x00 }; // mov bx, [0x10]
+    const Byte jmpShort[] = { 0xeb, 0x10 }; // jmp short 0x12
+    const Byte jmpNear[] = { 0xe9, 0x10, 0x00 }; // jmp 0x13
+    const Byte jnz[] = { 0x75, 0x10 }; // jnz 0x12
+    const Instruction i1{a, movOff1}, i2{a, movOff2}, i3{a, movReg}, i4{a, jmpShort}, i5{a, jmpNear}, i6{a, jnz};
+    // values are masked in the fingerprint, but not in the value fingerprint
+    ASSERT_EQ(i1.fingerprint, i2.fingerprint);
+    ASSERT_NE(i1.valueFingerprint(), i2.valueFingerprint());
+    ASSERT_NE(i1.fingerprint, i3.fingerprint);
+    // the byte and word forms of an operand match, so they have the same fingerprint
+    ASSERT_EQ(i4.fingerprint, i5.fingerprint);
+    ASSERT_NE(i4.fingerprint, i6.fingerprint);
+    ASSERT_NE(fingerprintCombine(fingerprintCombine(0, i1.fingerprint), i3.fingerprint), fingerprintCombine(fingerprintCombine(0, i3.fingerprint), i1.fingerprint));
+
+    // instructions with different fingerprints never match
+    vector<Instruction> instrs;
+    Byte code[8] = { 0, 0, 0x9a, 0xbc, 0xde, 0xf0, 0x12, 0x34 };
+    for (int op = 0; op < 0x100; ++op) {
+        code[0] = op;
+        for (const Byte modrm : { 0x06, 0x47, 0x9a, 0xc3 }) {
+            code[1] = modrm;
+            const Instruction ins{a, code};
+            if (ins.isValid()) instrs.push_back(ins);
+        }
+    }
+    for (const Instruction &ref : instrs) {
+        for (const Instruction &tgt : instrs) {
+            if (ref.fingerprint != tgt.fingerprint) { ASSERT_EQ(ref.match(tgt), INS_MATCH_MISMATCH); }
+            if (ref.valueFingerprint() != tgt.valueFingerprint()) { ASSERT_NE(ref.match(tgt), INS_MATCH_FULL); }
+        }
+    }
+}
+
+TEST_F(CpuTest, RegisterEffect) {
+    const Address a{0x1000, 0x0};
+    auto mask = [](std::initializer_list<Register> regs) {
+        RegisterMask ret = 0;
+        for (Register r : regs) ret |= regMask(r);
+        return ret;
+    };
+    const Byte stosw[] = { 0xab }; // stosw
+    RegisterEffect e = Instruction{a, stosw}.registerEffect();
+    ASSERT_EQ(e.read, mask({ REG_AX, REG_DI, REG_ES, REG_FLAGS }));
+    ASSERT_EQ(e.write, mask({ REG_DI }));
+    const Byte repMovsw[] = { 0xf3, 0xa5 }; // rep movsw
+    e = Instruction{a, repMovsw}.registerEffect();
+    ASSERT_EQ(e.write, mask({ REG_SI, REG_DI, REG_CX }));
+    const Byte movMem[] = { 0x26, 0x89, 0x00 }; // mov es:[bx+si], ax
+    e = Instruction{a, movMem}.registerEffect();
+    ASSERT_EQ(e.read, mask({ REG_AX, REG_BX, REG_SI, REG_ES }));
+    ASSERT_EQ(e.write, 0);
+    const Byte addReg[] = { 0x01, 0xd8 }; // add ax, bx
+    e = Instruction{a, addReg}.registerEffect();
+    ASSERT_EQ(e.read, mask({ REG_AX, REG_BX }));
+    ASSERT_EQ(e.write, mask({ REG_AX, REG_FLAGS }));
+    const Byte mulByte[] = { 0xf6, 0xe3 }; // mul bl
+    e = Instruction{a, mulByte}.registerEffect();
+    ASSERT_EQ(e.read, mask({ REG_AL, REG_BL }));
+    ASSERT_EQ(e.write, mask({ REG_AX, REG_FLAGS }));
+    const Byte divWord[] = { 0xf7, 0xf3 }; // div bx
+    e = Instruction{a, divWord}.registerEffect();
+    ASSERT_EQ(e.read, mask({ REG_AX, REG_DX, REG_BX }));
+    ASSERT_EQ(e.write, mask({ REG_AX, REG_DX, REG_FLAGS }));
+    const Byte sar[] = { 0xd1, 0xfa }; // sar dx, 1
+    ASSERT_EQ(Instruction(a, sar).registerEffect().write, mask({ REG_DX, REG_FLAGS }));
+}
+
 TEST_F(CpuTest, BranchOffset) {
     const Word base = 0x6b00;
     const Address a{0x1000, base};
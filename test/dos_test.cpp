@@ -2,6 +2,17 @@
 #include "gtest/gtest.h"
 #include "dos/dos.h"
 #include "dos/mz.h"
+#include "dos/sink.h"
+#include "dos/memory.h"
+#include "dos/error.h"
+#include "dos/util.h"
+#include "dos/search.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
 
 using namespace std;
 
@@ -10,4 +21,140 @@ TEST(Dos, MzHeader) {
     TRACELN(mz.dump());
     ASSERT_EQ(mz.loadModuleSize(), 6723);
     ASSERT_EQ(mz.loadModuleOffset(), 512);
-}
\ No newline at end of file
+}
+
+TEST(Dos, MzRelocations) {
+    const Word loadSegment = 0x1000;
+    MzImage mz("bin/hello.exe");
+    mz.load(loadSegment);
+    ifstream file{"bin/hello.exe", ios::binary};
+    vector<Byte> fileData{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    // the load module is the file as it is, the relocations are applied when it goes into memory
+    ASSERT_EQ(memcmp(mz.loadModuleData(), fileData.data() + mz.loadModuleOffset(), mz.loadModuleSize()), 0);
+    const auto &patches = mz.relocationPatches();
+    ASSERT_EQ(patches.size(), 4);
+    const Memory mem{mz};
+    const Offset base = SEG_TO_OFFSET(loadSegment);
+    for (Size i = 0; i < patches.size(); ++i) {
+        if (i > 0) { ASSERT_LT(patches[i - 1].offset, patches[i].offset); }
+        Word fileValue;
+        memcpy(&fileValue, mz.loadModuleData() + patches[i].offset, sizeof(Word));
+        ASSERT_EQ(patches[i].value, fileValue + loadSegment);
+        ASSERT_EQ(mem.readWord(base + patches[i].offset), patches[i].value);
+    }
+    for (Offset off = 0; off < mz.loadModuleSize(); ++off) 
+        ASSERT_EQ(mz.loadModuleByte(off), mem.readByte(base + off)) << "offset " << off;
+}
+
+TEST(Dos, MzTruncated) {
+    ifstream file{"bin/hello.exe", ios::binary};
+    const vector<Byte> fileData{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    ASSERT_GE(fileData.size(), MZ_HEADER_SIZE);
+    Word relocTableOffset, relocTableSize;
+    memcpy(&relocTableOffset, fileData.data() + 0x18, sizeof(Word));
+    memcpy(&relocTableSize, fileData.data() + 0x06, sizeof(Word));
+    relocTableSize *= MZ_RELOC_SIZE;
+    const string path = "trunc.exe";
+    auto writeExe = [&](const Size size) { writeBinaryFile(path, fileData.data(), size); };
+
+    writeExe(MZ_HEADER_SIZE - 1);
+    ASSERT_THROW(MzImage{path}, IoError);
+    writeExe(relocTableOffset + relocTableSize - 1);
+    ASSERT_THROW(MzImage{path}, IoError);
+    // the relocations point into the load module past the end of the file
+    writeExe(relocTableOffset + relocTableSize);
+    ASSERT_THROW(MzImage{path}, IoError);
+    // relocations are in the file but the load module is cut short
+    writeExe(fileData.size() - 1);
+    MzImage mz{path};
+    ASSERT_EQ(mz.loadModuleSize(), 6723);
+    ASSERT_THROW(mz.load(0x1000), IoError);
+
+    vector<Byte> bad = fileData;
+    bad[0x02] = 0x01; bad[0x03] = 0x02; // last page size over 512
+    writeBinaryFile(path, bad.data(), bad.size());
+    ASSERT_THROW(MzImage{path}, DosError);
+    bad = fileData;
+    bad[0x08] = 0xff; bad[0x09] = 0x7f; // header paragraphs past the image size
+    writeBinaryFile(path, bad.data(), bad.size());
+    ASSERT_THROW(MzImage{path}, DosError);
+    deleteFile(path);
+}
+
+// every offset against every pattern
+static vector<PatternSearch::Match> bruteSearch(const vector<vector<SWord>> &patterns, const Byte *data, const Size size) {
+    vector<PatternSearch::Match> ret;
+    for (Offset off = 0; off < size; ++off) {
+        for (Size p = 0; p < patterns.size(); ++p) {
+            const auto &pat = patterns[p];
+            if (off + pat.size() > size) continue;
+            Size i = 0;
+            while (i < pat.size() && (pat[i] == -1 || pat[i] == data[off + i])) i++;
+            if (i == pat.size()) ret.push_back({off, p});
+        }
+    }
+    return ret;
+}
+
+TEST(Dos, PatternSearch) {
+    const string text = "abracadabra cadabra abracadabra";
+    const Byte *data = reinterpret_cast<const Byte*>(text.data());
+    const auto abra = hexaToNumeric("61627261");
+    const auto cadabra = hexaToNumeric("636164616272??");
+    const auto wild = hexaToNumeric("61????????62");
+    const auto any = hexaToNumeric("????");
+    ASSERT_THROW(PatternSearch{vector<SWord>{}}, ArgError);
+
+    auto hits = PatternSearch{abra}.findAll(data, text.size());
+    ASSERT_EQ(hits.size(), 5);
+    ASSERT_EQ(hits[0].offset, 0);
+    ASSERT_EQ(hits[4].offset, 27);
+    // a match right at the end of the buffer
+    hits = PatternSearch{cadabra}.findAll(data, text.size());
+    ASSERT_EQ(hits.size(), 3);
+    ASSERT_EQ(hits[2].offset, text.size() - cadabra.size());
+    ASSERT_EQ(PatternSearch{any}.findAll(data, text.size()).size(), text.size() - 1);
+
+    const vector<vector<SWord>> patterns{abra, cadabra, wild, any, hexaToNumeric("6162"), hexaToNumeric("62")};
+    for (const auto &p : patterns) {
+        ASSERT_EQ(PatternSearch{p}.findAll(data, text.size()), bruteSearch({p}, data, text.size()));
+    }
+    ASSERT_EQ(PatternSearch{patterns}.findAll(data, text.size()), bruteSearch(patterns, data, text.size()));
+
+    // the load module is searched with the relocations applied
+    MzImage mz("bin/hello.exe");
+    mz.load(0x1000);
+    const auto &patch = mz.relocationPatches().front();
+    vector<SWord> relocated{ lowByte(patch.value), hiByte(patch.value) };
+    const auto found = mz.findAll(relocated);
+    ASSERT_FALSE(found.empty());
+    ASSERT_NE(find(found.begin(), found.end(), Address{patch.offset}), found.end());
+    ASSERT_EQ(mz.find(relocated), found.front());
+    ASSERT_FALSE(mz.find(hexaToNumeric("ffffffffffffffffffffffff")).isValid());
+}
+
+static string fileContents(const string &path) {
+    ifstream file{path, ios::binary};
+    return string{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+}
+
+TEST(Dos, AsyncSink) {
+    const string path = "sink.out";
+    ostringstream expected;
+    {
+        // small ring to exercise the wraparound and a full buffer stalling the producer
+        AsyncSink sink{path, 50};
+        ASSERT_EQ(sink.capacity(), 64);
+        for (int i = 0; i < 1000; ++i) {
+            const string line = "line " + to_string(i) + " " + string(i % 100, 'x');
+            sink.write(line, true);
+            expected << line << '\n';
+            if (i == 500) {
+                sink.flush();
+                ASSERT_EQ(fileContents(path), expected.str());
+            }
+        }
+    }
+    ASSERT_EQ(fileContents(path), expected.str());
+    deleteFile(path);
+}
@@ -3,6 +3,9 @@
 #include "gtest/gtest.h"
 #include "dos/memory.h"
 #include "dos/util.h"
+#include "dos/error.h"
+#include "dos/sink.h"
+#include <sstream>
 
 using namespace std;
 
@@ -179,6 +182,199 @@ TEST_F(MemoryTest, Access) {
     }
 }
 
+TEST_F(MemoryTest, Pages) {
+    // nothing is allocated until written, reads see the initial pattern
+    ASSERT_EQ(mem.pageCount(), 0);
+    ASSERT_EQ(mem.readWord(0x12345), 0xbead);
+    ASSERT_EQ(mem.pageCount(), 0);
+    const Offset boundary = 3 * Memory::MEM_PAGE_SIZE;
+    mem.writeWord(boundary - 1, 0x1234);
+    ASSERT_EQ(mem.pageCount(), 2);
+    ASSERT_EQ(mem.readWord(boundary - 1), 0x1234);
+    ASSERT_EQ(mem.readByte(boundary - 2), 0xbe);
+    ASSERT_EQ(mem.readByte(boundary + 1), 0xad);
+    ASSERT_THROW(mem.pointer(boundary), MemoryError);
+
+    // flat range takes over the written pages with their contents
+    mem.mapFlat(boundary - 0x10, 0x20);
+    ASSERT_EQ(mem.flatRange(), Block(boundary - Memory::MEM_PAGE_SIZE, boundary + Memory::MEM_PAGE_SIZE - 1));
+    ASSERT_EQ(mem.pageCount(), 2);
+    const Byte *p = mem.pointer(boundary - 1);
+    ASSERT_EQ(p[0], 0x34);
+    ASSERT_EQ(p[1], 0x12);
+    mem.writeByte(boundary, 0xab);
+    ASSERT_EQ(p[1], 0xab);
+    ASSERT_THROW(mem.pointer(boundary + Memory::MEM_PAGE_SIZE), MemoryError);
+
+    // copies are independent
+    Memory copy{mem};
+    copy.writeByte(boundary, 0xcd);
+    ASSERT_EQ(copy.readByte(boundary), 0xcd);
+    ASSERT_EQ(mem.readByte(boundary), 0xab);
+    ASSERT_EQ(copy.pointer(boundary - 1)[0], 0x34);
+
+    // loaded data is kept flat, the rest stays untouched
+    const Byte code[] = { 0x55, 0x8b, 0xec };
+    const Memory loaded{0x1000, code, sizeof(code)};
+    ASSERT_EQ(loaded.pageCount(), 1);
+    ASSERT_EQ(loaded.pointer(0x10000)[1], 0x8b);
+    ASSERT_EQ(loaded.pointer(0x10003)[0], 0xef);
+}
+
+TEST_F(MemoryTest, Fork) {
+    const Byte code[] = { 0x55, 0x8b, 0xec };
+    const Offset data = 0x20000;
+    mem.mapFlat(0x10000, sizeof(code));
+    mem.writeBuf(0x10000, code, sizeof(code));
+    mem.writeWord(data, 0x1234);
+    mem.writeWord(data + Memory::MEM_PAGE_SIZE, 0x5678);
+    ASSERT_EQ(mem.pageCount(), 3);
+    ASSERT_EQ(mem.privatePageCount(), 3);
+
+    // nothing is copied until written to
+    Memory fork = mem.fork();
+    ASSERT_EQ(fork.pageCount(), 3);
+    ASSERT_EQ(fork.privatePageCount(), 0);
+    ASSERT_EQ(mem.privatePageCount(), 0);
+    ASSERT_EQ(fork.pointer(0x10000), mem.pointer(0x10000));
+    fork.writeByte(data, 0xab);
+    ASSERT_EQ(fork.privatePageCount(), 1);
+    ASSERT_EQ(fork.readWord(data), 0x12ab);
+    ASSERT_EQ(mem.readWord(data), 0x1234);
+    ASSERT_EQ(fork.readWord(data + Memory::MEM_PAGE_SIZE), 0x5678);
+    // writing to the flat range copies it as a whole
+    fork.writeByte(0x10001, 0x89);
+    ASSERT_NE(fork.pointer(0x10000), mem.pointer(0x10000));
+    ASSERT_EQ(fork.pointer(0x10000)[1], 0x89);
+    ASSERT_EQ(mem.pointer(0x10000)[1], 0x8b);
+    ASSERT_EQ(fork.privatePageCount(), 2);
+
+    // rewind to an earlier state
+    const Memory snapshot = mem.snapshot();
+    mem.writeWord(data, 0xffff);
+    mem.writeByte(0x30000, 0);
+    ASSERT_EQ(mem.pageCount(), 4);
+    mem.restore(snapshot);
+    ASSERT_EQ(mem.pageCount(), 3);
+    ASSERT_EQ(mem.readWord(data), 0x1234);
+    ASSERT_EQ(mem.readByte(0x30000), 0xde);
+}
+
+TEST_F(MemoryTest, AccessPolicy) {
+    ASSERT_THROW(mem.readByte(MEM_TOTAL), MemoryError);
+    ASSERT_THROW(mem.writeWord(MEM_TOTAL + 1, 0), MemoryError);
+    // a fault is reported to the handler, reads see open bus and writes are lost
+    Offset faultAddr = 0;
+    int faults = 0;
+    mem.setFaultHandler([&](const Offset addr, const bool) { faultAddr = addr; faults++; });
+    ASSERT_EQ(mem.readWord<FaultAccess>(MEM_TOTAL + 0x10), 0xffff);
+    ASSERT_EQ(faultAddr, MEM_TOTAL + 0x10);
+    mem.writeByte<FaultAccess>(MEM_TOTAL, 0);
+    ASSERT_EQ(faults, 2);
+    ASSERT_EQ(mem.pageCount(), 0);
+    mem.writeByte<UncheckedAccess>(0x1234, 0x56);
+    ASSERT_EQ(mem.readByte<FaultAccess>(0x1234), 0x56);
+    ASSERT_EQ(faults, 2);
+
+    // segmented addresses wrap around at 1 MiB, within a segment a word wraps around at offset 0xffff
+    mem.writeWord(0, 0xabcd);
+    ASSERT_EQ(mem.readWord(Address{0xffff, 0x10}), 0xabcd);
+    mem.writeWord(Address{0xffff, 0x20}, 0x1234);
+    ASSERT_EQ(mem.readWord(0x10), 0x1234);
+    mem.writeByte(MEM_TOTAL - 1, 0xef);
+    ASSERT_EQ(mem.readWord<UncheckedAccess>(MEM_TOTAL - 1), 0xcdef);
+    mem.writeWord(Address{0x2000, 0xffff}, 0x5678);
+    ASSERT_EQ(mem.readByte(0x2ffff), 0x78);
+    ASSERT_EQ(mem.readByte(0x20000), 0x56);
+    ASSERT_EQ(mem.readWord(Address{0x2000, 0xffff}), 0x5678);
+}
+
+TEST_F(MemoryTest, AccessMap) {
+    // untracked accesses are not recorded, tracked ones only once the map is enabled
+    mem.writeByte<TrackedAccess<CheckedAccess>>(0x100, 1);
+    ASSERT_EQ(mem.accessMap(), nullptr);
+    mem.enableAccessMap();
+    AccessMap *access = mem.accessMap();
+    ASSERT_NE(access, nullptr);
+    mem.writeWord(0x200, 0x1234);
+    mem.readByte(0x200);
+    ASSERT_FALSE(access->test(0x200, ACCESS_WRITE));
+    ASSERT_FALSE(access->test(0x200, ACCESS_READ));
+
+    mem.writeWord<TrackedAccess<CheckedAccess>>(0x200, 0x1234);
+    mem.readByte<TrackedAccess<UncheckedAccess>>(0x201);
+    mem.readWord<TrackedAccess<CheckedAccess>>(Address{0x1000, 0xffff});
+    access->mark(0x1f0, 0x11, ACCESS_EXEC);
+    ASSERT_TRUE(access->test(0x200, ACCESS_WRITE));
+    ASSERT_TRUE(access->test(0x201, ACCESS_WRITE));
+    ASSERT_FALSE(access->test(0x202, ACCESS_WRITE));
+    ASSERT_FALSE(access->test(0x200, ACCESS_READ));
+    ASSERT_TRUE(access->test(0x201, ACCESS_READ));
+    ASSERT_TRUE(access->test(0x1ffff, ACCESS_READ));
+    ASSERT_TRUE(access->test(0x10000, ACCESS_READ));
+    ASSERT_EQ(access->segmentBitmap(1, ACCESS_READ)[0], 0x01);
+    ASSERT_EQ(access->segmentBitmap(1, ACCESS_READ)[AccessMap::SEGMENT_BITMAP_SIZE - 1], 0x80);
+
+    const Block all{0, MEM_TOTAL - 1};
+    auto exec = access->blocks(ACCESS_EXEC, all);
+    ASSERT_EQ(exec.size(), 1);
+    ASSERT_EQ(exec[0], Block(0x1f0, 0x200));
+    auto data = access->dataBlocks(all);
+    ASSERT_EQ(data.size(), 3);
+    ASSERT_EQ(data[0], Block(0x201, 0x201));
+    ASSERT_EQ(data[1], Block(0x10000, 0x10000));
+    ASSERT_EQ(data[2], Block(0x1ffff, 0x1ffff));
+
+    // forks record into the same map
+    Memory copy = mem.fork();
+    copy.writeByte<TrackedAccess<CheckedAccess>>(0x300, 0);
+    ASSERT_TRUE(access->test(0x300, ACCESS_WRITE));
+    access->clear();
+    ASSERT_TRUE(access->blocks(ACCESS_WRITE, all).empty());
+}
+
+TEST_F(MemoryTest, Diff) {
+    mem.mapFlat(0x10000, 0x2000);
+    mem.writeBuf(0x10000, reinterpret_cast<const Byte*>("0123456789abcdef"), 16);
+    Memory copy = mem.fork();
+    const Block range{0, MEM_TOTAL - 1};
+    ASSERT_TRUE(mem.diff(copy, range).empty());
+
+    // runs join across page boundaries and the flat range
+    copy.writeByte(0x10003, 'x');
+    copy.writeWord(0x10008, 0xffff);
+    copy.writeBuf(0x10ffc, reinterpret_cast<const Byte*>("abcdefgh"), 8);
+    copy.writeByte(0x50000, 0);
+    auto runs = mem.diff(copy, range);
+    ASSERT_EQ(runs.size(), 4);
+    ASSERT_EQ(runs[0], Block(0x10003, 0x10003));
+    ASSERT_EQ(runs[1], Block(0x10008, 0x10009));
+    ASSERT_EQ(runs[2], Block(0x10ffc, 0x11003));
+    ASSERT_EQ(runs[3], Block(0x50000, 0x50000));
+    runs = mem.diff(copy, Block(0x10004, 0x10ffd));
+    ASSERT_EQ(runs.size(), 2);
+    ASSERT_EQ(runs[1], Block(0x10ffc, 0x10ffd));
+
+    vector<Byte> buf(0x100, 0xab);
+    buf[0x10] = buf[0x11] = 0;
+    for (Size i = 0x40; i < 0x80; ++i) buf[i] = 0;
+    mem.writeBuf(0x20000, buf.data(), buf.size());
+    buf[0x11] = 0xab;
+    for (Size i = 0x48; i < 0x70; ++i) buf[i] = 0xab;
+    runs = mem.diff(0x20000, buf.data(), buf.size());
+    ASSERT_EQ(runs.size(), 2);
+    ASSERT_EQ(runs[0], Block(0x20011, 0x20011));
+    ASSERT_EQ(runs[1], Block(0x20048, 0x2006f));
+
+    ostringstream str;
+    StreamSink sink{str};
+    mem.hexDump(sink, mem.diff(copy, Block(0x10000, 0x10fff)));
+    ASSERT_EQ(str.str(), 
+        "0x00010000: 30 31 32 33 34 35 36 37 38 39 61 62 63 64 65 66 0123456789abcdef\n"
+        "[...]\n"
+        "0x00010ff0: de ad be ef de ad be ef de ad be ef de ad be ef ................\n");
+}
+
 TEST_F(MemoryTest, Alloc) {
     const Size avail = mem.availableBlock();
     mem.allocBlock(avail);
@@ -1,14 +1,18 @@
 #include "gtest/gtest.h"
 #include "dos/output.h"
+#include "dos/sink.h"
 #include "debug.h"
 
 #include <string>
+#include <iostream>
 
 using namespace std;
 DebugStream debug_stream;
 
 int main(int argc, char* argv[]) {
     TRACE_ENABLE(false);
+    // keep library output in sequence with the trace messages and gtest's own output
+    setOutputSink(new StreamSink(cout));
     setOutputLevel(LOG_SILENT);    
     for (int i = 0; i < argc; ++i) {
         const string arg{argv[i]};
@@ -3,6 +3,9 @@
 #include "dos/error.h"
 #include "dos/output.h"
 #include "dos/executable.h"
+#include "dos/trace.h"
+#include "dos/sink.h"
+#include "dos/json.h"
 
 #include <iostream>
 #include <string>
@@ -10,6 +13,7 @@
 #include <sstream>
 #include <stack>
 #include <regex>
+#include <memory>
 
 using namespace std;
 
@@ -29,6 +33,12 @@ void usage() {
            "--ctx count    display up to 'count' context instructions after a mismatch (default 10)\n"
            "--loose        non-strict matching, allows e.g for literal argument differences\n"
            "--variant      treat instruction variants that do the same thing as matching\n"
+           "--trace file   record analysis events into a binary trace file, to be viewed with mztrace\n"
+           "--cpu level    instruction set to decode both executables with, 8086 (default), 186 or 286\n"
+           "--stats        show how many instructions were matched on their bytes alone, without comparing the decoded forms,\n"
+           "               on stdout regardless of the output level, or as a 'stats' record with the ndjson format\n"
+           "--format fmt   output format, 'text' (default) or 'ndjson' for one JSON record per compared location on stdout,\n"
+           "               with the text messages going to stderr\n"
            "The optional entrypoint spec tells the tool at which offset to start comparing, and can be different\n"
            "for both executables if their layout does not match. It can be any of the following:\n"
            "  ':0x123' for a hex offset\n"
@@ -129,7 +139,8 @@ int main(int argc, char *argv[]) {
         usage();
     }
     AnalysisOptions opt;
-    string baseSpec, pathMap, compareSpec;
+    string baseSpec, pathMap, compareSpec, pathTrace, cpuName = "8086";
+    bool ndjson = false, stats = false;
     int posarg = 0;
     for (int aidx = 1; aidx < argc; ++aidx) {
         string arg(argv[aidx]);
@@ -154,12 +165,27 @@ int main(int argc, char *argv[]) {
             if (aidx + 1 >= argc) fatal("Option requires an argument: --map");
             pathMap = argv[++aidx];
         }
+        else if (arg == "--trace") {
+            if (aidx + 1 >= argc) fatal("Option requires an argument: --trace");
+            pathTrace = argv[++aidx];
+        }
+        else if (arg == "--format") {
+            if (aidx + 1 >= argc) fatal("Option requires an argument: --format");
+            const string format = argv[++aidx];
+            if (format == "ndjson") ndjson = true;
+            else if (format != "text") fatal("Unsupported output format: " + format);
+        }
+        else if (arg == "--cpu") {
+            if (aidx + 1 >= argc) fatal("Option requires an argument: --cpu");
+            cpuName = argv[++aidx];
+        }
         else if (arg == "--exclude") {
             if (aidx + 1 >= argc) fatal("Option requires an argument: --exclude");
             opt.exclude = argv[++aidx];
         }        
         else if (arg == "--loose") opt.strict = false;
         else if (arg == "--variant") opt.variant = true;
+        else if (arg == "--stats") stats = true;
         else { // positional arguments
             switch (++posarg) {
             case 1: baseSpec = arg; break;
@@ -168,12 +194,40 @@ int main(int argc, char *argv[]) {
             }
         }
     }
+    // keep stdout clean for the records
+    if (ndjson) setOutputSink(new AsyncSink(stderr));
     try {
+        unique_ptr<AsyncSink> recordSink;
+        unique_ptr<JsonWriter> records;
+        if (ndjson) {
+            recordSink.reset(new AsyncSink(stdout));
+            records.reset(new JsonWriter(*recordSink));
+            opt.records = records.get();
+        }
         Executable exeBase = loadExe(baseSpec, loadSeg, opt);
         Executable exeCompare = loadExe(compareSpec, loadSeg, opt);
+        const CpuLevel cpu = cpuLevel(cpuName);
+        exeBase.setCpu(cpu);
+        exeCompare.setCpu(cpu);
         RoutineMap map;
         if (!pathMap.empty()) map = {pathMap, loadSeg};
-        if (!exeBase.compareCode(map, exeCompare, opt)) return 1;
+        if (!pathTrace.empty()) traceOpen(pathTrace);
+        CompareStats compareStats;
+        if (stats) opt.stats = &compareStats;
+        const bool match = exeBase.compareCode(map, exeCompare, opt);
+        traceClose();
+        // the stats are part of the report asked for, not subject to the log level
+        if (stats && records) {
+            records->begin("stats").field("instructions", compareStats.instructions)
+                .field("spanmatches", compareStats.spanMatches).field("rawmatches", compareStats.rawMatches)
+                .field("blocks", compareStats.blocks).field("fullblocks", compareStats.fullBlocks)
+                .field("spanbytes", compareStats.spanBytes).end();
+        }
+        else if (stats) {
+            outputFlush();
+            cout << compareStats.toString() << endl;
+        }
+        if (!match) return 1;
     }
     catch (Error &e) {
         fatal(e.why());
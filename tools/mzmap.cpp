@@ -3,6 +3,7 @@
 #include "dos/error.h"
 #include "dos/output.h"
 #include "dos/executable.h"
+#include "dos/trace.h"
 
 #include <iostream>
 #include <string>
@@ -21,7 +22,10 @@ void usage() {
            "--debug:        show additional debug information\n"
            "--nocpu:        omit CPU-related information like instruction decoding\n"
            "--noanal:       omit analysis-related information\n"
-           "--load segment: overrride default load segment (0x1000)", LOG_OTHER, LOG_ERROR);
+           "--load segment: overrride default load segment (0x1000)\n"
+           "--cpu level:    instruction set to decode, 8086 (default), 186 or 286\n"
+           "--prologues:    also search unreachable code starting with a routine prologue (push bp; mov bp, sp)\n"
+           "--trace file:   record analysis events into a binary trace file, to be viewed with mztrace", LOG_OTHER, LOG_ERROR);
     exit(1);
 }
 
@@ -80,6 +84,8 @@ int main(int argc, char *argv[]) {
         usage();
     }
     Word loadSegment = 0x1000;
+    string pathTrace, cpuName = "8086";
+    bool prologues = false;
     for (int aidx = 3; aidx < argc; ++aidx) {
         string arg(argv[aidx]);
         if (arg == "--debug") setOutputLevel(LOG_DEBUG);
@@ -91,18 +97,26 @@ int main(int argc, char *argv[]) {
             loadSegment = static_cast<Word>(stoi(loadSegStr, nullptr, 16));
             verbose("Overloading default load segment: "s + hexVal(loadSegment));
         }
+        else if (arg == "--prologues") prologues = true;
+        else if (arg == "--cpu" && (aidx + 1 < argc)) cpuName = argv[++aidx];
+        else if (arg == "--trace" && (aidx + 1 < argc)) {
+            pathTrace = argv[++aidx];
+        }
         else fatal("Unrecognized parameter: "s + arg);
     }
     const string spec{argv[1]}, pathMap{argv[2]};
     try {
+        if (!pathTrace.empty()) traceOpen(pathTrace);
         Executable exe = loadExe(spec, loadSegment);
-        RoutineMap map = exe.findRoutines();
+        exe.setCpu(cpuLevel(cpuName));
+        RoutineMap map = exe.findRoutines(prologues);
         if (map.empty()) {
             fatal("Unable to find any routines");
             return 1;
         }
         verbose(map.dump(), true);
         map.save(pathMap, loadSegment);
+        traceClose();
     }
     catch (Error &e) {
         fatal(e.why());
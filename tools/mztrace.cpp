@@ -0,0 +1,93 @@
+#include "dos/util.h"
+#include "dos/error.h"
+#include "dos/output.h"
+#include "dos/trace.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <regex>
+
+using namespace std;
+
+void usage() {
+    output("usage: mztrace <file.trace> [options]\n"
+           "Prints the analysis events recorded with the --trace option of mzmap and mzdiff\n"
+           "Options:\n"
+           "--event names  only show events of the given comma-separated types\n"
+           "               (search, call, jump, claim, codemap, datamap, stackmap, mismatch, seed, data)\n"
+           "--from addr    only show events at or above the address\n"
+           "--to addr      only show events at or below the address\n"
+           "--routine id   only show events related to the routine id\n"
+           "--grep pat     only show events whose printed form matches the regex pattern\n"
+           "--count        print the number of matching events instead of the events themselves", LOG_OTHER, LOG_ERROR);
+    exit(1);
+}
+
+void fatal(const string &msg) {
+    output("ERROR: "s + msg, LOG_OTHER, LOG_ERROR);
+    exit(1);
+}
+
+void info(const string &msg) {
+    output(msg, LOG_OTHER, LOG_INFO);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage();
+    }
+    bool events[TRC_COUNT] = {}, eventFilter = false, countOnly = false, grepFilter = false;
+    Address from, to;
+    int routine = -1;
+    regex grepRe;
+    const string path{argv[1]};
+    for (int aidx = 2; aidx < argc; ++aidx) {
+        string arg(argv[aidx]);
+        if (arg == "--count") countOnly = true;
+        else if (aidx + 1 >= argc) fatal("Option requires an argument or is not recognized: "s + arg);
+        else if (arg == "--event") {
+            for (const auto &name : splitString(argv[++aidx], ',')) {
+                const TraceEvent ev = traceEventFromName(name);
+                if (ev == TRC_NONE) fatal("Unrecognized event type: "s + name);
+                events[ev] = eventFilter = true;
+            }
+        }
+        else if (arg == "--from") from = Address{argv[++aidx], true};
+        else if (arg == "--to") to = Address{argv[++aidx], true};
+        else if (arg == "--routine") routine = stoi(argv[++aidx], nullptr, 10);
+        else if (arg == "--grep") {
+            grepRe = regex{argv[++aidx]};
+            grepFilter = true;
+        }
+        else fatal("Unrecognized parameter: "s + arg);
+    }
+    try {
+        TraceReader trace{path};
+        Size count = 0;
+        for (const TraceRecord &rec : trace) {
+            if (eventFilter && (rec.event >= TRC_COUNT || !events[rec.event])) continue;
+            if (routine >= 0 && rec.routine != routine) continue;
+            if (from.isValid() || to.isValid()) {
+                const Address addr = rec.address();
+                if (!addr.isValid()) continue;
+                if (from.isValid() && addr.toLinear() < from.toLinear()) continue;
+                if (to.isValid() && addr.toLinear() > to.toLinear()) continue;
+            }
+            // formatting is only needed for the pattern match or the actual output
+            if (!grepFilter && countOnly) { count++; continue; }
+            const string line = rec.toString();
+            if (grepFilter && !regex_search(line, grepRe)) continue;
+            count++;
+            if (!countOnly) info(line);
+        }
+        if (countOnly) info(to_string(count) + " of " + to_string(trace.size()) + " events");
+    }
+    catch (Error &e) {
+        fatal(e.why());
+    }
+    catch (...) {
+        fatal("Unknown exception");
+    }
+    return 0;
+}